@@ -6,10 +6,17 @@ uniform float ambientLight;
 uniform float diffuseLight;
 uniform vec3 lightSrcDir;
 
+// See FrameData in shaders.hpp
+layout(std140) uniform FrameData {
+	mat4 view;
+	mat4 invView;
+	mat4 proj;
+	vec4 fogColor;
+	float fogStart;
+	float fogEnd;
+};
+
 uniform bool applyFog;
-uniform vec4 fogColor;
-uniform float fogStart;
-uniform float fogEnd;
 
 in GS_OUT {
 	flat int texId;
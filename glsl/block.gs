@@ -2,11 +2,18 @@
 
 #pragma optionNV (unroll all)
 
+// See FrameData in shaders.hpp
+layout(std140) uniform FrameData {
+	mat4 view;
+	mat4 invView;
+	mat4 proj;
+	vec4 fogColor;
+	float fogStart;
+	float fogEnd;
+};
+
 uniform mat4 model;
 uniform bool applyView;
-uniform mat4 view;
-
-uniform mat4 proj;
 uniform mat3 sideTransforms[6];
 
 layout(points) in;
@@ -30,7 +37,7 @@ void main() {
 	
 	gs_out.texId = gs_in[0].texId;
 	gs_out.normal = normalize(mat3(model) * sideTransform * vec3(0, 0, 1));
-	if(!applyView) gs_out.normal = mat3(inverse(view)) * gs_out.normal;
+	if(!applyView) gs_out.normal = mat3(invView) * gs_out.normal;
 	
 	for(int y = 0; y <= 1; y++) {
 		for(int x = 0; x <= 1; x++) {
@@ -1,8 +1,7 @@
 #version 330 core
 
-layout(location = 0) in uvec3 attrPos;
-layout(location = 1) in int attrSide;
-layout(location = 2) in int attrTexId;
+// See FaceData in face_renderer.hpp for the layout
+layout(location = 0) in uint attrFace;
 
 out VS_OUT {
 	int side;
@@ -10,7 +9,8 @@ out VS_OUT {
 } vs_out;
 
 void main() {;
-	gl_Position = vec4(attrPos, 1.0);
-	vs_out.side = attrSide;
-	vs_out.texId = attrTexId;
+	uvec3 pos = uvec3(attrFace & 0xfu, (attrFace >> 4) & 0x3fu, (attrFace >> 10) & 0xfu);
+	gl_Position = vec4(pos, 1.0);
+	vs_out.side = int((attrFace >> 14) & 0x7u);
+	vs_out.texId = int((attrFace >> 17) & 0xffu);
 }
@@ -0,0 +1,49 @@
+#version 330 core
+
+// Alternative to block.vs and block.gs: each face is an instance of a 4 vertex triangle strip,
+// which reads its FaceData (see face_renderer.hpp) from a buffer texture
+
+uniform usamplerBuffer faces;
+uniform int firstFace;
+
+// See FrameData in shaders.hpp
+layout(std140) uniform FrameData {
+	mat4 view;
+	mat4 invView;
+	mat4 proj;
+	vec4 fogColor;
+	float fogStart;
+	float fogEnd;
+};
+
+uniform mat4 model;
+uniform bool applyView;
+uniform mat3 sideTransforms[6];
+
+// Same outputs as block.gs, for block.fs
+out GS_OUT {
+	flat int texId;
+	flat vec3 normal;
+	vec3 cameraCoords;
+	vec2 vertexUV;
+} vs_out;
+
+void main() {
+	uint face = texelFetch(faces, firstFace + gl_InstanceID).r;
+	vec3 pos = vec3(face & 0xfu, (face >> 4) & 0x3fu, (face >> 10) & 0xfu);
+	mat3 sideTransform = sideTransforms[(face >> 14) & 0x7u];
+	
+	vs_out.texId = int((face >> 17) & 0xffu);
+	vs_out.normal = normalize(mat3(model) * sideTransform[2]);
+	if(!applyView) vs_out.normal = mat3(invView) * vs_out.normal;
+	
+	// Corners in the same order as block.gs
+	int x = gl_VertexID & 1;
+	int y = gl_VertexID >> 1;
+	vec4 cameraCoords = model * vec4(pos + sideTransform * vec3(x - 0.5, y - 0.5, 0.5), 1.0);
+	if(applyView)
+		cameraCoords = view * cameraCoords;
+	vs_out.cameraCoords = vec3(cameraCoords);
+	gl_Position = proj * cameraCoords;
+	vs_out.vertexUV = vec2(x, y);
+}
@@ -4,10 +4,17 @@ uniform sampler2D tex;
 
 uniform float ambientLight;
 
+// See FrameData in shaders.hpp
+layout(std140) uniform FrameData {
+	mat4 view;
+	mat4 invView;
+	mat4 proj;
+	vec4 fogColor;
+	float fogStart;
+	float fogEnd;
+};
+
 uniform bool applyFog;
-uniform vec4 fogColor;
-uniform float fogStart;
-uniform float fogEnd;
 
 in vec3 cameraCoords;
 in vec2 vertexUV;
@@ -1,9 +1,17 @@
 #version 330 core
 
+// See FrameData in shaders.hpp
+layout(std140) uniform FrameData {
+	mat4 view;
+	mat4 invView;
+	mat4 proj;
+	vec4 fogColor;
+	float fogStart;
+	float fogEnd;
+};
+
 uniform mat4 model;
 uniform bool applyView;
-uniform mat4 view;
-uniform mat4 proj;
 
 layout (location = 0) in vec3 attrPos;
 layout (location = 1) in vec2 attrUV;
@@ -1,7 +1,14 @@
 #version 330 core
 
-uniform mat4 view;
-uniform mat4 proj;
+// See FrameData in shaders.hpp
+layout(std140) uniform FrameData {
+	mat4 view;
+	mat4 invView;
+	mat4 proj;
+	vec4 fogColor;
+	float fogStart;
+	float fogEnd;
+};
 
 uniform float fovY;
 uniform float winH;
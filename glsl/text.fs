@@ -1,9 +1,9 @@
 #version 330 core
 
-uniform sampler2D tex;
+uniform sampler2DArray tex;
 uniform vec4 textColor;
 
-in vec2 vertUV;
+in vec3 vertUV;
 
 out vec4 fragColor;
 
@@ -0,0 +1,15 @@
+#version 330 core
+
+uniform vec2 winSize;
+uniform vec2 offset; // in pixels, to move cached text
+
+layout (location = 0) in vec2 attrPos;
+layout (location = 1) in vec3 attrUV; // the third coordinate is the atlas page
+
+out vec3 vertUV;
+
+void main() {
+	vec2 scrPos = (attrPos + offset) / winSize * 2;
+	gl_Position = vec4(scrPos, 0.0, 1.0);
+	vertUV = attrUV;
+}
@@ -12,6 +12,7 @@ with open("src/pixcraft/client/shaders_src.cpp", "w") as out:
 	include("glsl/block.vs", "blockVS")
 	include("glsl/block.gs", "blockGS")
 	include("glsl/block.fs", "blockFS")
+	include("glsl/block_instanced.vs", "blockInstancedVS")
 	
 	include("glsl/entity.vs", "entityVS")
 	include("glsl/entity.fs", "entityFS")
@@ -26,6 +27,7 @@ with open("src/pixcraft/client/shaders_src.cpp", "w") as out:
 	include("glsl/overlay.vs", "overlayVS")
 	include("glsl/block_overlay.vs", "blockOverlayVS")
 	include("glsl/gui.vs", "guiVS")
+	include("glsl/text.vs", "textVS")
 	include("glsl/text.fs", "textFS")
 	include("glsl/color.fs", "colorFS")
 	include("glsl/texture.fs", "textureFS")
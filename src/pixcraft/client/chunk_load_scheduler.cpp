@@ -0,0 +1,110 @@
+#include "chunk_load_scheduler.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include "pixcraft/util/profiler.hpp"
+
+using namespace PixCraft;
+
+ChunkLoadScheduler::ChunkLoadScheduler(World& world, ChunkRenderer& chunkRenderer)
+	: world(world), chunkRenderer(chunkRenderer), needsRebuild(true), camChunkX(0), camChunkZ(0),
+	  viewDir(0, 0), renderDist(0), genCost(1.0f), meshCost(1.0f),
+	  deterministic(false) { }
+
+void ChunkLoadScheduler::update(int32_t camChunkX2, int32_t camChunkZ2, glm::vec3 viewDir3, int renderDist2) {
+	glm::vec2 viewDir2(viewDir3.x, viewDir3.z);
+	float len = glm::length(viewDir2);
+	viewDir2 = len > 0.01f ? viewDir2 / len : glm::vec2(0, 0);
+
+	if(camChunkX2 != camChunkX || camChunkZ2 != camChunkZ || renderDist2 != renderDist
+		|| glm::dot(viewDir2, viewDir) < MIN_VIEW_COS) {
+		needsRebuild = true;
+	}
+	camChunkX = camChunkX2;
+	camChunkZ = camChunkZ2;
+	renderDist = renderDist2;
+	if(needsRebuild) {
+		viewDir = viewDir2;
+		rebuild();
+	}
+}
+
+void ChunkLoadScheduler::process(float budget) {
+	int64_t start = Profiler::now();
+	// Estimated costs that the clock doesn't see yet: meshing happens later in the frame, in ChunkRenderer::updateBlocks
+	// (and in deterministic mode, the clock isn't used at all)
+	float pendingCost = 0;
+	bool first = true;
+	while(!queue.empty()) {
+		Request req = queue.back();
+		bool loaded = world.isChunkLoaded(req.x, req.z);
+		if(!inRange(req.x, req.z) || (loaded && chunkRenderer.isChunkRendered(req.x, req.z))) {
+			queue.pop_back();
+			continue;
+		}
+
+		float spent = (deterministic ? 0 : (Profiler::now() - start) / 1000.0f) + pendingCost;
+		float estimate = loaded ? meshCost : genCost + meshCost;
+		if(!first && spent + estimate > budget) break;
+		first = false;
+		queue.pop_back();
+
+		if(!loaded) {
+			int64_t genStart = Profiler::now();
+			world.genChunk(req.x, req.z);
+			float genTime = (Profiler::now() - genStart) / 1000.0f;
+			if(deterministic) {
+				pendingCost += genCost;
+			} else {
+				genCost += COST_SMOOTHING * (genTime - genCost);
+			}
+		} else {
+			world.markChunkDirty(req.x, req.z);
+		}
+		pendingCost += meshCost;
+	}
+}
+
+void ChunkLoadScheduler::reportMeshing(size_t chunkCount, float time) {
+	if(chunkCount == 0 || deterministic) return;
+	meshCost += COST_SMOOTHING * (time / chunkCount - meshCost);
+}
+
+void ChunkLoadScheduler::setDeterministic(bool deterministic2) {
+	deterministic = deterministic2;
+}
+
+void ChunkLoadScheduler::reset() {
+	needsRebuild = true;
+}
+
+size_t ChunkLoadScheduler::queueSize() { return queue.size(); }
+
+void ChunkLoadScheduler::rebuild() {
+	needsRebuild = false;
+	queue.clear();
+	int maxDist = renderDist + 2;
+	for(int32_t x = camChunkX - maxDist; x <= camChunkX + maxDist; ++x) {
+		for(int32_t z = camChunkZ - maxDist; z <= camChunkZ + maxDist; ++z) {
+			if(!inRange(x, z)) continue;
+			if(world.isChunkLoaded(x, z) && chunkRenderer.isChunkRendered(x, z)) continue;
+
+			// Chunks behind the camera count as up to twice as far away; the closest ones are always loaded first,
+			// since the player may be looking down at them.
+			glm::vec2 offset(x - camChunkX, z - camChunkZ);
+			float dist = glm::length(offset);
+			float cos = dist < 2.0f ? 1.0f : glm::dot(offset / dist, viewDir);
+			queue.push_back(Request { dist * (1.5f - 0.5f*cos), x, z });
+		}
+	}
+	std::sort(queue.begin(), queue.end(), [](const Request& a, const Request& b) {
+		return a.score > b.score;
+	});
+}
+
+bool ChunkLoadScheduler::inRange(int32_t x, int32_t z) {
+	int32_t dx = x - camChunkX;
+	int32_t dz = z - camChunkZ;
+	return dx*dx + dz*dz <= (renderDist + 2)*(renderDist + 2);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+#include "pixcraft/util/glm.hpp"
+
+#include "pixcraft/server/world.hpp"
+#include "chunk_renderer.hpp"
+
+namespace PixCraft {
+	// Keeps a queue of chunks to generate or mesh around the camera, closest and most in view first,
+	// and works through it within a time budget each frame.
+	class ChunkLoadScheduler {
+	public:
+		ChunkLoadScheduler(World& world, ChunkRenderer& chunkRenderer);
+		
+		// Rebuilds the queue if the camera changed chunk, turned significantly, or the render distance changed
+		void update(int32_t camChunkX, int32_t camChunkZ, glm::vec3 viewDir, int renderDist);
+		// Generates chunks / requests meshes until the estimated cost reaches budget (in ms);
+		// at least one request is handled per call so that loading never stalls.
+		void process(float budget);
+		// Feeds back the measured cost of the ChunkRenderer meshing the requested chunks
+		void reportMeshing(size_t chunkCount, float time);
+		
+		// Uses fixed cost estimates instead of measured times, so that the loading order only depends on the inputs
+		void setDeterministic(bool deterministic);
+		
+		// Forces a rebuild of the queue (eg. after the world or the renderer were reset)
+		void reset();
+		size_t queueSize();
+	
+	private:
+		static constexpr float MIN_VIEW_COS = 0.9f; // turning by more than ~25° rebuilds the queue
+		static constexpr float COST_SMOOTHING = 0.1f;
+		
+		struct Request {
+			float score;
+			int32_t x, z;
+		};
+		
+		World& world;
+		ChunkRenderer& chunkRenderer;
+		
+		std::vector<Request> queue; // sorted by decreasing score, so that the best request is at the back
+		bool needsRebuild;
+		int32_t camChunkX, camChunkZ;
+		glm::vec2 viewDir;
+		int renderDist;
+		
+		float genCost, meshCost; // moving averages, in ms per chunk
+		bool deterministic;
+		
+		void rebuild();
+		bool inRange(int32_t x, int32_t z);
+	};
+}
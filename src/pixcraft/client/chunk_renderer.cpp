@@ -6,6 +6,7 @@
 #include <cmath>
 #include <tuple>
 #include <utility>
+#include <algorithm>
 
 #include <iostream>
 
@@ -17,69 +18,88 @@
 
 using namespace PixCraft;
 
-void RenderedChunk::init(World& world2, FaceRenderer& faceRenderer, int32_t chunkX2, int32_t chunkZ2) {
-	world = &world2;
+uint32_t RenderedChunk::nextMeshVersion = 0;
+
+void RenderedChunk::init(FaceRenderer& faceRenderer, int32_t chunkX2, int32_t chunkZ2) {
 	buffer.init(faceRenderer, MAX_CHUNK_FACES);
 	translucentBuffer.init(faceRenderer, MAX_CHUNK_FACES);
+	starts.fill(0);
 	chunkX = chunkX2; chunkZ = chunkZ2;
+	meshVersion = nextMeshVersion++;
+	sortedVersion = sortingVersion = meshVersion;
+	sorting = false;
+	_connectivity.fill(SectionConnectivity::all());
+	changedSections = 0;
 }
 
 bool RenderedChunk::isInitialized() { return buffer.isInitialized(); }
 
-void RenderedChunk::prerender() {
-	Chunk& chunk = world->getChunk(chunkX, chunkZ);
-	
+void RenderedChunk::prerender(const ChunkNeighbourhood& chunks) {
 	buffer.faces.clear();
 	translucentBuffer.faces.clear();
+	changedSections = (1 << CHUNK_SECTIONS) - 1;
+	// Only air above the heightmap
 	for(uint8_t x = 0; x < CHUNK_SIZE; ++x) {
-		for(uint8_t y = 0; y < CHUNK_HEIGHT; ++y) {
-			for(uint8_t z = 0; z < CHUNK_SIZE; ++z) {
-				prerenderBlock(chunk, x, y, z);
+		for(uint8_t z = 0; z < CHUNK_SIZE; ++z) {
+			uint8_t height = chunks.center.getHeight(x, z);
+			for(uint8_t y = 0; y < height; ++y) {
+				prerenderBlock(chunks, x, y, z);
 			}
 		}
 	}
 }
 
-void RenderedChunk::updateBuffers() {
+void RenderedChunk::updateBuffers(const ChunkNeighbourhood& chunks) {
+	for(int section = 0; section < CHUNK_SECTIONS; ++section) {
+		if(changedSections & (1 << section))
+			_connectivity[section] = SectionConnectivity::compute(chunks.center, section);
+	}
+	changedSections = 0;
+	meshVersion = nextMeshVersion++;
+	
+	groupBySection(buffer, starts);
 	buffer.prerender();
 	translucentBuffer.prerender();
 }
 
-void RenderedChunk::updateBlock(int8_t relX, int8_t y, int8_t relZ) {
+void RenderedChunk::updateBlock(const ChunkNeighbourhood& chunks, int8_t relX, int8_t y, int8_t relZ) {
 	buffer.eraseFaces(relX, y, relZ);
 	translucentBuffer.eraseFaces(relX, y, relZ);
+	if(World::isValidHeight(y)) changedSections |= 1 << (y / CHUNK_SECTION_HEIGHT);
 	
-	Chunk& chunk = world->getChunk(chunkX, chunkZ);
-	prerenderBlock(chunk, relX, y, relZ);
+	prerenderBlock(chunks, relX, y, relZ);
 }
 
-void RenderedChunk::updatePlaneX(int8_t relX) {
+void RenderedChunk::updatePlaneX(const ChunkNeighbourhood& chunks, int8_t relX) {
 	buffer.erasePlaneX(relX);
 	translucentBuffer.erasePlaneX(relX);
 	
-	Chunk& chunk = world->getChunk(chunkX, chunkZ);
-	for(uint8_t y = 0; y < CHUNK_HEIGHT; ++y) {
-		for(uint8_t relZ = 0; relZ < CHUNK_SIZE; ++relZ) {
-			prerenderBlock(chunk, relX, y, relZ);
+	for(uint8_t relZ = 0; relZ < CHUNK_SIZE; ++relZ) {
+		uint8_t height = chunks.center.getHeight(relX, relZ);
+		for(uint8_t y = 0; y < height; ++y) {
+			prerenderBlock(chunks, relX, y, relZ);
 		}
 	}
 }
 
-void RenderedChunk::updatePlaneZ(int8_t relZ) {
+void RenderedChunk::updatePlaneZ(const ChunkNeighbourhood& chunks, int8_t relZ) {
 	buffer.erasePlaneZ(relZ);
 	translucentBuffer.erasePlaneZ(relZ);
 	
-	Chunk& chunk = world->getChunk(chunkX, chunkZ);
-	for(uint8_t y = 0; y < CHUNK_HEIGHT; ++y) {
-		for(uint8_t relX = 0; relX < CHUNK_SIZE; ++relX) {
-			prerenderBlock(chunk, relX, y, relZ);
+	for(uint8_t relX = 0; relX < CHUNK_SIZE; ++relX) {
+		uint8_t height = chunks.center.getHeight(relX, relZ);
+		for(uint8_t y = 0; y < height; ++y) {
+			prerenderBlock(chunks, relX, y, relZ);
 		}
 	}
 }
 
-void RenderedChunk::render(FaceRenderer& faceRenderer) {
-	glm::mat4 model = glm::translate(glm::mat4(1.0f), ((float) CHUNK_SIZE) * glm::vec3(chunkX, 0.0f, chunkZ));
-	faceRenderer.render(buffer, model);
+const SectionConnectivity& RenderedChunk::connectivity(int section) {
+	return _connectivity[section];
+}
+
+void RenderedChunk::render(FaceRenderer& faceRenderer, uint8_t sections) {
+	renderSections(faceRenderer, buffer, starts, sections);
 }
 
 void RenderedChunk::renderTranslucent(FaceRenderer& faceRenderer) {
@@ -87,31 +107,67 @@ void RenderedChunk::renderTranslucent(FaceRenderer& faceRenderer) {
 	faceRenderer.render(translucentBuffer, model);
 }
 
+bool RenderedChunk::needsSorting(const BlockPos& camBlock) {
+	if(sorting || translucentBuffer.faces.size() < 2) return false;
+	return sortedVersion != meshVersion || sortedFrom != camBlock;
+}
+
+uint32_t RenderedChunk::startSorting(const BlockPos& camBlock, std::vector<FaceData>& faces) {
+	sorting = true;
+	sortingVersion = meshVersion;
+	sortingFrom = camBlock;
+	faces = translucentBuffer.faces;
+	return meshVersion;
+}
+
+void RenderedChunk::finishSorting(uint32_t version, std::vector<FaceData>& faces) {
+	if(!sorting || version != sortingVersion) return; // from a chunk that was unloaded since
+	sorting = false;
+	if(version != meshVersion) return;
+	translucentBuffer.faces.swap(faces);
+	translucentBuffer.prerender();
+	sortedVersion = sortingVersion;
+	sortedFrom = sortingFrom;
+}
+
+void RenderedChunk::sortBackToFront(std::vector<FaceData>& faces, glm::vec3 camPos) {
+	// Faces are compared by their centers, half a block from the block center
+	std::vector<std::pair<float, uint32_t>> order(faces.size());
+	for(uint32_t i = 0; i < faces.size(); ++i) {
+		const FaceData& face = faces[i];
+		glm::vec3 center = glm::vec3(face.offsetX(), face.offsetY(), face.offsetZ()) + 0.5f * glm::vec3(
+			sideVectors[face.side()][0], sideVectors[face.side()][1], sideVectors[face.side()][2]);
+		glm::vec3 diff = center - camPos;
+		order[i] = std::make_pair(-glm::dot(diff, diff), i);
+	}
+	std::sort(order.begin(), order.end());
+	std::vector<FaceData> sorted;
+	sorted.reserve(faces.size());
+	for(auto& pair : order) {
+		sorted.push_back(faces[pair.second]);
+	}
+	faces.swap(sorted);
+}
+
 
-void RenderedChunk::prerenderBlock(Chunk& chunk, uint8_t relX, uint8_t y, uint8_t relZ) {
-	Block* block = chunk.getBlock(relX, y, relZ);
-	if(block == nullptr) return;
+void RenderedChunk::prerenderBlock(const ChunkNeighbourhood& chunks, uint8_t relX, uint8_t y, uint8_t relZ) {
+	const ChunkSnapshot& chunk = chunks.center;
+	BlockId id = chunk.getBlockId(relX, y, relZ);
+	if(id == 0) return;
+	bool translucent = BlockRegistry::rendering(id) == BlockRendering::translucentCube;
 	
 	for(uint8_t side = 0; side < 6; ++side) {
 		int32_t x2 = (int32_t) relX + sideVectors[side][0];
 		int32_t y2 = (int32_t) y + sideVectors[side][1];
 		int32_t z2 = (int32_t) relZ + sideVectors[side][2];
 	
-		bool renderFace;
-		if(INVALID_BLOCK_POS(x2, y2, z2)) {
-			int32_t x3 = chunkX*CHUNK_SIZE + x2;
-			int32_t z3 = chunkZ*CHUNK_SIZE + z2;
-			renderFace = !world->hasBlock(x3, y2, z3)
-				|| (!world->isOpaqueCube(x3, y2, z3) && block != world->getBlock(x3, y2, z3));
-		} else {
-			renderFace = !chunk.hasBlock(x2, y2, z2)
-				|| (!chunk.isOpaqueCube(x2, y2, z2) && block != chunk.getBlock(x2, y2, z2));
-		}
+		BlockId id2 = INVALID_BLOCK_POS(x2, y2, z2) ? chunks.getBlockId(x2, y2, z2) : chunk.getBlockId(x2, y2, z2);
+		bool renderFace = id2 == 0 || (!BlockRegistry::isOpaqueCube(id2) && id != id2);
 		if(renderFace) {
 			FaceData face = {
-				relX, y, relZ, side, block->getFaceTexture(side)
+				relX, y, relZ, side, BlockRegistry::faceTexture(id, side)
 			};
-			if(block->rendering() == BlockRendering::translucentCube) {
+			if(translucent) {
 				translucentBuffer.faces.push_back(face);
 			} else {
 				buffer.faces.push_back(face);
@@ -120,113 +176,330 @@ void RenderedChunk::prerenderBlock(Chunk& chunk, uint8_t relX, uint8_t y, uint8_
 	}
 }
 
+void RenderedChunk::groupBySection(FaceBuffer& buffer, SectionStarts& starts) {
+	// Counting sort, which keeps the order of the faces within each section
+	starts.fill(0);
+	for(const FaceData& face : buffer.faces) {
+		starts[face.offsetY() / CHUNK_SECTION_HEIGHT + 1]++;
+	}
+	for(int section = 0; section < CHUNK_SECTIONS; ++section) {
+		starts[section + 1] += starts[section];
+	}
+	std::vector<FaceData> sorted(buffer.faces.size());
+	SectionStarts next = starts;
+	for(const FaceData& face : buffer.faces) {
+		sorted[next[face.offsetY() / CHUNK_SECTION_HEIGHT]++] = face;
+	}
+	buffer.faces.swap(sorted);
+}
+
+void RenderedChunk::renderSections(FaceRenderer& faceRenderer, FaceBuffer& buffer, const SectionStarts& starts, uint8_t sections) {
+	// Consecutive sections are merged into one range
+	firsts.clear();
+	counts.clear();
+	for(int section = 0; section < CHUNK_SECTIONS; ++section) {
+		GLsizei count = starts[section + 1] - starts[section];
+		if(!(sections & (1 << section)) || count == 0) continue;
+		if(!firsts.empty() && firsts.back() + counts.back() == starts[section]) {
+			counts.back() += count;
+		} else {
+			firsts.push_back(starts[section]);
+			counts.push_back(count);
+		}
+	}
+	if(firsts.empty()) return;
+	
+	glm::mat4 model = glm::translate(glm::mat4(1.0f), ((float) CHUNK_SIZE) * glm::vec3(chunkX, 0.0f, chunkZ));
+	faceRenderer.render(buffer, model, firsts, counts);
+}
+
 
 ChunkRenderer::ChunkRenderer(World& world, FaceRenderer& renderer)
-	: world(world), faceRenderer(renderer) { }
+	: world(world), faceRenderer(renderer), _occlusionCulling(true), _drawnSectionCount(0), _frustumSectionCount(0),
+	  cameraPos(0.0f), pendingSorts(0), sortWorkers(1) { }
 
 bool ChunkRenderer::isChunkRendered(int32_t chunkX, int32_t chunkZ) {
 	uint64_t key = packCoords(chunkX, chunkZ);
 	return renderedChunks.count(key) == 1;
 }
 
+bool ChunkRenderer::isChunkDrawn(int32_t chunkX, int32_t chunkZ, int32_t camChunkX, int32_t camChunkZ, int renderDist) {
+	return isInDrawRange(chunkX, chunkZ, camChunkX, camChunkZ, renderDist) && isChunkRendered(chunkX, chunkZ);
+}
+
 size_t ChunkRenderer::renderedChunkCount() {
 	return renderedChunks.size();
 }
 
+bool ChunkRenderer::occlusionCulling() { return _occlusionCulling; }
+void ChunkRenderer::occlusionCulling(bool enabled) { _occlusionCulling = enabled; }
+size_t ChunkRenderer::drawnSectionCount() { return _drawnSectionCount; }
+size_t ChunkRenderer::frustumSectionCount() { return _frustumSectionCount; }
+
 void ChunkRenderer::reset() {
 	renderedChunks.clear();
+	pendingChunks.clear();
+	pendingBlocks.clear();
+	snapshots.clear();
+	culler.clear();
+	visibleChunks.clear();
+	translucentOrder.clear();
 }
 
-void ChunkRenderer::updateBlocks() {
-	std::unordered_set<uint64_t> updatedChunks;
-	
-	std::unordered_set<uint64_t> toPrerender = world.retrieveDirtyChunks();
-	for(uint64_t chunkIdx : toPrerender) {
+void ChunkRenderer::collectUpdates() {
+	for(uint64_t chunkIdx : world.retrieveDirtyChunks()) {
 		int32_t chunkX, chunkZ;
 		std::tie(chunkX, chunkZ) = unpackCoords(chunkIdx);
-		prerenderChunk(updatedChunks, chunkX, chunkZ);
+		RenderedChunk& renderedChunk = renderedChunks[chunkIdx];
+		if(!renderedChunk.isInitialized()) {
+			renderedChunk.init(faceRenderer, chunkX, chunkZ);
+			culler.addChunk(chunkX, chunkZ);
+		}
+		pendingChunks.insert(chunkIdx);
+		
+		// Their border planes are remeshed too
+		takeSnapshot(chunkX, chunkZ);
+		for(int side = 0; side < 4; ++side) {
+			int32_t chunkX2 = chunkX + (side == 0 ? -1 : side == 1 ? 1 : 0);
+			int32_t chunkZ2 = chunkZ + (side == 2 ? -1 : side == 3 ? 1 : 0);
+			if(isChunkRendered(chunkX2, chunkZ2)) takeSnapshot(chunkX2, chunkZ2);
+		}
 	}
 	
 	BlockPosSet toUpdate = world.retrieveDirtyBlocks();
-	BlockPosSet neighbors;
 	int32_t x, y, z;
 	for(BlockPos blockPos : toUpdate) {
 		std::tie(x, y, z) = blockPos;
+		pendingBlocks.insert(blockPos);
 		for(int side = 0; side < 6; ++side) {
-			neighbors.emplace(x + sideVectors[side][0], y + sideVectors[side][1], z + sideVectors[side][2]);
+			pendingBlocks.emplace(x + sideVectors[side][0], y + sideVectors[side][1], z + sideVectors[side][2]);
 		}
 	}
-	toUpdate.insert(neighbors.begin(), neighbors.end());
-	for(BlockPos blockPos : toUpdate) {
+	for(BlockPos blockPos : pendingBlocks) {
+		std::tie(x, y, z) = blockPos;
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = World::getChunkPosAt(x, z);
+		if(isChunkRendered(chunkX, chunkZ)) takeSnapshot(chunkX, chunkZ);
+	}
+}
+
+size_t ChunkRenderer::updateBlocks() {
+	std::unordered_set<uint64_t> updatedChunks;
+	
+	for(uint64_t chunkIdx : pendingChunks) {
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = unpackCoords(chunkIdx);
+		prerenderChunk(updatedChunks, chunkX, chunkZ);
+	}
+	
+	int32_t x, y, z;
+	for(BlockPos blockPos : pendingBlocks) {
 		std::tie(x, y, z) = blockPos;
 		updateBlock(updatedChunks, x, y, z);
 	}
 	
 	for(uint64_t chunkIdx : updatedChunks) {
-		renderedChunks[chunkIdx].updateBuffers();
+		renderedChunks[chunkIdx].updateBuffers(snapshots.at(chunkIdx));
 	}
+	
+	size_t meshed = pendingChunks.size();
+	pendingChunks.clear();
+	pendingBlocks.clear();
+	snapshots.clear();
+	return meshed;
 }
 
-void ChunkRenderer::render(int32_t camChunkX, int32_t camChunkZ, int renderDist, ViewFrustum& vf) {
+void ChunkRenderer::unloadFarChunks(int32_t camChunkX, int32_t camChunkZ, int renderDist) {
 	for(auto iter = renderedChunks.begin(); iter != renderedChunks.end();) {
 		int32_t chunkX, chunkZ;
 		std::tie(chunkX, chunkZ) = unpackCoords(iter->first);
 		int32_t dist = (chunkX-camChunkX)*(chunkX-camChunkX) + (chunkZ-camChunkZ)*(chunkZ-camChunkZ);
 		if(dist >= (renderDist+5)*(renderDist+5)) {
+			culler.removeChunk(chunkX, chunkZ);
 			iter = renderedChunks.erase(iter);
 		} else {
-			if(dist <= (renderDist+2)*(renderDist+2) && isVisible(vf, chunkX, chunkZ)) {
-				RenderedChunk& chunk = iter->second;
-				chunk.render(faceRenderer);
-			}
 			++iter;
 		}
 	}
 }
 
-void ChunkRenderer::renderTranslucent(int32_t camChunkX, int32_t camChunkZ, int renderDist, ViewFrustum& vf) {
+void ChunkRenderer::cullSections(glm::vec3 camPos, int renderDist, ViewFrustum& vf) {
+	int32_t camX, camY, camZ;
+	std::tie(camX, camY, camZ) = getBlockCoordsAt(camPos);
+	int32_t camChunkX, camChunkZ;
+	std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(camX, camZ);
+	
+	// Frustum culling alone, which occlusion culling is compared against; same range as isInDrawRange
+	culler.cull(vf, camChunkX, camChunkZ, renderDist + 2, visibleChunks);
+	_frustumSectionCount = 0;
+	for(const VisibleChunk& chunk : visibleChunks) {
+		_frustumSectionCount += __builtin_popcount(chunk.sections);
+	}
+	_drawnSectionCount = _frustumSectionCount;
+	
+	if(_occlusionCulling) {
+		// From above or below the world, start from the nearest section
+		int camSection = std::min(std::max(camY, 0), CHUNK_HEIGHT - 1) / CHUNK_SECTION_HEIGHT;
+		findVisibleSections(camChunkX, camSection, camChunkZ, renderDist, vf);
+	}
+	
+	cameraPos = camPos;
+	std::vector<std::pair<float, uint64_t>> distances;
+	for(const VisibleChunk& chunk : visibleChunks) {
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = unpackCoords(chunk.key);
+		glm::vec2 center = ((float) CHUNK_SIZE) * glm::vec2(chunkX + 0.5f, chunkZ + 0.5f) - 0.5f;
+		glm::vec2 diff = center - glm::vec2(camPos.x, camPos.z);
+		distances.emplace_back(-glm::dot(diff, diff), chunk.key);
+	}
+	std::sort(distances.begin(), distances.end());
+	translucentOrder.clear();
+	for(auto& pair : distances) {
+		translucentOrder.push_back(pair.second);
+	}
+}
+
+void ChunkRenderer::render() {
+	for(const VisibleChunk& chunk : visibleChunks) {
+		auto chunkIter = renderedChunks.find(chunk.key);
+		if(chunkIter != renderedChunks.end()) chunkIter->second.render(faceRenderer, chunk.sections);
+	}
+}
+
+void ChunkRenderer::sortTranslucentFaces() {
+	std::vector<SortedFaces> finished;
+	sortedFaces.popAll(finished);
+	pendingSorts -= finished.size();
+	for(SortedFaces& result : finished) {
+		auto chunkIter = renderedChunks.find(result.key);
+		if(chunkIter != renderedChunks.end()) chunkIter->second.finishSorting(result.version, result.faces);
+	}
+	
+	BlockPos camBlock = getBlockCoordsAt(cameraPos);
+	int32_t camChunkX, camChunkZ;
+	std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(std::get<0>(camBlock), std::get<2>(camBlock));
+	// Nearest first, as they are the most noticeable
+	for(auto iter = translucentOrder.rbegin(); iter != translucentOrder.rend() && pendingSorts < MAX_PENDING_SORTS; ++iter) {
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = unpackCoords(*iter);
+		if(std::abs(chunkX - camChunkX) > SORT_DISTANCE || std::abs(chunkZ - camChunkZ) > SORT_DISTANCE) continue;
+		RenderedChunk& chunk = renderedChunks.at(*iter);
+		if(!chunk.needsSorting(camBlock)) continue;
+		
+		SortedFaces result;
+		result.key = *iter;
+		result.version = chunk.startSorting(camBlock, result.faces);
+		// Relative to the chunk, from the center of the camera's block
+		glm::vec3 camPos((float) (std::get<0>(camBlock) - chunkX*CHUNK_SIZE), (float) std::get<1>(camBlock),
+			(float) (std::get<2>(camBlock) - chunkZ*CHUNK_SIZE));
+		pendingSorts++;
+		sortWorkers.submit([this, result = std::move(result), camPos]() mutable {
+			RenderedChunk::sortBackToFront(result.faces, camPos);
+			sortedFaces.push(std::move(result));
+		});
+	}
+}
+
+void ChunkRenderer::renderTranslucent() {
 	glDepthMask(GL_FALSE);
 	glDisable(GL_CULL_FACE);
-	for(int32_t x = camChunkX - renderDist; x <= camChunkX + renderDist; ++x) {
-		for(int32_t z = camChunkZ - renderDist; z <= camChunkZ + renderDist; ++z) {
-			auto chunkIter = renderedChunks.find(packCoords(x, z));
-			if(chunkIter != renderedChunks.end() && isVisible(vf, x, z)) {
-				chunkIter->second.renderTranslucent(faceRenderer);
-			}
-		}
+	for(uint64_t key : translucentOrder) {
+		auto chunkIter = renderedChunks.find(key);
+		if(chunkIter != renderedChunks.end()) chunkIter->second.renderTranslucent(faceRenderer);
 	}
 	glDepthMask(GL_TRUE);
 	glEnable(GL_CULL_FACE);
 }
 
+void ChunkRenderer::findVisibleSections(int32_t camChunkX, int camSection, int32_t camChunkZ, int renderDist, ViewFrustum& vf) {
+	struct Step {
+		int32_t chunkX, chunkZ;
+		int section;
+		int entrySide; // -1 for the camera's section
+		uint8_t directions; // sides moved through so far; never moving back keeps the search going away from the camera
+	};
+	std::unordered_map<uint64_t, uint8_t> visited; // bitmask of sections, by chunk
+	std::vector<Step> queue;
+	queue.push_back({ camChunkX, camChunkZ, camSection, -1, 0 });
+	visited[packCoords(camChunkX, camChunkZ)] = 1 << camSection;
+	
+	std::unordered_map<uint64_t, uint8_t> frustumSections, visibleSections;
+	for(const VisibleChunk& chunk : visibleChunks) {
+		frustumSections[chunk.key] = chunk.sections;
+	}
+	_drawnSectionCount = 0;
+	
+	for(size_t i = 0; i < queue.size(); ++i) {
+		Step step = queue[i];
+		uint64_t key = packCoords(step.chunkX, step.chunkZ);
+		auto chunkIter = renderedChunks.find(key);
+		auto frustumIter = frustumSections.find(key);
+		if(frustumIter != frustumSections.end() && (frustumIter->second & (1 << step.section))) {
+			visibleSections[key] |= 1 << step.section;
+			_drawnSectionCount++;
+		}
+		
+		for(int side = 0; side < 6; ++side) {
+			if(step.directions & (1 << oppositeSide(side))) continue;
+			if(step.entrySide != -1 && chunkIter != renderedChunks.end()
+					&& !chunkIter->second.connectivity(step.section).connects(step.entrySide, side))
+				continue;
+			int32_t chunkX2 = step.chunkX + sideVectors[side][0];
+			int32_t chunkZ2 = step.chunkZ + sideVectors[side][2];
+			int section2 = step.section + sideVectors[side][1];
+			if(section2 < 0 || section2 >= CHUNK_SECTIONS) continue;
+			if(!isInDrawRange(chunkX2, chunkZ2, camChunkX, camChunkZ, renderDist)) continue;
+			if(!isSectionVisible(vf, chunkX2, section2, chunkZ2)) continue;
+			uint8_t& visitedSections = visited[packCoords(chunkX2, chunkZ2)];
+			if(visitedSections & (1 << section2)) continue;
+			visitedSections |= 1 << section2;
+			queue.push_back({ chunkX2, chunkZ2, section2, oppositeSide(side), (uint8_t) (step.directions | (1 << side)) });
+		}
+	}
+	
+	visibleChunks.clear();
+	for(auto& pair : visibleSections) {
+		visibleChunks.push_back({ pair.first, pair.second });
+	}
+}
+
+bool ChunkRenderer::isInDrawRange(int32_t chunkX, int32_t chunkZ, int32_t camChunkX, int32_t camChunkZ, int renderDist) {
+	int32_t dist = (chunkX-camChunkX)*(chunkX-camChunkX) + (chunkZ-camChunkZ)*(chunkZ-camChunkZ);
+	return dist <= (renderDist+2)*(renderDist+2);
+}
+
+void ChunkRenderer::takeSnapshot(int32_t chunkX, int32_t chunkZ) {
+	uint64_t key = packCoords(chunkX, chunkZ);
+	if(snapshots.count(key) == 0)
+		snapshots.emplace(key, world.snapshotNeighbourhood(chunkX, chunkZ));
+}
+
 void ChunkRenderer::prerenderChunk(std::unordered_set<uint64_t>& updated, int32_t chunkX, int32_t chunkZ) {
 	uint64_t key = packCoords(chunkX, chunkZ);
-	RenderedChunk& renderedChunk = renderedChunks[key];
-	if(!renderedChunk.isInitialized())
-		renderedChunk.init(world, faceRenderer, chunkX, chunkZ);
-	renderedChunk.prerender();
+	auto chunkIter = renderedChunks.find(key);
+	if(chunkIter == renderedChunks.end()) return;
+	chunkIter->second.prerender(snapshots.at(key));
 	updated.insert(key);
 	
 	// Update nearby chunks
 	key = packCoords(chunkX - 1, chunkZ);
-	std::unordered_map<uint64_t, RenderedChunk>::iterator chunkIter;
 	if((chunkIter = renderedChunks.find(key)) != renderedChunks.end()) {
-		chunkIter->second.updatePlaneX(CHUNK_SIZE - 1);
+		chunkIter->second.updatePlaneX(snapshots.at(key), CHUNK_SIZE - 1);
 		updated.insert(key);
 	}
 	key = packCoords(chunkX + 1, chunkZ);
 	if((chunkIter = renderedChunks.find(key)) != renderedChunks.end()) {
-		chunkIter->second.updatePlaneX(0);
+		chunkIter->second.updatePlaneX(snapshots.at(key), 0);
 		updated.insert(key);
 	}
 	key = packCoords(chunkX, chunkZ - 1);
 	if((chunkIter = renderedChunks.find(key)) != renderedChunks.end()) {
-		chunkIter->second.updatePlaneZ(CHUNK_SIZE - 1);
+		chunkIter->second.updatePlaneZ(snapshots.at(key), CHUNK_SIZE - 1);
 		updated.insert(key);
 	}
 	key = packCoords(chunkX, chunkZ + 1);
 	if((chunkIter = renderedChunks.find(key)) != renderedChunks.end()) {
-		chunkIter->second.updatePlaneZ(0);
+		chunkIter->second.updatePlaneZ(snapshots.at(key), 0);
 		updated.insert(key);
 	}
 }
@@ -238,5 +511,5 @@ void ChunkRenderer::updateBlock(std::unordered_set<uint64_t>& updated, int32_t x
 	auto iter = renderedChunks.find(chunkIdx);
 	if(iter == renderedChunks.end()) return;
 	updated.insert(chunkIdx);
-	iter->second.updateBlock(x - chunkX*CHUNK_SIZE, y, z - chunkZ*CHUNK_SIZE);
-}
\ No newline at end of file
+	iter->second.updateBlock(snapshots.at(chunkIdx), x - chunkX*CHUNK_SIZE, y, z - chunkZ*CHUNK_SIZE);
+}
@@ -2,51 +2,115 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
+#include <array>
 
 #include <stb_image.h>
 
 #include "pixcraft/server/world.hpp"
+#include "pixcraft/server/chunk.hpp"
 #include "face_renderer.hpp"
 #include "view_frustum.hpp"
+#include "section_connectivity.hpp"
+#include "section_culler.hpp"
+#include "pixcraft/util/worker_pool.hpp"
+#include "pixcraft/util/mpsc_queue.hpp"
 
 namespace PixCraft {
 	class RenderedChunk {
 	public:
-		void init(World& world, FaceRenderer& faceRenderer, int32_t chunkX, int32_t chunkZ);
+		void init(FaceRenderer& faceRenderer, int32_t chunkX, int32_t chunkZ);
 		bool isInitialized();
 		
-		void prerender();
-		void updateBuffers();
+		// Meshing only reads the snapshots of the chunk and its neighbours, not the world
+		void prerender(const ChunkNeighbourhood& chunks);
+		// Also recomputes the connectivity of the sections that changed
+		void updateBuffers(const ChunkNeighbourhood& chunks);
 		
-		void updateBlock(int8_t relX, int8_t y, int8_t relZ);
-		void updatePlaneX(int8_t relX);
-		void updatePlaneZ(int8_t relZ);
+		void updateBlock(const ChunkNeighbourhood& chunks, int8_t relX, int8_t y, int8_t relZ);
+		void updatePlaneX(const ChunkNeighbourhood& chunks, int8_t relX);
+		void updatePlaneZ(const ChunkNeighbourhood& chunks, int8_t relZ);
 		
-		void render(FaceRenderer& faceRenderer);
+		const SectionConnectivity& connectivity(int section);
+		
+		// Only draws the sections whose bit is set
+		void render(FaceRenderer& faceRenderer, uint8_t sections);
+		// Draws all the translucent faces, which aren't grouped by section so that they can be sorted
 		void renderTranslucent(FaceRenderer& faceRenderer);
 		
+		// Translucent faces are sorted back to front on a worker thread, and only sorted again
+		// once the chunk is remeshed or the camera moves to another block
+		bool needsSorting(const BlockPos& camBlock);
+		// Copies the faces to sort, and returns the mesh version to pass to finishSorting
+		uint32_t startSorting(const BlockPos& camBlock, std::vector<FaceData>& faces);
+		// Uploads the sorted faces, unless the chunk was remeshed since they were copied
+		void finishSorting(uint32_t version, std::vector<FaceData>& faces);
+		
+		// Sorts the faces by decreasing distance from a point relative to the chunk
+		static void sortBackToFront(std::vector<FaceData>& faces, glm::vec3 camPos);
+		
 	private:
-		World* world;
+		// Faces are grouped by section when uploaded; starts[i] is the first face of section i, and starts[CHUNK_SECTIONS] the total
+		typedef std::array<GLint, CHUNK_SECTIONS + 1> SectionStarts;
+		
 		FaceBuffer buffer;
 		FaceBuffer translucentBuffer;
+		SectionStarts starts;
 		int32_t chunkX, chunkZ;
 		
-		void prerenderBlock(Chunk& chunk, uint8_t relX, uint8_t y, uint8_t relZ);
+		static uint32_t nextMeshVersion; // versions are unique across chunks, so that a sort never lands on a reloaded chunk
+		uint32_t meshVersion; // changed by updateBuffers
+		uint32_t sortedVersion, sortingVersion;
+		BlockPos sortedFrom, sortingFrom;
+		bool sorting;
+		
+		std::array<SectionConnectivity, CHUNK_SECTIONS> _connectivity;
+		uint8_t changedSections;
+		
+		std::vector<GLint> firsts; // reused by renderSections
+		std::vector<GLsizei> counts;
+		
+		void prerenderBlock(const ChunkNeighbourhood& chunks, uint8_t relX, uint8_t y, uint8_t relZ);
+		static void groupBySection(FaceBuffer& buffer, SectionStarts& starts);
+		void renderSections(FaceRenderer& faceRenderer, FaceBuffer& buffer, const SectionStarts& starts, uint8_t sections);
 	};
 	
 	class ChunkRenderer {
 	public:
+		static const int SORT_DISTANCE = 8; // in chunks; further away, translucent faces stay in mesh order
+		static const size_t MAX_PENDING_SORTS = 16;
+		
 		ChunkRenderer(World& world, FaceRenderer& renderer);
 		
 		bool isChunkRendered(int32_t chunkX, int32_t chunkZ);
+		// Whether render draws the chunk, frustum culling aside
+		bool isChunkDrawn(int32_t chunkX, int32_t chunkZ, int32_t camChunkX, int32_t camChunkZ, int renderDist);
 		size_t renderedChunkCount();
 		
+		// Sections hidden behind others are skipped when enabled, otherwise only frustum culling is done
+		bool occlusionCulling();
+		void occlusionCulling(bool enabled);
+		// Sections drawn, and sections in the frustum, at the last cullSections
+		size_t drawnSectionCount();
+		size_t frustumSectionCount();
+		
 		void reset();
 		
-		void updateBlocks();
+		// Takes snapshots of the chunks that need remeshing; requires the world to be locked, but is cheap
+		void collectUpdates();
+		// Remeshes from the snapshots taken by the last collectUpdates, without accessing the world;
+		// returns the number of chunks that were fully remeshed
+		size_t updateBlocks();
+		void unloadFarChunks(int32_t camChunkX, int32_t camChunkZ, int renderDist);
 		
-		void render(int32_t camChunkX, int32_t chamChunkZ, int renderDist, ViewFrustum& vf);
-		void renderTranslucent(int32_t camChunkX, int32_t chamChunkZ, int renderDist, ViewFrustum& vf);
+		// Chooses the sections that render and renderTranslucent will draw; call once per frame, before them
+		void cullSections(glm::vec3 camPos, int renderDist, ViewFrustum& vf);
+		void render();
+		// Starts sorting the translucent faces of the nearby visible chunks that need it, and uploads the sorted ones;
+		// call after cullSections
+		void sortTranslucentFaces();
+		// Draws the chunks back to front
+		void renderTranslucent();
 		
 	private:
 		World& world;
@@ -54,6 +118,33 @@ namespace PixCraft {
 		
 		std::unordered_map<uint64_t, RenderedChunk> renderedChunks;
 		
+		std::unordered_set<uint64_t> pendingChunks;
+		BlockPosSet pendingBlocks;
+		std::unordered_map<uint64_t, ChunkNeighbourhood> snapshots;
+		
+		bool _occlusionCulling;
+		SectionCuller culler; // holds every rendered chunk
+		std::vector<VisibleChunk> visibleChunks; // the sections to draw
+		size_t _drawnSectionCount, _frustumSectionCount;
+		glm::vec3 cameraPos; // at the last cullSections
+		std::vector<uint64_t> translucentOrder; // visible chunks, back to front
+		
+		struct SortedFaces {
+			uint64_t key;
+			uint32_t version;
+			std::vector<FaceData> faces;
+		};
+		MpscQueue<SortedFaces> sortedFaces;
+		size_t pendingSorts;
+		
+		WorkerPool sortWorkers; // declared last, so that the sorts are done before the rest is destroyed
+		
+		// Narrows visibleChunks down by flood filling the sections from the camera's,
+		// through the faces each section connects, moving away from the camera.
+		// Chunks that aren't rendered yet are crossed as if they were empty.
+		void findVisibleSections(int32_t camChunkX, int camSection, int32_t camChunkZ, int renderDist, ViewFrustum& vf);
+		static bool isInDrawRange(int32_t chunkX, int32_t chunkZ, int32_t camChunkX, int32_t camChunkZ, int renderDist);
+		void takeSnapshot(int32_t chunkX, int32_t chunkZ);
 		void prerenderChunk(std::unordered_set<uint64_t>& updated, int32_t chunkX, int32_t chunkZ);
 		void updateBlock(std::unordered_set<uint64_t>& updated, int32_t x, int32_t y, int32_t z);
 	};
@@ -3,11 +3,14 @@
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
+#include <iomanip>
 
 #include "play_state.hpp"
 #include "menu_state.hpp"
 
 #include "pixcraft/util/version.hpp"
+#include "pixcraft/util/profiler.hpp"
+#include "pixcraft/util/random.hpp"
 
 using namespace PixCraft;
 
@@ -17,17 +20,21 @@ void glfwErrorCallback(int error, const char* desc) {
 
 GameState::GameState(GameClient& client) : client(client) {}
 
+uint64_t GameState::worldChecksum() { return 0; }
+
 void windowResizeCallback(GLFWwindow* window, int width, int height) {
 	GameClient& client = *((GameClient*) glfwGetWindowUserPointer(window));
 	client.setViewportSize(width, height);
 }
 
-GameClient::GameClient() : width(START_WIDTH), height(START_HEIGHT), nextGameState(nullptr), frameNo(0), FPS(0.0), fullscreen(false) {
+GameClient::GameClient(bool visible) : width(START_WIDTH), height(START_HEIGHT), nextGameState(nullptr), frameNo(0), FPS(0.0), frameTime(0.0f), startupTime(0.0f), fullscreen(false),
+		facePipeline(FacePipeline::geometryShader), pipelineCheck(false) {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
 	glfwWindowHint(GLFW_SAMPLES, 4);
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 	
 	std::string title = "PixCraft " + getVersionString();
 	window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
@@ -93,6 +100,11 @@ GLFWmonitor* getCurrentMonitor(GLFWwindow *window) {
 }
 
 void GameClient::run() {
+	// Recorded and replayed runs use a fixed time step, so the simulation only depends on the inputs
+	bool fixedStep = isDeterministic();
+	if(input.getRecording().isReplaying()) glfwSwapInterval(0);
+	std::vector<float> frameTimes;
+	
 	glfwSetTime(0.0);
 	
 	int frameCounter = 0;
@@ -108,7 +120,15 @@ void GameClient::run() {
 		}
 		
 		glfwPollEvents();
-		gameState->update(dt);
+		if(!input.beginFrame()) {
+			printReplayStats(frameTimes);
+			break;
+		}
+		double frameStart = glfwGetTime();
+		{
+			Profiler::Scope scope("update");
+			gameState->update(dt);
+		}
 		if(input.justPressed(GLFW_KEY_F11)) {
 			fullscreen = !fullscreen;
 			if(fullscreen) {
@@ -126,10 +146,17 @@ void GameClient::run() {
 		}
 		input.clearAll();
 		
-		gameState->render(width, height);
+		{
+			Profiler::Scope scope("render");
+			gameState->render(width, height);
+		}
+		textRenderer.endFrame();
 		
 		now = glfwGetTime();
-		if(frameNo != 0) {
+		frameTime = (now - frameStart) * 1000;
+		if(fixedStep) {
+			if(frameNo != 0) frameTimes.push_back(now - lastFrame);
+		} else if(frameNo != 0) {
 			dt = now - lastFrame;
 			if(dt > 1 / 30.0) {
 				std::cout << "Can't keep up!" << std::endl;
@@ -151,7 +178,35 @@ void GameClient::run() {
 		}
 		
 		glfwSwapBuffers(window);
+		if(frameNo == 1) {
+			startupTime = Profiler::now() / 1000.0f;
+			std::cout << "Time to first frame: " << std::fixed << std::setprecision(1) << startupTime << " ms"
+				<< std::defaultfloat << std::endl;
+		}
+		Profiler::endFrame();
+	}
+}
+
+bool GameClient::runPipelineCheck() {
+	pipelineCheck = true;
+	PlayState state(*this);
+	return state.checkFacePipelines(width, height);
+}
+
+void GameClient::printReplayStats(std::vector<float>& frameTimes) {
+	std::cout << "Replay finished after " << frameNo << " frames" << std::endl;
+	std::cout << std::fixed << std::setprecision(2) << "Time to first frame (ms): " << startupTime << std::endl;
+	if(!frameTimes.empty()) {
+		std::sort(frameTimes.begin(), frameTimes.end());
+		float sum = 0;
+		for(float time : frameTimes) sum += time;
+		auto percentile = [&](size_t p) { return frameTimes[std::min(frameTimes.size() - 1, frameTimes.size() * p / 100)]; };
+		std::cout << std::fixed << std::setprecision(2)
+			<< "Frame time (ms): avg " << 1000 * sum / frameTimes.size()
+			<< ", min " << 1000 * frameTimes.front() << ", max " << 1000 * frameTimes.back()
+			<< ", p50 " << 1000 * percentile(50) << ", p99 " << 1000 * percentile(99) << std::endl;
 	}
+	std::cout << "World checksum: " << std::hex << gameState->worldChecksum() << std::dec << std::endl;
 }
 
 void GameClient::stop() {
@@ -177,13 +232,65 @@ void GameClient::setGameState(GameState* newGameState) {
 
 int GameClient::getFrameNo() { return frameNo; }
 int GameClient::getFPS() { return FPS; }
+float GameClient::getFrameTime() { return frameTime; }
+float GameClient::getStartupTime() { return startupTime; }
 
-int main() {
+uint64_t GameClient::newWorldSeed() {
+	if(pipelineCheck)
+		return PIPELINE_CHECK_SEED;
+	if(isDeterministic())
+		return input.getRecording().seed();
+	return generateSeed();
+}
+
+bool GameClient::isDeterministic() {
+	InputRecording& recording = input.getRecording();
+	return pipelineCheck || recording.isRecording() || recording.isReplaying();
+}
+
+FacePipeline GameClient::getFacePipeline() { return facePipeline; }
+void GameClient::setFacePipeline(FacePipeline pipeline) { facePipeline = pipeline; }
+
+int main(int argc, char** argv) {
+	std::string recordPath, replayPath;
+	FacePipeline facePipeline = FacePipeline::geometryShader;
+	bool pipelineCheck = false;
+	bool validArgs = true;
+	for(int i = 1; i < argc && validArgs; ++i) {
+		std::string arg = argv[i];
+		if(arg == "--record" && i+1 < argc) {
+			recordPath = argv[++i];
+		} else if(arg == "--replay" && i+1 < argc) {
+			replayPath = argv[++i];
+		} else if(arg == "--face-pipeline" && i+1 < argc) {
+			std::string name = argv[++i];
+			if(name == "geometry") facePipeline = FacePipeline::geometryShader;
+			else if(name == "instanced") facePipeline = FacePipeline::instanced;
+			else validArgs = false;
+		} else if(arg == "--pipeline-check") {
+			pipelineCheck = true;
+		} else {
+			validArgs = false;
+		}
+	}
+	if(!validArgs) {
+		std::cout << "Usage: " << argv[0] << " [--record <file> | --replay <file>] [--face-pipeline geometry|instanced] [--pipeline-check]" << std::endl;
+		return 1;
+	}
+	
 	glfwSetErrorCallback(glfwErrorCallback);
 	glfwInit();
 	
 	try {
-		GameClient client;
+		GameClient client(!pipelineCheck);
+		client.setFacePipeline(facePipeline);
+		if(pipelineCheck) {
+			bool match = client.runPipelineCheck();
+			glfwTerminate();
+			return match ? 0 : 1;
+		}
+		if(!recordPath.empty()) client.getInputManager().getRecording().startRecording(recordPath, generateSeed());
+		if(!replayPath.empty()) client.getInputManager().getRecording().startReplay(replayPath);
 		client.run();
 	} catch(std::runtime_error& err) {
 		std::cout << "A runtime error occured: " << err.what() << std::endl;
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include "glfw.hpp"
 
 #include "input.hpp"
 #include "text.hpp"
+#include "face_renderer.hpp"
 
 namespace PixCraft {
 	class GameClient;
@@ -17,6 +19,7 @@ namespace PixCraft {
 		
 		virtual void update(float dt) = 0;
 		virtual void render(int winWidth, int winHeight) = 0;
+		virtual uint64_t worldChecksum();
 		
 	protected:
 		GameClient& client;
@@ -24,11 +27,14 @@ namespace PixCraft {
 	
 	class GameClient {
 	public:
-		GameClient();
+		// The window stays hidden for checks that only render offscreen
+		GameClient(bool visible);
 		~GameClient();
 		
 		void run();
 		void stop();
+		// Compares the face pipelines on a fixed world and camera, instead of running the game; returns true if they match
+		bool runPipelineCheck();
 		
 		InputManager& getInputManager();
 		TextRenderer& getTextRenderer();
@@ -38,10 +44,24 @@ namespace PixCraft {
 		
 		int getFrameNo();
 		int getFPS();
+		// Time spent updating and rendering the last frame, in ms, not counting the wait for the buffer swap
+		float getFrameTime();
+		// From process start to the first frame on screen, in ms; 0 until then
+		float getStartupTime();
+		
+		// Seed for new worlds; recordings and the pipeline check pin it so that they generate the same terrain
+		uint64_t newWorldSeed();
+		// True when recording or replaying inputs, or checking the pipelines: the game must then not depend on timings
+		bool isDeterministic();
+		
+		// Chosen at startup, with --face-pipeline
+		FacePipeline getFacePipeline();
+		void setFacePipeline(FacePipeline pipeline);
 		
 	private:
 		static const int START_WIDTH = 800;
 		static const int START_HEIGHT = 600;
+		static const uint64_t PIPELINE_CHECK_SEED = 1;
 		
 		GLFWwindow* window;
 		int width, height;
@@ -54,8 +74,14 @@ namespace PixCraft {
 		
 		int frameNo;
 		int FPS;
+		float frameTime;
+		float startupTime;
 		bool fullscreen;
 		int windowedWidth, windowedHeight;
+		FacePipeline facePipeline;
+		bool pipelineCheck;
+		
+		void printReplayStats(std::vector<float>& frameTimes);
 		
 		friend void windowResizeCallback(GLFWwindow* window, int width, int height);
 	};
@@ -1,6 +1,7 @@
 #include "console.hpp"
 
 #include <iostream>
+#include <sstream>
 
 #include "utf8.h"
 
@@ -15,6 +16,10 @@ void Console::resetCommands() {
 }
 
 void Console::addCommand(std::string command, std::function<void()> callback) {
+	commands[command] = [callback](const Arguments& args) { callback(); };
+}
+
+void Console::addCommand(std::string command, std::function<void(const Arguments&)> callback) {
 	commands[command] = callback;
 }
 
@@ -103,9 +108,16 @@ void Console::render(TextRenderer& textRenderer, int winW, int winH) {
 }
 
 void Console::executeCommand(std::string command) {
-	auto it = commands.find(command);
+	std::istringstream words(command);
+	std::string name;
+	words >> name;
+	Arguments args;
+	std::string arg;
+	while(words >> arg) args.push_back(arg);
+	
+	auto it = commands.find(name);
 	if(it != commands.end()) {
-		it->second();
+		it->second(args);
 	} else {
 		write("Unrecognized command: '" + command + "'");
 	}
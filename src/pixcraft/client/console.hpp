@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <deque>
 #include <functional>
 #include <unordered_map>
@@ -15,8 +16,12 @@ namespace PixCraft {
 		
 		bool isOpen();
 		
+		typedef std::vector<std::string> Arguments;
+		
 		void resetCommands();
 		void addCommand(std::string command, std::function<void()> callback);
+		// The arguments are the words following the command, separated by spaces
+		void addCommand(std::string command, std::function<void(const Arguments&)> callback);
 		
 		void write(std::string line);
 		void clearHistory();
@@ -27,7 +32,7 @@ namespace PixCraft {
 	private:
 		bool open;
 		std::deque<std::string> history;
-		std::unordered_map<std::string, std::function<void()>> commands;
+		std::unordered_map<std::string, std::function<void(const Arguments&)>> commands;
 		
 		std::string inputBuffer;
 		uint32_t cursorPos;
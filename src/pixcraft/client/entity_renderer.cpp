@@ -1,12 +1,9 @@
 #include "entity_renderer.hpp"
 
 #include <cstddef>
-#include <typeinfo>
 #include <array>
 
-#include "pixcraft/server/world.hpp"
-#include "pixcraft/server/mob.hpp"
-#include "pixcraft/server/slime.hpp"
+#include "pixcraft/util/serializer_generated.h"
 
 using namespace PixCraft;
 
@@ -63,22 +60,28 @@ void EntityModel::render() {
 
 void EntityRenderer::init() {
 	program.init(ShaderSources::entityVS, ShaderSources::entityFS);
+	program.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+	program.use();
+	program.setUniform("tex", (uint32_t) 0);
+	program.setUniform("ambientLight", 0.7f);
+	program.unuse();
+	modelLocation = program.uniformLocation("model");
 	
 	glm::mat4 preModel = glm::translate(glm::scale(glm::mat4(1.0), glm::vec3(0.3f, 0.3f, 0.3f)), glm::vec3(0.0f, 1.0f, 0.0f));
 	slimeModel.init(TEX(SLIME), slimeVertices, slimeIndices, preModel);
 }
 
-void EntityRenderer::renderEntities(World& world, glm::mat4 proj, glm::mat4 view, RenderParams params) {
-	startRendering(proj, view, params);
+void EntityRenderer::renderEntities(std::vector<MobSnapshot>& mobs, RenderParams params) {
+	startRendering(params);
 	
 	EntityModel* model;
-	for(auto it = world.mobs.begin(); it != world.mobs.end(); ++it) {
+	for(MobSnapshot& mob : mobs) {
 		model = nullptr;
-		if(typeid(**it) == typeid(Slime)) {
+		if(mob.type == Serializer::Mob_Slime) {
 			model = &slimeModel;
 		}
 		if(model != nullptr) {
-			glm::mat4 modelMat = glm::translate(glm::mat4(1.0f), (*it)->pos());
+			glm::mat4 modelMat = glm::translate(glm::mat4(1.0f), mob.pos);
 			model->bindTexture();
 			render(*model, modelMat);
 		}
@@ -87,27 +90,17 @@ void EntityRenderer::renderEntities(World& world, glm::mat4 proj, glm::mat4 view
 	stopRendering();
 }
 
-void EntityRenderer::startRendering(glm::mat4 proj, glm::mat4 view, RenderParams params) {
+void EntityRenderer::startRendering(RenderParams params) {
 	program.use();
 	
 	program.setUniform("applyView", params.applyView);
 	program.setUniform("applyFog", params.applyFog);
-	program.setUniform("fogColor", params.skyColor[0], params.skyColor[1], params.skyColor[2], 1.0f);
-	program.setUniform("fogStart", params.fogStart);
-	program.setUniform("fogEnd", params.fogEnd);
-	
-	program.setUniform("view", view);
-	program.setUniform("proj", proj);
-	
-	program.setUniform("tex", (uint32_t) 0);
-	
-	program.setUniform("ambientLight", 0.7f);
 }
 
 void EntityRenderer::render(EntityModel& model, glm::mat4 modelMat) {
 	glm::mat4 preModel = model.preModel();
 	modelMat = modelMat * preModel;
-	program.setUniform("model", modelMat);
+	program.setUniform(modelLocation, modelMat);
 	
 	model.render();
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <vector>
 
 #include "glfw.hpp"
 #include "pixcraft/util/glm.hpp"
@@ -9,6 +10,7 @@
 #include "textures.hpp"
 
 #include "pixcraft/server/world_module.hpp"
+#include "pixcraft/server/simulation.hpp"
 
 namespace PixCraft {
 	class EntityModel {
@@ -32,14 +34,16 @@ namespace PixCraft {
 	public:
 		void init();
 		
-		void renderEntities(World& world, glm::mat4 proj, glm::mat4 view, RenderParams params);
+		// The view and projection come from FrameData
+		void renderEntities(std::vector<MobSnapshot>& mobs, RenderParams params);
 		
 	private:
 		ShaderProgram program;
+		GLint modelLocation;
 		
 		EntityModel slimeModel;
 		
-		void startRendering(glm::mat4 proj, glm::mat4 view, RenderParams params);
+		void startRendering(RenderParams params);
 		void render(EntityModel& model, glm::mat4 modelMat);
 		void stopRendering();
 	};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+
+#include "pixcraft/server/world_module.hpp"
+#include "pixcraft/server/block_textures.hpp"
+
+namespace PixCraft {
+	// A block face, packed into 32 bits. From the lowest bits: 4 bits of x, 6 of y and 4 of z relative to the chunk,
+	// 3 of side, 8 of texture (the 256 array layers that OpenGL 3.3 guarantees), and 7 left for lighting.
+	// block.vs unpacks it the same way. Kept apart from the renderer so that the dedicated server can test it.
+	class FaceData {
+	public:
+		static const uint32_t MAX_X = 15, MAX_Y = 63, MAX_Z = 15, MAX_SIDE = 5, MAX_TEXTURE = 255;
+		
+		FaceData() = default;
+		// Throws std::out_of_range if a field doesn't fit, instead of packing another position or texture
+		constexpr FaceData(uint32_t x, uint32_t y, uint32_t z, uint32_t side, TexId texId)
+			: bits(pack(x, y, z, side, texId)) { }
+		
+		constexpr uint8_t offsetX() const { return bits & 0xf; }
+		constexpr uint8_t offsetY() const { return (bits >> 4) & 0x3f; }
+		constexpr uint8_t offsetZ() const { return (bits >> 10) & 0xf; }
+		constexpr uint8_t side() const { return (bits >> 14) & 0x7; }
+		constexpr TexId texId() const { return (bits >> 17) & 0xff; }
+		
+	private:
+		uint32_t bits;
+		
+		static constexpr uint32_t pack(uint32_t x, uint32_t y, uint32_t z, uint32_t side, TexId texId) {
+			if(x > MAX_X || y > MAX_Y || z > MAX_Z || side > MAX_SIDE || texId > MAX_TEXTURE)
+				throw std::out_of_range("Face data out of range");
+			return x | y << 4 | z << 10 | side << 14 | texId << 17;
+		}
+	};
+	
+	static_assert(sizeof(FaceData) == 4, "FaceData is uploaded as a single 32-bit attribute");
+	static_assert(CHUNK_SIZE - 1 <= FaceData::MAX_X && CHUNK_HEIGHT - 1 <= FaceData::MAX_Y, "Chunks don't fit in FaceData");
+	static_assert(TextureManager::BLOCK_TEXTURE_COUNT <= FaceData::MAX_TEXTURE + 1, "Block textures don't fit in FaceData");
+}
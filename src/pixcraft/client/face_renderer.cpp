@@ -2,6 +2,7 @@
 
 #include <stdexcept>
 #include <string>
+#include <iostream>
 #include <cstddef>
 
 #include "pixcraft/util/util.hpp"
@@ -18,10 +19,20 @@ const std::array<glm::mat3, 6> sideTransforms = {
 };
 
 
+FaceBuffer::FaceBuffer() : textureId(0) { }
+
+FaceBuffer::~FaceBuffer() {
+	if(textureId != 0) glDeleteTextures(1, &textureId);
+}
+
 void FaceBuffer::init(FaceRenderer& faceRenderer, int capacity) {
-	buffer.init(offsetof(FaceData, offsetX), offsetof(FaceData, side),
-		offsetof(FaceData, texId), sizeof(FaceData));
+	faceRenderer.reserveFaces(capacity);
+	buffer.init(0, sizeof(FaceData));
 	buffer.loadData(nullptr, capacity, GL_STATIC_DRAW);
+	glGenTextures(1, &textureId);
+	glBindTexture(GL_TEXTURE_BUFFER, textureId);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, buffer.bufferId());
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
 	faces.reserve(capacity);
 	checkGlErrors("face buffer initialization");
 }
@@ -40,7 +51,7 @@ void FaceBuffer::eraseFaces(int8_t x, int8_t y, int8_t z) {
 	size_t i = 0;
 	while(i < faces.size()) {
 		FaceData& face = faces[i];
-		if(face.offsetX == (float) x && face.offsetY == (float) y && face.offsetZ == (float) z) {
+		if(face.offsetX() == x && face.offsetY() == y && face.offsetZ() == z) {
 			faces.erase(faces.begin() + i);
 		} else {
 			i++;
@@ -52,7 +63,7 @@ void FaceBuffer::erasePlaneX(int8_t x) {
 	size_t i = 0;
 	while(i < faces.size()) {
 		FaceData& face = faces[i];
-		if(face.offsetX == (float) x) {
+		if(face.offsetX() == x) {
 			faces.erase(faces.begin() + i);
 		} else {
 			i++;
@@ -64,7 +75,7 @@ void FaceBuffer::erasePlaneZ(int8_t z) {
 	size_t i = 0;
 	while(i < faces.size()) {
 		FaceData& face = faces[i];
-		if(face.offsetZ == (float) z) {
+		if(face.offsetZ() == z) {
 			faces.erase(faces.begin() + i);
 		} else {
 			i++;
@@ -78,47 +89,122 @@ void FaceBuffer::render() {
 	buffer.unbind();
 }
 
+void FaceBuffer::render(const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts) {
+	buffer.bind();
+	glMultiDrawArrays(GL_POINTS, firsts.data(), counts.data(), firsts.size());
+	buffer.unbind();
+}
 
-FaceRenderer::FaceRenderer() { }
+void FaceBuffer::renderInstanced(ShaderProgram& program, GLint firstFaceLocation) {
+	drawInstances(program, firstFaceLocation, 0, faces.size());
+}
 
-void FaceRenderer::init() {
-	program.init(ShaderSources::blockVS, ShaderSources::blockGS, ShaderSources::blockFS);
-	checkGlErrors("face renderer initialization");
+void FaceBuffer::renderInstanced(ShaderProgram& program, GLint firstFaceLocation,
+		const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts) {
+	// Instanced draws have no base instance before OpenGL 4.2, so each range gets its own call
+	for(size_t i = 0; i < firsts.size(); ++i) {
+		drawInstances(program, firstFaceLocation, firsts[i], counts[i]);
+	}
 }
 
-void FaceRenderer::setParams(RenderParams params) {
-	program.setUniform("applyView", params.applyView);
-	program.setUniform("applyFog", params.applyFog);
-	program.setUniform("fogColor", params.skyColor[0], params.skyColor[1], params.skyColor[2], 1.0f);
-	program.setUniform("fogStart", params.fogStart);
-	program.setUniform("fogEnd", params.fogEnd);
+void FaceBuffer::drawInstances(ShaderProgram& program, GLint firstFaceLocation, GLint first, GLsizei count) {
+	if(count == 0) return;
+	program.setUniform(firstFaceLocation, (uint32_t) first);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_BUFFER, textureId);
+	buffer.bind(); // the faces are not read as attributes, but core profiles need a vertex array to draw
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+	buffer.unbind();
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+
+FaceRenderer::FaceRenderer()
+	: _pipeline(FacePipeline::geometryShader), maxTextureBufferSize(0), _instancedAvailable(true),
+	  geometryModelLocation(-1), instancedModelLocation(-1), firstFaceLocation(-1) { }
+
+void FaceRenderer::init(FacePipeline pipeline) {
+	_pipeline = pipeline;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTextureBufferSize);
+	geometryProgram.init(ShaderSources::blockVS, ShaderSources::blockGS, ShaderSources::blockFS);
+	initProgram(geometryProgram);
+	instancedProgram.init(ShaderSources::blockInstancedVS, ShaderSources::blockFS);
+	initProgram(instancedProgram);
+	geometryModelLocation = geometryProgram.uniformLocation("model");
+	instancedModelLocation = instancedProgram.uniformLocation("model");
+	firstFaceLocation = instancedProgram.uniformLocation("firstFace");
+	checkGlErrors("face renderer initialization");
 }
 
-void FaceRenderer::startRendering(glm::mat4 proj, glm::mat4 view, RenderParams params) {
+void FaceRenderer::initProgram(ShaderProgram& program) {
+	program.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
 	program.use();
-	
-	setParams(params);
-	
-	program.setUniform("view", view);
-	program.setUniform("proj", proj);
 	program.setUniformArray("sideTransforms", sideTransforms);
-	
 	program.setUniform("texArray", (uint32_t) 0);
-	
+	program.setUniform("faces", (uint32_t) 1);
 	program.setUniform("ambientLight", 0.7f);
 	program.setUniform("diffuseLight", 0.3f);
 	glm::vec3 lightSrcDir = glm::normalize(glm::vec3(0.5f, 1.0f, 0.1f));
 	program.setUniform("lightSrcDir", lightSrcDir);
-	
+	program.unuse();
+}
+
+FacePipeline FaceRenderer::pipeline() { return _pipeline; }
+
+void FaceRenderer::pipeline(FacePipeline pipeline) {
+	if(pipeline == FacePipeline::instanced && !_instancedAvailable)
+		throw std::runtime_error("Face buffers are too large for the instanced face pipeline");
+	_pipeline = pipeline;
+}
+
+bool FaceRenderer::instancedAvailable() { return _instancedAvailable; }
+
+void FaceRenderer::reserveFaces(int capacity) {
+	if(capacity <= maxTextureBufferSize || !_instancedAvailable) return;
+	_instancedAvailable = false;
+	if(_pipeline == FacePipeline::instanced) {
+		std::cout << "Face buffers of " << capacity << " faces are larger than texture buffers can be (" << maxTextureBufferSize
+			<< "), falling back to the geometry shader face pipeline" << std::endl;
+		_pipeline = FacePipeline::geometryShader;
+	}
+}
+
+ShaderProgram& FaceRenderer::program() {
+	return _pipeline == FacePipeline::instanced ? instancedProgram : geometryProgram;
+}
+
+void FaceRenderer::setParams(RenderParams params) {
+	program().setUniform("applyView", params.applyView);
+	program().setUniform("applyFog", params.applyFog);
+}
+
+void FaceRenderer::startRendering(RenderParams params) {
+	program().use();
+	setParams(params);
 	TextureManager::bindBlockTextureArray();
 }
 
 void FaceRenderer::render(FaceBuffer& buffer, glm::mat4 model) {
-	program.setUniform("model", model);
-	
-	buffer.render();
+	if(_pipeline == FacePipeline::instanced) {
+		instancedProgram.setUniform(instancedModelLocation, model);
+		buffer.renderInstanced(instancedProgram, firstFaceLocation);
+	} else {
+		geometryProgram.setUniform(geometryModelLocation, model);
+		buffer.render();
+	}
+}
+
+void FaceRenderer::render(FaceBuffer& buffer, glm::mat4 model, const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts) {
+	if(_pipeline == FacePipeline::instanced) {
+		instancedProgram.setUniform(instancedModelLocation, model);
+		buffer.renderInstanced(instancedProgram, firstFaceLocation, firsts, counts);
+	} else {
+		geometryProgram.setUniform(geometryModelLocation, model);
+		buffer.render(firsts, counts);
+	}
 }
 
 void FaceRenderer::stopRendering() {
-	program.unuse();
+	program().unuse();
 }
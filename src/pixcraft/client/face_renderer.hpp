@@ -6,23 +6,26 @@
 #include "glfw.hpp"
 #include "pixcraft/util/glm.hpp"
 
+#include "pixcraft/server/world_module.hpp"
 #include "shaders.hpp"
 #include "textures.hpp"
+#include "face_data.hpp"
 
 namespace PixCraft {
-	struct FaceData {
-		uint8_t offsetX;
-		uint8_t offsetY;
-		uint8_t offsetZ;
-		uint8_t side;
-		TexId texId;
-	} __attribute__((packed));
-	// ^^^ It works without the __attribute__, but adding it allows sending less data to the GPU
+	enum class FacePipeline {
+		geometryShader, // each face is a point, expanded into a quad by block.gs
+		instanced, // each face is an instanced quad, which reads its data from a buffer texture in block_instanced.vs
+	};
 	
 	class FaceRenderer;
 	
 	class FaceBuffer {
 	public:
+		FaceBuffer();
+		~FaceBuffer();
+		
+		// The instanced pipeline reads the faces through a buffer texture, so it is refused for good
+		// if the capacity is beyond GL_MAX_TEXTURE_BUFFER_SIZE (at least 65536)
 		void init(FaceRenderer& faceRenderer, int capacity);
 		bool isInitialized();
 		
@@ -34,22 +37,48 @@ namespace PixCraft {
 		void erasePlaneZ(int8_t z);
 		
 		void render();
+		// Only draws the given ranges of faces, in a single call
+		void render(const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts);
+		// Same, for the instanced pipeline; the program must be in use
+		void renderInstanced(ShaderProgram& program, GLint firstFaceLocation);
+		void renderInstanced(ShaderProgram& program, GLint firstFaceLocation,
+			const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts);
 		
 	private:
-		VertexBuffer<glm::uvec3, uint8_t, uint32_t> buffer;
+		VertexBuffer<uint32_t> buffer;
+		GlId textureId; // buffer texture over the VBO, for the instanced pipeline
+		
+		void drawInstances(ShaderProgram& program, GLint firstFaceLocation, GLint first, GLsizei count);
 	};
 	
 	class FaceRenderer {
 	public:
 		FaceRenderer();
-		void init();
+		void init(FacePipeline pipeline);
+		
+		// Both pipelines are always loaded; don't switch while rendering.
+		// Selecting the instanced pipeline throws once it was refused, see reserveFaces.
+		FacePipeline pipeline();
+		void pipeline(FacePipeline pipeline);
+		bool instancedAvailable();
+		// Refuses the instanced pipeline if it can't read that many faces, falling back to the geometry shader one
+		void reserveFaces(int capacity);
 		
 		void setParams(RenderParams params);
-		void startRendering(glm::mat4 proj, glm::mat4 view, RenderParams params);
+		// The view and projection come from FrameData, which must be up to date
+		void startRendering(RenderParams params);
 		void render(FaceBuffer& buffer, glm::mat4 model);
+		void render(FaceBuffer& buffer, glm::mat4 model, const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts);
 		void stopRendering();
 		
 	private:
-		ShaderProgram program;
+		FacePipeline _pipeline;
+		GLint maxTextureBufferSize; // in texels, so in faces
+		bool _instancedAvailable;
+		ShaderProgram geometryProgram, instancedProgram;
+		GLint geometryModelLocation, instancedModelLocation, firstFaceLocation; // set for every draw
+		
+		ShaderProgram& program();
+		void initProgram(ShaderProgram& program); // sets the uniforms that never change
 	};
 }
@@ -13,13 +13,9 @@ namespace PixCraft {
 	
 	void checkGlErrors(const char* opDesc);
 	
+	// Switches of a rendering pass; the rest is shared by the whole frame, see FrameData
 	struct RenderParams {
-		float skyColor[3];
-		
 		bool applyView;
 		bool applyFog;
-		
-		float fogStart;
-		float fogEnd;
 	};
 }
@@ -82,9 +82,9 @@ void Button::render(TextRenderer& textRenderer, int winW, int winH) {
 	glDrawElements(GL_TRIANGLES, buffer.indexCount(), GL_UNSIGNED_INT, 0);
 	buffer.unbind();
 	program.unuse();
-	int textX = x - textRenderer.getTextWidth(label)/2;
+	int textX = x - label.width(textRenderer)/2;
 	int textY = y - textRenderer.getTextHeight()/2;
-	textRenderer.renderText(label, textX, textY, glm::vec4(0.0, 0.0, 0.0, 1.0));
+	label.render(textRenderer, textX, textY, glm::vec4(0.0, 0.0, 0.0, 1.0));
 }
 
 bool Button::hits(int hx, int hy) {
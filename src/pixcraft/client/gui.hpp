@@ -41,7 +41,7 @@ namespace PixCraft {
 		static float cs; // corner size
 		
 		float x, y, w, h;
-		std::string label;
+		TextLabel label;
 		IndexBuffer<glm::vec2, glm::vec2> buffer;
 		
 		std::function<void()> callback;
@@ -36,12 +36,10 @@ void Hotbar::render() {
 }
 
 void Hotbar::prerender() {
-	Block& block = Block::fromId(_held);
-	
 	buffer.faces.clear();
 	for(uint8_t side = 0; side < 6; ++side) {
 		buffer.faces.push_back(FaceData {
-			0, 0, 0, side, block.getFaceTexture(side)
+			0, 0, 0, side, BlockRegistry::faceTexture(_held, side)
 		});
 	}
 	buffer.prerender();
@@ -7,7 +7,8 @@
 using namespace PixCraft;
 
 InputManager::InputManager()
-	: window(nullptr), _capturingMouse(false), oldMousePos(0, 0), _justPressed(), _justClicked {false, false},
+	: window(nullptr), _capturingMouse(false), oldMousePos(0, 0), _mousePos(0, 0), _movementKeys(0, 0, false, false),
+	  _justPressed(), _justClicked {false, false},
 	  _justScrolled(0) { }
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -50,6 +51,48 @@ void InputManager::init(GLFWwindow* newWindow) {
 	glfwSetCharCallback(window, charCallback);
 }
 
+bool InputManager::beginFrame() {
+	InputFrame frame;
+	if(recording.isReplaying()) {
+		// Live events are dropped: the game only sees what was recorded
+		if(!recording.nextFrame(frame)) return false;
+		_movementKeys = frame.movementKeys;
+		_mousePos = frame.mousePos;
+		_justClicked[0] = frame.clicked[0];
+		_justClicked[1] = frame.clicked[1];
+		_justScrolled = frame.scrolled;
+		_justPressed = std::unordered_set<int>(frame.pressedKeys.begin(), frame.pressedKeys.end());
+		_inputBuffer = frame.text;
+		return true;
+	}
+	
+	int dx = (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS);
+	int dz = (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS);
+	bool up = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+	bool down = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS;
+	_movementKeys = std::tuple<int,int,bool,bool>(dx, dz, up, down);
+	
+	double mouseX, mouseY;
+	glfwGetCursorPos(window, &mouseX, &mouseY);
+	int width, height;
+	glfwGetWindowSize(window, &width, &height);
+	_mousePos = glm::ivec2((int) mouseX - width/2, height/2 - (int) mouseY);
+	
+	if(recording.isRecording()) {
+		frame.movementKeys = _movementKeys;
+		frame.mousePos = _mousePos;
+		frame.clicked[0] = _justClicked[0];
+		frame.clicked[1] = _justClicked[1];
+		frame.scrolled = _justScrolled;
+		frame.pressedKeys.assign(_justPressed.begin(), _justPressed.end());
+		frame.text = _inputBuffer;
+		recording.record(frame);
+	}
+	return true;
+}
+
+InputRecording& InputManager::getRecording() { return recording; }
+
 void InputManager::capturingMouse(bool capturingMouse) {
 	if(capturingMouse != _capturingMouse) {
 		_capturingMouse = capturingMouse;
@@ -58,6 +101,7 @@ void InputManager::capturingMouse(bool capturingMouse) {
 		glfwGetWindowSize(window, &width, &height);
 		glfwSetCursorPos(window, width/2, height/2);
 		oldMousePos = glm::ivec2(0, 0);
+		_mousePos = glm::ivec2(0, 0);
 	}
 }
 
@@ -76,13 +120,7 @@ glm::vec2 InputManager::getMouseMovement() {
 	return mouseSensitivity * mvt;
 }
 
-glm::ivec2 InputManager::getMousePosition() {
-	double mouseX, mouseY;
-	glfwGetCursorPos(window, &mouseX, &mouseY);
-	int width, height;
-	glfwGetWindowSize(window, &width, &height);
-	return glm::ivec2((int) mouseX - width/2, height/2 - (int) mouseY);
-}
+glm::ivec2 InputManager::getMousePosition() { return _mousePos; }
 
 
 void InputManager::keyPressed(int key) {
@@ -93,13 +131,7 @@ bool InputManager::justPressed(int key) {
 	return _justPressed.count(key) == 1;
 }
 
-std::tuple<int,int,bool,bool> InputManager::getMovementKeys() {
-	int dx = (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS);
-	int dz = (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS);
-	bool up = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
-	bool down = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS;
-	return std::tuple<int,int,bool,bool>(dx, dz, up, down);
-}
+std::tuple<int,int,bool,bool> InputManager::getMovementKeys() { return _movementKeys; }
 
 void InputManager::inputCharacter(uint32_t codepoint) {
 	utf8::append(codepoint, std::back_inserter(_inputBuffer));
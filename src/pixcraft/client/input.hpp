@@ -8,12 +8,19 @@
 #include "glfw.hpp"
 #include "pixcraft/util/glm.hpp"
 
+#include "input_recording.hpp"
+
 namespace PixCraft {
 	class InputManager {
 	public:
 		InputManager();
 		void init(GLFWwindow* window);
 		
+		// Samples (or replays) the input state for the frame; call after glfwPollEvents.
+		// Returns false once a replay has run out of frames.
+		bool beginFrame();
+		InputRecording& getRecording();
+		
 		void capturingMouse(bool capture);
 		
 		void mouseClicked(int button);
@@ -37,9 +44,12 @@ namespace PixCraft {
 		static constexpr float mouseSensitivity = 0.005f;
 		
 		GLFWwindow* window;
+		InputRecording recording;
 		
 		bool _capturingMouse;
 		glm::ivec2 oldMousePos;
+		glm::ivec2 _mousePos;
+		std::tuple<int,int,bool,bool> _movementKeys;
 		
 		std::unordered_set<int> _justPressed;
 		bool _justClicked[2];
@@ -0,0 +1,88 @@
+#include "input_recording.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+using namespace PixCraft;
+
+template<typename T>
+void writeValue(std::ofstream& out, T val) {
+	out.write(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+template<typename T>
+T readValue(std::ifstream& in) {
+	T val;
+	in.read(reinterpret_cast<char*>(&val), sizeof(T));
+	return val;
+}
+
+InputRecording::InputRecording() : recording(false), replaying(false), _seed(0) { }
+
+void InputRecording::startRecording(std::string path, uint64_t seed) {
+	out.open(path.c_str(), std::ios::binary);
+	if(!out) throw std::runtime_error("Can't create input recording file!");
+	writeValue<uint32_t>(out, MAGIC);
+	writeValue<uint32_t>(out, VERSION);
+	writeValue<uint64_t>(out, seed);
+	_seed = seed;
+	recording = true;
+}
+
+void InputRecording::startReplay(std::string path) {
+	in.open(path.c_str(), std::ios::binary);
+	if(!in) throw std::runtime_error("Can't open input recording file!");
+	uint32_t magic = readValue<uint32_t>(in);
+	uint32_t version = readValue<uint32_t>(in);
+	if(!in || magic != MAGIC || version != VERSION)
+		throw std::runtime_error("Invalid input recording file!");
+	_seed = readValue<uint64_t>(in);
+	replaying = true;
+}
+
+bool InputRecording::isRecording() { return recording; }
+bool InputRecording::isReplaying() { return replaying; }
+uint64_t InputRecording::seed() { return _seed; }
+
+void InputRecording::record(InputFrame& frame) {
+	int dx, dz; bool up, down;
+	std::tie(dx, dz, up, down) = frame.movementKeys;
+	writeValue<int8_t>(out, dx);
+	writeValue<int8_t>(out, dz);
+	writeValue<uint8_t>(out, up | down << 1 | frame.clicked[0] << 2 | frame.clicked[1] << 3);
+	writeValue<int32_t>(out, frame.mousePos.x);
+	writeValue<int32_t>(out, frame.mousePos.y);
+	writeValue<int32_t>(out, frame.scrolled);
+	writeValue<uint16_t>(out, frame.pressedKeys.size());
+	for(int key : frame.pressedKeys) {
+		writeValue<int32_t>(out, key);
+	}
+	uint32_t textSize = std::min<size_t>(frame.text.size(), MAX_TEXT_SIZE);
+	writeValue<uint32_t>(out, textSize);
+	out.write(frame.text.data(), textSize);
+}
+
+bool InputRecording::nextFrame(InputFrame& frame) {
+	int dx = readValue<int8_t>(in);
+	int dz = readValue<int8_t>(in);
+	uint8_t flags = readValue<uint8_t>(in);
+	if(!in) return false;
+	frame.movementKeys = std::tuple<int,int,bool,bool>(dx, dz, flags & 1, flags & 2);
+	frame.clicked[0] = flags & 4;
+	frame.clicked[1] = flags & 8;
+	frame.mousePos.x = readValue<int32_t>(in);
+	frame.mousePos.y = readValue<int32_t>(in);
+	frame.scrolled = readValue<int32_t>(in);
+	uint16_t keyCount = readValue<uint16_t>(in);
+	frame.pressedKeys.clear();
+	for(uint16_t i = 0; i < keyCount; ++i) {
+		frame.pressedKeys.push_back(readValue<int32_t>(in));
+	}
+	uint32_t textSize = readValue<uint32_t>(in);
+	if(!in || textSize > MAX_TEXT_SIZE)
+		throw std::runtime_error("Invalid input recording file!");
+	frame.text.assign(textSize, '\0');
+	in.read(&frame.text[0], textSize);
+	if(!in) throw std::runtime_error("Invalid input recording file!");
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <fstream>
+
+#include "pixcraft/util/glm.hpp"
+
+namespace PixCraft {
+	// Everything the game reads from the InputManager during one frame
+	struct InputFrame {
+		std::tuple<int,int,bool,bool> movementKeys;
+		glm::ivec2 mousePos;
+		bool clicked[2];
+		int scrolled;
+		std::vector<int> pressedKeys;
+		std::string text;
+	};
+
+	// Logs input frames to a file, or reads them back, for repeatable benchmark runs.
+	class InputRecording {
+	public:
+		InputRecording();
+
+		void startRecording(std::string path, uint64_t seed);
+		void startReplay(std::string path);
+
+		bool isRecording();
+		bool isReplaying();
+		uint64_t seed();
+
+		void record(InputFrame& frame);
+		// Returns false once the log is exhausted; throws if it is truncated or corrupt
+		bool nextFrame(InputFrame& frame);
+
+	private:
+		static const uint32_t MAGIC = 0x43525850; // "PXRC"
+		static const uint32_t VERSION = 1;
+		static const uint32_t MAX_TEXT_SIZE = 4096; // per frame; longer text is cut when recording
+
+		bool recording;
+		bool replaying;
+		uint64_t _seed;
+		std::ofstream out;
+		std::ifstream in;
+	};
+}
@@ -0,0 +1,247 @@
+#include "lod_renderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <utility>
+
+#include "pixcraft/util/glm.hpp"
+
+#include "pixcraft/server/blocks.hpp"
+#include "pixcraft/server/chunk.hpp"
+#include "pixcraft/util/util.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	const int TILE_BLOCKS = LodRenderer::TILE_CHUNKS * CHUNK_SIZE;
+	// Columns are stored as FaceData offsets, which only span a chunk
+	static_assert(TILE_BLOCKS / LodRenderer::MIN_STEP - 1 <= FaceData::MAX_X, "LOD tiles have too many columns");
+	
+	int32_t toTileCoord(int32_t chunkCoord) {
+		return floor(((float) chunkCoord) / LodRenderer::TILE_CHUNKS);
+	}
+	
+	// Squared distance from the camera chunk to the nearest chunk of a tile
+	int32_t tileDistanceSq(int32_t tileX, int32_t tileZ, int32_t camChunkX, int32_t camChunkZ) {
+		int32_t minX = tileX*LodRenderer::TILE_CHUNKS, minZ = tileZ*LodRenderer::TILE_CHUNKS;
+		int32_t dx = std::max(std::max(minX - camChunkX, camChunkX - (minX + LodRenderer::TILE_CHUNKS - 1)), 0);
+		int32_t dz = std::max(std::max(minZ - camChunkZ, camChunkZ - (minZ + LodRenderer::TILE_CHUNKS - 1)), 0);
+		return dx*dx + dz*dz;
+	}
+}
+
+LodRenderer::LodRenderer(ChunkRenderer& chunkRenderer, FaceRenderer& faceRenderer)
+	: chunkRenderer(chunkRenderer), faceRenderer(faceRenderer), generation(0),
+	  workers(WorkerPool::defaultThreadCount()) { }
+
+void LodRenderer::reset(uint64_t seed) {
+	workers.clear();
+	generation++;
+	tiles.clear();
+	pendingTiles.clear();
+	gen = std::make_shared<WorldGenerator>(seed);
+}
+
+int LodRenderer::lodDistance(int renderDist) {
+	return std::max(renderDist, std::min(4*renderDist, (int) MAX_DISTANCE));
+}
+
+void LodRenderer::update(int32_t camChunkX, int32_t camChunkZ, int renderDist) {
+	if(!gen) return;
+	
+	std::vector<TileMesh> finished;
+	finishedTiles.popAll(finished);
+	for(TileMesh& mesh : finished) {
+		if(mesh.generation != generation) continue;
+		uint64_t key = packCoords(mesh.tileX, mesh.tileZ);
+		pendingTiles.erase(key);
+		// The previous mesh of the tile is only replaced now, so that nothing disappears in between
+		tiles.erase(key);
+		Tile& tile = tiles[key];
+		tile.step = mesh.step;
+		tile.starts = mesh.starts;
+		tile.translucentStarts = mesh.translucentStarts;
+		tile.buffer.faces = std::move(mesh.faces);
+		tile.buffer.init(faceRenderer, tile.buffer.faces.size());
+		tile.buffer.prerender();
+		tile.translucentBuffer.faces = std::move(mesh.translucentFaces);
+		tile.translucentBuffer.init(faceRenderer, tile.translucentBuffer.faces.size());
+		tile.translucentBuffer.prerender();
+	}
+	
+	int lodDist = lodDistance(renderDist);
+	for(auto iter = tiles.begin(); iter != tiles.end();) {
+		int32_t tileX, tileZ;
+		std::tie(tileX, tileZ) = unpackCoords(iter->first);
+		if(tileDistanceSq(tileX, tileZ, camChunkX, camChunkZ) > lodDist*lodDist
+				|| isCovered(tileX, tileZ, camChunkX, camChunkZ, renderDist)) {
+			iter = tiles.erase(iter);
+		} else {
+			++iter;
+		}
+	}
+	
+	if(pendingTiles.size() >= MAX_PENDING_TILES) return;
+	std::vector<std::tuple<int32_t, int32_t, int32_t, int>> missing; // squared distance, tile coordinates, step
+	int32_t camTileX = toTileCoord(camChunkX), camTileZ = toTileCoord(camChunkZ);
+	int32_t tileRange = lodDist / TILE_CHUNKS + 1;
+	for(int32_t tileX = camTileX - tileRange; tileX <= camTileX + tileRange; ++tileX) {
+		for(int32_t tileZ = camTileZ - tileRange; tileZ <= camTileZ + tileRange; ++tileZ) {
+			int32_t distSq = tileDistanceSq(tileX, tileZ, camChunkX, camChunkZ);
+			if(distSq > lodDist*lodDist) continue;
+			uint64_t key = packCoords(tileX, tileZ);
+			// A tile whose step changed is only remeshed once its previous request is done
+			if(pendingTiles.count(key)) continue;
+			int step = stepAt(std::sqrt(distSq), renderDist);
+			auto tileIter = tiles.find(key);
+			if(tileIter != tiles.end() && tileIter->second.step == step) continue;
+			if(isCovered(tileX, tileZ, camChunkX, camChunkZ, renderDist)) continue;
+			missing.emplace_back(distSq, tileX, tileZ, step);
+		}
+	}
+	std::sort(missing.begin(), missing.end());
+	
+	for(auto& request : missing) {
+		if(pendingTiles.size() >= MAX_PENDING_TILES) break;
+		int32_t tileX, tileZ;
+		int step;
+		std::tie(std::ignore, tileX, tileZ, step) = request;
+		pendingTiles[packCoords(tileX, tileZ)] = step;
+		std::shared_ptr<WorldGenerator> tileGen = gen;
+		uint64_t tileGeneration = generation;
+		workers.submit([this, tileGen, tileGeneration, tileX, tileZ, step]() {
+			TileMesh mesh = meshTile(*tileGen, tileX, tileZ, step);
+			mesh.generation = tileGeneration;
+			finishedTiles.push(std::move(mesh));
+		});
+	}
+}
+
+void LodRenderer::render(int32_t camChunkX, int32_t camChunkZ, int renderDist, ViewFrustum& vf) {
+	for(auto& pair : tiles) {
+		int32_t tileX, tileZ;
+		std::tie(tileX, tileZ) = unpackCoords(pair.first);
+		renderTile(tileX, tileZ, pair.second, false, camChunkX, camChunkZ, renderDist, vf);
+	}
+}
+
+void LodRenderer::renderTranslucent(int32_t camChunkX, int32_t camChunkZ, int renderDist, ViewFrustum& vf) {
+	glDepthMask(GL_FALSE);
+	glDisable(GL_CULL_FACE);
+	for(auto& pair : tiles) {
+		int32_t tileX, tileZ;
+		std::tie(tileX, tileZ) = unpackCoords(pair.first);
+		renderTile(tileX, tileZ, pair.second, true, camChunkX, camChunkZ, renderDist, vf);
+	}
+	glDepthMask(GL_TRUE);
+	glEnable(GL_CULL_FACE);
+}
+
+size_t LodRenderer::tileCount() {
+	return tiles.size();
+}
+
+size_t LodRenderer::pendingTileCount() {
+	return pendingTiles.size();
+}
+
+int LodRenderer::stepAt(int dist, int renderDist) {
+	if(dist <= 3*renderDist) return MIN_STEP;
+	return 8;
+}
+
+LodRenderer::TileMesh LodRenderer::meshTile(WorldGenerator& gen, int32_t tileX, int32_t tileZ, int step) {
+	TileMesh mesh;
+	mesh.tileX = tileX;
+	mesh.tileZ = tileZ;
+	mesh.step = step;
+	
+	// One column per step x step blocks, sampled at its center; with a border of one column, for the side faces
+	const int columns = TILE_BLOCKS / step;
+	const int chunkColumns = CHUNK_SIZE / step;
+	const int rowSize = columns + 2;
+	std::vector<int> heights(rowSize * rowSize);
+	auto heightAt = [&](int i, int j) -> int& { return heights[(i+1) + rowSize*(j+1)]; };
+	for(int j = -1; j <= columns; ++j) {
+		for(int i = -1; i <= columns; ++i) {
+			int32_t x = tileX*TILE_BLOCKS + i*step + step/2;
+			int32_t z = tileZ*TILE_BLOCKS + j*step + step/2;
+			heightAt(i, j) = std::min((int) gen.getTerrainHeight(x, z), CHUNK_HEIGHT - 1);
+		}
+	}
+	
+	for(int chunk = 0; chunk < TILE_CHUNK_COUNT; ++chunk) {
+		mesh.starts[chunk] = mesh.faces.size();
+		mesh.translucentStarts[chunk] = mesh.translucentFaces.size();
+		int firstI = (chunk % TILE_CHUNKS) * chunkColumns;
+		int firstJ = (chunk / TILE_CHUNKS) * chunkColumns;
+		for(int j = firstJ; j < firstJ + chunkColumns; ++j) {
+			for(int i = firstI; i < firstI + chunkColumns; ++i) {
+				int h = heightAt(i, j);
+				// Same layers as the generator: grass (or dirt under water), a dirt layer, then stone
+				BlockId top = h >= WorldGenerator::WATER_LEVEL ? BlockRegistry::GRASS_ID : BlockRegistry::DIRT_ID;
+				mesh.faces.push_back({ (uint8_t) i, (uint8_t) h, (uint8_t) j, 5, BlockRegistry::faceTexture(top, 5) });
+				for(uint8_t side = 0; side < 4; ++side) {
+					int i2 = i + sideVectors[side][0];
+					int j2 = j + sideVectors[side][2];
+					int bottom = heightAt(i2, j2) + 1;
+					bool chunkEdge = i2 < firstI || i2 >= firstI + chunkColumns || j2 < firstJ || j2 >= firstJ + chunkColumns;
+					if(chunkEdge) bottom = std::max(std::min(bottom, h) - SKIRT_DEPTH, 0);
+					for(int y = bottom; y <= h; ++y) {
+						BlockId id = y == h ? top : y == h-1 ? BlockRegistry::DIRT_ID : BlockRegistry::STONE_ID;
+						mesh.faces.push_back({ (uint8_t) i, (uint8_t) y, (uint8_t) j, side, BlockRegistry::faceTexture(id, side) });
+					}
+				}
+				if(h < WorldGenerator::WATER_LEVEL) {
+					mesh.translucentFaces.push_back({ (uint8_t) i, WorldGenerator::WATER_LEVEL, (uint8_t) j, 5,
+						BlockRegistry::faceTexture(BlockRegistry::WATER_ID, 5) });
+				}
+			}
+		}
+	}
+	mesh.starts[TILE_CHUNK_COUNT] = mesh.faces.size();
+	mesh.translucentStarts[TILE_CHUNK_COUNT] = mesh.translucentFaces.size();
+	return mesh;
+}
+
+bool LodRenderer::isCovered(int32_t tileX, int32_t tileZ, int32_t camChunkX, int32_t camChunkZ, int renderDist) {
+	for(int32_t chunkX = tileX*TILE_CHUNKS; chunkX < (tileX+1)*TILE_CHUNKS; ++chunkX) {
+		for(int32_t chunkZ = tileZ*TILE_CHUNKS; chunkZ < (tileZ+1)*TILE_CHUNKS; ++chunkZ) {
+			if(!chunkRenderer.isChunkDrawn(chunkX, chunkZ, camChunkX, camChunkZ, renderDist)) return false;
+		}
+	}
+	return true;
+}
+
+void LodRenderer::renderTile(int32_t tileX, int32_t tileZ, Tile& tile, bool translucent,
+		int32_t camChunkX, int32_t camChunkZ, int renderDist, ViewFrustum& vf) {
+	const ChunkStarts& starts = translucent ? tile.translucentStarts : tile.starts;
+	if(starts[TILE_CHUNK_COUNT] == 0) return;
+	
+	// Consecutive chunks are merged into one range
+	firsts.clear();
+	counts.clear();
+	for(int chunk = 0; chunk < TILE_CHUNK_COUNT; ++chunk) {
+		GLsizei count = starts[chunk+1] - starts[chunk];
+		if(count == 0) continue;
+		int32_t chunkX = tileX*TILE_CHUNKS + chunk % TILE_CHUNKS;
+		int32_t chunkZ = tileZ*TILE_CHUNKS + chunk / TILE_CHUNKS;
+		if(chunkRenderer.isChunkDrawn(chunkX, chunkZ, camChunkX, camChunkZ, renderDist) || !isVisible(vf, chunkX, chunkZ))
+			continue;
+		if(!firsts.empty() && firsts.back() + counts.back() == starts[chunk]) {
+			counts.back() += count;
+		} else {
+			firsts.push_back(starts[chunk]);
+			counts.push_back(count);
+		}
+	}
+	if(firsts.empty()) return;
+	
+	// Columns are centered like blocks, on their first block plus half the step
+	float offset = (tile.step - 1) / 2.0f;
+	glm::mat4 model = glm::translate(glm::mat4(1.0f),
+		glm::vec3(tileX*TILE_BLOCKS + offset, 0.0f, tileZ*TILE_BLOCKS + offset));
+	model = glm::scale(model, glm::vec3(tile.step, 1.0f, tile.step));
+	faceRenderer.render(translucent ? tile.translucentBuffer : tile.buffer, model, firsts, counts);
+}
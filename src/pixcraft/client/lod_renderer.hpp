@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <array>
+#include <memory>
+#include <unordered_map>
+
+#include "pixcraft/server/worldgen.hpp"
+#include "pixcraft/util/worker_pool.hpp"
+#include "pixcraft/util/mpsc_queue.hpp"
+#include "face_renderer.hpp"
+#include "chunk_renderer.hpp"
+#include "view_frustum.hpp"
+
+namespace PixCraft {
+	// Draws the terrain beyond the render distance, as columns of one sample per 4 or 8 blocks (further away),
+	// meshed on worker threads straight from WorldGenerator::getTerrainHeight, without generating chunks.
+	// Tiles are drawn chunk by chunk, leaving out the chunks that ChunkRenderer draws, so real meshes replace them as they arrive.
+	class LodRenderer {
+	public:
+		static const int TILE_CHUNKS = 4; // tiles are square, of this many chunks per side
+		static const int MAX_DISTANCE = 48; // in chunks
+		static const size_t MAX_PENDING_TILES = 16;
+		static const int SKIRT_DEPTH = 8; // chunk edges extend this far down, to hide the cracks with their neighbours
+		static const int MIN_STEP = 4; // in blocks per column
+		
+		LodRenderer(ChunkRenderer& chunkRenderer, FaceRenderer& faceRenderer);
+		
+		// Drops every tile, and meshes the terrain of the given seed from now on
+		void reset(uint64_t seed);
+		
+		static int lodDistance(int renderDist); // in chunks
+		
+		// Uploads the finished tiles, drops the ones out of range, and requests the missing ones, nearest first
+		void update(int32_t camChunkX, int32_t camChunkZ, int renderDist);
+		
+		void render(int32_t camChunkX, int32_t camChunkZ, int renderDist, ViewFrustum& vf);
+		void renderTranslucent(int32_t camChunkX, int32_t camChunkZ, int renderDist, ViewFrustum& vf);
+		
+		size_t tileCount();
+		size_t pendingTileCount();
+	
+	private:
+		static const int TILE_CHUNK_COUNT = TILE_CHUNKS*TILE_CHUNKS;
+		
+		// Faces are grouped by chunk (x + TILE_CHUNKS*z, relative to the tile); starts[i] is the first face of chunk i,
+		// and starts[TILE_CHUNK_COUNT] the total
+		typedef std::array<GLint, TILE_CHUNK_COUNT + 1> ChunkStarts;
+		
+		struct TileMesh {
+			uint64_t generation;
+			int32_t tileX, tileZ;
+			int step; // in blocks per column
+			std::vector<FaceData> faces, translucentFaces;
+			ChunkStarts starts, translucentStarts;
+		};
+		
+		struct Tile {
+			int step;
+			FaceBuffer buffer, translucentBuffer;
+			ChunkStarts starts, translucentStarts;
+		};
+		
+		ChunkRenderer& chunkRenderer;
+		FaceRenderer& faceRenderer;
+		
+		std::shared_ptr<WorldGenerator> gen; // shared with the running tasks
+		uint64_t generation; // results of the tasks submitted before the last reset are ignored
+		
+		std::unordered_map<uint64_t, Tile> tiles;
+		std::unordered_map<uint64_t, int> pendingTiles; // step of the requested mesh
+		MpscQueue<TileMesh> finishedTiles;
+		
+		std::vector<GLint> firsts;
+		std::vector<GLsizei> counts;
+		
+		WorkerPool workers; // last, so that the tasks are done before the rest is destroyed
+		
+		static int stepAt(int dist, int renderDist);
+		static TileMesh meshTile(WorldGenerator& gen, int32_t tileX, int32_t tileZ, int step);
+		
+		// Whether the chunk renderer draws every chunk of the tile
+		bool isCovered(int32_t tileX, int32_t tileZ, int32_t camChunkX, int32_t camChunkZ, int renderDist);
+		void renderTile(int32_t tileX, int32_t tileZ, Tile& tile, bool translucent,
+			int32_t camChunkX, int32_t camChunkZ, int renderDist, ViewFrustum& vf);
+	};
+}
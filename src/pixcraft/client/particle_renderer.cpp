@@ -18,6 +18,10 @@ void ParticleRenderer::init() {
 	elapsedFrames = 0;
 	
 	program.init(ShaderSources::particleVS, ShaderSources::particleFS);
+	program.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+	program.use();
+	program.setUniform("texArray", (uint32_t) 0);
+	program.unuse();
 	buffer.init(offsetof(Particle, x), offsetof(Particle, size),
 		offsetof(Particle, blockTex), offsetof(Particle, tx), sizeof(Particle));
 	buffer.loadData(nullptr, MAX_PARTICLES, GL_STREAM_DRAW);
@@ -80,7 +84,7 @@ void ParticleRenderer::update(float dt) {
 	elapsedFrames++;
 }
 
-void ParticleRenderer::render(glm::mat4 proj, glm::mat4 view, float fovy, int height) {
+void ParticleRenderer::render(float fovy, int height) {
 	std::vector<Particle> particlesVector;
 	for(auto it = particles.iter(); !it.done(); ++it) {
 		particlesVector.push_back(*it);
@@ -95,12 +99,8 @@ void ParticleRenderer::render(glm::mat4 proj, glm::mat4 view, float fovy, int he
 	glEnable(GL_PROGRAM_POINT_SIZE);
 	
 	program.use();
-	program.setUniform("view", view);
-	program.setUniform("proj", proj);
 	program.setUniform("fovY", (float) fovy);
 	program.setUniform("winH", (float) height);
-	
-	program.setUniform("texArray", (uint32_t) 0);
 	TextureManager::bindBlockTextureArray();
 	buffer.bind();
 	glDrawArrays(GL_POINTS, 0, particleCount);
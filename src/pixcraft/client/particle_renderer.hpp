@@ -29,7 +29,7 @@ namespace PixCraft {
 		
 		void update(float dt);
 		
-		void render(glm::mat4 proj, glm::mat4 view, float fovy, int height);
+		void render(float fovy, int height); // the view and projection come from FrameData
 		
 	private:
 		const unsigned int MAX_PARTICLES = 512;
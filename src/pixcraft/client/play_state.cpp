@@ -4,8 +4,19 @@
 #include <cmath>
 #include <array>
 #include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <stdexcept>
+#include <cctype>
+#include <iostream>
+#include <limits>
 
 #include "pixcraft/util/util.hpp"
+#include "pixcraft/util/profiler.hpp"
 #include "shaders.hpp"
 #include "textures.hpp"
 #include "view_frustum.hpp"
@@ -52,11 +63,67 @@ const std::array<unsigned int, 24> blockOverlayIndices = {
 	3, 5,  3, 6
 };
 
+namespace {
+	// By id, or by name in any case
+	BlockId parseBlock(std::string arg) {
+		std::transform(arg.begin(), arg.end(), arg.begin(), ::tolower);
+		const char* const* names = Serializer::EnumNamesBlockType();
+		for(BlockId id = 0; names[id] && id <= BlockRegistry::registeredCount(); ++id) {
+			std::string name = names[id];
+			std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+			if(name == arg) return id;
+		}
+		unsigned long id = std::stoul(arg);
+		// Checked against the BlockId range first, so that large ids don't wrap around into valid ones
+		if(id > std::numeric_limits<BlockId>::max() || !BlockRegistry::isValidId(id)) throw std::out_of_range("Unknown block id");
+		return id;
+	}
+	
+	// Draws into a framebuffer of the given size, without multisampling, and reads back its RGBA pixels
+	std::vector<uint8_t> renderOffscreen(int width, int height, const float clearColor[3], const std::function<void()>& draw) {
+		GlId fbo, colorBuffer, depthBuffer;
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glGenRenderbuffers(1, &colorBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+		glGenRenderbuffers(1, &depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		
+		std::vector<uint8_t> pixels;
+		if(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+			glClearColor(clearColor[0], clearColor[1], clearColor[2], 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			draw();
+			pixels.resize(4 * width * height);
+			glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		}
+		
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteRenderbuffers(1, &colorBuffer);
+		glDeleteRenderbuffers(1, &depthBuffer);
+		glDeleteFramebuffers(1, &fbo);
+		checkGlErrors("offscreen rendering");
+		if(pixels.empty()) throw std::runtime_error("Offscreen framebuffer is incomplete");
+		return pixels;
+	}
+}
+
 PlayState::PlayState(GameClient& client)
-	: GameState(client), showDebug(false), paused(false), chunkRenderer(world, faceRenderer),
-	  hotbar(faceRenderer) {
+	: GameState(client), showDebug(false), paused(false), lodEnabled(true), world(client.newWorldSeed()), simulation(world),
+	  playerInput { std::tuple<int,int,bool,bool>(0, 0, false, false), glm::vec3(0.0f), false, false, 0 },
+	  appliedRotation(0.0f), chunkRenderer(world, faceRenderer), lodRenderer(chunkRenderer, faceRenderer),
+	  loadScheduler(world, chunkRenderer), hotbar(faceRenderer), pipelineCheckRequested(false), pipelineCheckPassed(false) {
 	setAntialiasing(false);
 	setRenderDistance(8);
+	loadBudget = CHUNK_LOAD_BUDGET;
+	loadScheduler.setDeterministic(client.isDeterministic());
+	lodRenderer.reset(world.seed());
 	client.getInputManager().capturingMouse(!paused);
 	
 	cursorProgram.init(ShaderSources::cursorVS, ShaderSources::colorFS);
@@ -76,7 +143,8 @@ PlayState::PlayState(GameClient& client)
 	blockOverlayBuffer.loadIndices(blockOverlayIndices.data(), blockOverlayIndices.size());
 	checkGlErrors("block overlay initialization");
 	
-	faceRenderer.init();
+	frameUniforms.init(sizeof(FrameData), FRAME_DATA_BINDING);
+	faceRenderer.init(client.getFacePipeline());
 	entityRenderer.init();
 	particleRenderer.init();
 	hotbar.init();
@@ -85,14 +153,17 @@ PlayState::PlayState(GameClient& client)
 		console.clearHistory();
 	});
 	console.addCommand("fly", [&]() {
+		std::lock_guard<std::mutex> lock(simulation.mutex());
 		player->movementMode(MovementMode::flying);
 		console.write("Flight mode enabled.");
 	});
 	console.addCommand("fall", [&]() {
+		std::lock_guard<std::mutex> lock(simulation.mutex());
 		player->movementMode(MovementMode::normal);
 		console.write("Flight mode disabled.");
 	});
 	console.addCommand("noclip", [&]() {
+		std::lock_guard<std::mutex> lock(simulation.mutex());
 		player->movementMode(MovementMode::noClip);
 		console.write("Noclip mode enabled.");
 	});
@@ -107,29 +178,175 @@ PlayState::PlayState(GameClient& client)
 			console.write("Antialiasing disabled.");
 		}
 	});
+	console.addCommand("autodist", [&](const Console::Arguments& args) {
+		if(client.isDeterministic()) {
+			console.write("The render distance can't depend on frame times while recording or replaying.");
+			return;
+		}
+		try {
+			if(args.size() > 1) throw std::invalid_argument("Too many arguments");
+			if(!args.empty()) distController.targetFrameTime(std::stof(args[0]));
+			distController.enabled(!args.empty() || !distController.enabled());
+		} catch(std::logic_error& err) {
+			console.write("Usage: autodist [target frame time in ms]");
+			return;
+		}
+		if(distController.enabled()) {
+			std::stringstream ss;
+			ss << "Adjusting render distance for " << distController.targetFrameTime() << " ms frames.";
+			console.write(ss.str());
+		} else {
+			loadBudget = CHUNK_LOAD_BUDGET;
+			console.write("Render distance is now fixed.");
+		}
+	});
 	console.addCommand("further", [&]() {
+		distController.enabled(false);
+		loadBudget = CHUNK_LOAD_BUDGET;
 		setRenderDistance(renderDist + 1);
 		std::stringstream ss;
 		ss << "Set render distance to " << renderDist << ".";
 		console.write(ss.str());
 	});
 	console.addCommand("closer", [&]() {
+		distController.enabled(false);
+		loadBudget = CHUNK_LOAD_BUDGET;
 		if(renderDist > 1)
 			setRenderDistance(renderDist - 1);
 		std::stringstream ss;
 		ss << "Set render distance to " << renderDist << ".";
 		console.write(ss.str());
 	});
+	console.addCommand("lod", [&]() {
+		lodEnabled = !lodEnabled;
+		lodRenderer.reset(world.seed()); // frees the tiles, or starts over
+		setRenderDistance(renderDist);
+		if(lodEnabled) {
+			console.write("Distant terrain enabled.");
+		} else {
+			console.write("Distant terrain disabled.");
+		}
+	});
+	console.addCommand("occlusion", [&]() {
+		chunkRenderer.occlusionCulling(!chunkRenderer.occlusionCulling());
+		if(chunkRenderer.occlusionCulling()) {
+			console.write("Occlusion culling enabled.");
+		} else {
+			console.write("Occlusion culling disabled.");
+		}
+	});
+	console.addCommand("benchcull", [&]() {
+		// Frustum culls every chunk around the camera at a large render distance, with the view of the last frame
+		int32_t camX, camY, camZ;
+		std::tie(camX, camY, camZ) = getBlockCoordsAt(playerSnapshot.pos);
+		int32_t camChunkX, camChunkZ;
+		std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(camX, camZ);
+		const int dist = CULLING_BENCHMARK_DISTANCE;
+		SectionCuller culler;
+		for(int32_t dx = -dist; dx <= dist; ++dx) {
+			for(int32_t dz = -dist; dz <= dist; ++dz) {
+				if(dx*dx + dz*dz <= dist*dist) culler.addChunk(camChunkX + dx, camChunkZ + dz);
+			}
+		}
+		
+		const int runs = 100;
+		std::vector<VisibleChunk> scalarChunks, vectorChunks;
+		int64_t start = Profiler::now();
+		for(int i = 0; i < runs; ++i) {
+			culler.cullScalar(lastFrustum, camChunkX, camChunkZ, dist, scalarChunks);
+		}
+		float scalarTime = (Profiler::now() - start) / 1000.0f / runs;
+		start = Profiler::now();
+		for(int i = 0; i < runs; ++i) {
+			culler.cull(lastFrustum, camChunkX, camChunkZ, dist, vectorChunks);
+		}
+		float vectorTime = (Profiler::now() - start) / 1000.0f / runs;
+		
+		auto byKey = [](const VisibleChunk& a, const VisibleChunk& b) { return a.key < b.key; };
+		std::sort(scalarChunks.begin(), scalarChunks.end(), byKey);
+		std::sort(vectorChunks.begin(), vectorChunks.end(), byKey);
+		bool same = std::equal(scalarChunks.begin(), scalarChunks.end(), vectorChunks.begin(), vectorChunks.end(),
+			[](const VisibleChunk& a, const VisibleChunk& b) { return a.key == b.key && a.sections == b.sections; });
+		size_t visible = 0;
+		for(const VisibleChunk& chunk : vectorChunks) {
+			visible += __builtin_popcount(chunk.sections);
+		}
+		
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision(3) << "Culled " << culler.chunkCount()*CHUNK_SECTIONS << " sections, "
+			<< visible << " visible, in ms per pass over all of them: " << scalarTime << " one chunk at a time, "
+			<< vectorTime << " vectorized"
+			<< (same ? "." : " (results differ!)");
+		console.write(ss.str());
+	});
+	console.addCommand("pipelinecheck", [&]() {
+		pipelineCheckRequested = true;
+	});
 	console.addCommand("rerender", [&]() {
+		std::lock_guard<std::mutex> lock(simulation.mutex());
 		chunkRenderer.reset();
+		loadScheduler.reset();
 	});
 	console.addCommand("save", [&]() {
-		world.saveToFile("data/world.bin");
-		console.write("Saved world to file.");
+		if(saving.valid()) {
+			console.write("A save is already in progress.");
+			return;
+		}
+		// The chunks are serialized and written from snapshots, while the simulation goes on
+		std::shared_ptr<WorldSave> save;
+		{
+			std::lock_guard<std::mutex> lock(simulation.mutex());
+			save = std::make_shared<WorldSave>(world.beginSave("data/world.bin"));
+		}
+		saving = std::async(std::launch::async, [save]() { save->write(); });
+	});
+	console.addCommand("trace", [&]() {
+		if(Profiler::dumpTrace("data/trace.json")) {
+			console.write("Saved profiler trace to data/trace.json.");
+		} else {
+			console.write("Could not write profiler trace.");
+		}
+	});
+	console.addCommand("fill", [&](const Console::Arguments& args) {
+		runEditCommand(args, 7, "fill <x1> <y1> <z1> <x2> <y2> <z2> <block>", [&]() {
+			return std::to_string(world.fill(parseRegion(args, 0), parseBlock(args[6]))) + " blocks changed.";
+		});
+	});
+	console.addCommand("replace", [&](const Console::Arguments& args) {
+		runEditCommand(args, 8, "replace <x1> <y1> <z1> <x2> <y2> <z2> <from> <to>", [&]() {
+			return std::to_string(world.replace(parseRegion(args, 0), parseBlock(args[6]), parseBlock(args[7]))) + " blocks changed.";
+		});
+	});
+	console.addCommand("sphere", [&](const Console::Arguments& args) {
+		runEditCommand(args, 5, "sphere <x> <y> <z> <radius> <block>", [&]() {
+			int32_t x, y, z;
+			std::tie(x, y, z) = parsePosition(args, 0);
+			return std::to_string(world.fillSphere(x, y, z, std::stof(args[3]), parseBlock(args[4]))) + " blocks changed.";
+		});
+	});
+	console.addCommand("copy", [&](const Console::Arguments& args) {
+		runEditCommand(args, 6, "copy <x1> <y1> <z1> <x2> <y2> <z2>", [&]() {
+			clipboard = world.copy(parseRegion(args, 0));
+			return "Copied " + std::to_string(clipboard.blocks.size()) + " blocks.";
+		});
+	});
+	console.addCommand("paste", [&](const Console::Arguments& args) {
+		runEditCommand(args, 3, "paste <x> <y> <z>", [&]() {
+			int32_t x, y, z;
+			std::tie(x, y, z) = parsePosition(args, 0);
+			return std::to_string(world.paste(clipboard, x, y, z)) + " blocks changed.";
+		});
 	});
 	console.addCommand("load", [&]() {
+		if(saving.valid()) {
+			console.write("Wait for the save to complete first.");
+			return;
+		}
+		std::lock_guard<std::mutex> lock(simulation.mutex());
 		player = world.loadFromFile("data/world.bin");
 		chunkRenderer.reset();
+		lodRenderer.reset(world.seed());
+		loadScheduler.reset();
 		console.write("Loaded world from file.");
 	});
 	
@@ -145,6 +362,60 @@ PlayState::PlayState(GameClient& client)
 	world.mobs.emplace_back(new Player(world, glm::vec3(8.0f, 50.0f, 8.0f)));
 	player = (Player*) world.mobs.back().get();
 	world.mobs.emplace_back(new Slime(world, glm::vec3(0.0f, 50.0f, 0.0f)));
+	
+	// Replays step the simulation once per frame, so that it only depends on the recorded inputs
+	simulation.setCallbacks([this](float dt) { preTick(dt); }, [this]() { postTick(); });
+	postTick();
+	simulation.start(client.isDeterministic());
+	mobSnapshots = simulation.getMobs();
+	playerSnapshot = mobSnapshots.front(); // the player was added first
+}
+
+PlayState::~PlayState() {
+	simulation.stop();
+	if(saving.valid()) saving.wait();
+}
+
+uint64_t PlayState::worldChecksum() {
+	std::lock_guard<std::mutex> lock(simulation.mutex());
+	return world.checksum();
+}
+
+void PlayState::runEditCommand(const Console::Arguments& args, size_t argCount, std::string usage, std::function<std::string()> edit) {
+	if(args.size() != argCount) {
+		console.write("Usage: " + usage);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(simulation.mutex());
+	try {
+		console.write(edit());
+	} catch(std::length_error& err) {
+		console.write("Regions are limited to " + std::to_string(World::MAX_EDIT_VOLUME) + " blocks. Usage: " + usage);
+	} catch(std::logic_error& err) {
+		console.write("Usage: " + usage);
+	}
+}
+
+std::tuple<int32_t, int32_t, int32_t> PlayState::parsePosition(const Console::Arguments& args, size_t first) {
+	int32_t playerPos[3];
+	std::tie(playerPos[0], playerPos[1], playerPos[2]) = getBlockCoordsAt(player->pos());
+	int32_t pos[3];
+	for(int i = 0; i < 3; ++i) {
+		const std::string& arg = args[first + i];
+		if(!arg.empty() && arg[0] == '~') {
+			pos[i] = playerPos[i] + (arg.size() > 1 ? std::stoi(arg.substr(1)) : 0);
+		} else {
+			pos[i] = std::stoi(arg);
+		}
+	}
+	return std::tuple<int32_t, int32_t, int32_t>(pos[0], pos[1], pos[2]);
+}
+
+BlockRegion PlayState::parseRegion(const Console::Arguments& args, size_t first) {
+	int32_t x1, y1, z1, x2, y2, z2;
+	std::tie(x1, y1, z1) = parsePosition(args, first);
+	std::tie(x2, y2, z2) = parsePosition(args, first + 3);
+	return BlockRegion(x1, y1, z1, x2, y2, z2);
 }
 
 void PlayState::setAntialiasing(bool enabled) {
@@ -158,10 +429,87 @@ void PlayState::setAntialiasing(bool enabled) {
 
 void PlayState::setRenderDistance(int renderDist2) {
 	renderDist = renderDist2;
-	fogEnd = renderDist * CHUNK_SIZE;
+	// With distant terrain, the fog only hides its far edge
+	fogEnd = (lodEnabled ? LodRenderer::lodDistance(renderDist2) : renderDist2) * CHUNK_SIZE;
 	fogStart = fogEnd * 0.9;
 }
 
+bool PlayState::compareFacePipelines(RenderParams params, int winWidth, int winHeight, int32_t camChunkX, int32_t camChunkZ, ViewFrustum& vf,
+		std::string& report) {
+	if(!faceRenderer.instancedAvailable()) {
+		report = "Face pipelines: the instanced pipeline was refused, as face buffers are larger than texture buffers can be!";
+		return false;
+	}
+	
+	// Same block passes as a frame, including the held block, which is drawn without the view transform
+	auto drawBlocks = [&]() {
+		faceRenderer.startRendering(params);
+		chunkRenderer.render();
+		if(lodEnabled) lodRenderer.render(camChunkX, camChunkZ, renderDist, vf);
+		chunkRenderer.renderTranslucent();
+		if(lodEnabled) lodRenderer.renderTranslucent(camChunkX, camChunkZ, renderDist, vf);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		RenderParams heldParams = params;
+		heldParams.applyView = false;
+		heldParams.applyFog = false;
+		faceRenderer.setParams(heldParams);
+		hotbar.render();
+		faceRenderer.stopRendering();
+	};
+	
+	FacePipeline selected = faceRenderer.pipeline();
+	faceRenderer.pipeline(FacePipeline::geometryShader);
+	std::vector<uint8_t> geometryImage = renderOffscreen(winWidth, winHeight, SKY_COLOR, drawBlocks);
+	faceRenderer.pipeline(FacePipeline::instanced);
+	std::vector<uint8_t> instancedImage = renderOffscreen(winWidth, winHeight, SKY_COLOR, drawBlocks);
+	faceRenderer.pipeline(selected);
+	
+	// Rounding may differ slightly between the two, so only larger differences count
+	const int tolerance = 2;
+	size_t differentPixels = 0;
+	int maxDiff = 0;
+	for(size_t pixel = 0; pixel < geometryImage.size(); pixel += 4) {
+		int diff = 0;
+		for(size_t channel = 0; channel < 3; ++channel) {
+			diff = std::max(diff, std::abs(geometryImage[pixel + channel] - instancedImage[pixel + channel]));
+		}
+		maxDiff = std::max(maxDiff, diff);
+		if(diff > tolerance) differentPixels++;
+	}
+	
+	std::stringstream ss;
+	ss << "Face pipelines: " << differentPixels << " of " << geometryImage.size()/4 << " pixels differ"
+		<< " (largest difference " << maxDiff << "/255)" << (differentPixels == 0 ? ", images match." : "!");
+	report = ss.str();
+	return differentPixels == 0;
+}
+
+bool PlayState::checkFacePipelines(int winWidth, int winHeight) {
+	{
+		// Above the spawn, looking down and across it, with the distant terrain in view
+		std::lock_guard<std::mutex> lock(simulation.mutex());
+		player->movementMode(MovementMode::flying);
+		player->pos(glm::vec3(8.0f, 70.0f, 8.0f));
+		player->orient(glm::vec3(-TAU/12, TAU/8, 0.0f));
+	}
+	int settledFrames = 0;
+	for(int frame = 0; frame < PIPELINE_CHECK_MAX_FRAMES && settledFrames < PIPELINE_CHECK_SETTLE_FRAMES; ++frame) {
+		update(PIPELINE_CHECK_FRAME_TIME);
+		render(winWidth, winHeight);
+		client.getTextRenderer().endFrame();
+		Profiler::endFrame();
+		std::lock_guard<std::mutex> lock(inputMutex);
+		settledFrames = playerView.loadQueueSize == 0 ? settledFrames + 1 : 0;
+	}
+	if(settledFrames < PIPELINE_CHECK_SETTLE_FRAMES) std::cout << "Chunks were still loading when the images were taken" << std::endl;
+	
+	pipelineCheckRequested = true;
+	update(PIPELINE_CHECK_FRAME_TIME);
+	render(winWidth, winHeight);
+	std::cout << pipelineCheckReport << std::endl;
+	return pipelineCheckPassed;
+}
+
 void PlayState::update(float dt) {
 	InputManager& input = client.getInputManager();
 	
@@ -170,6 +518,10 @@ void PlayState::update(float dt) {
 		client.getInputManager().capturingMouse(!paused);
 	}
 	
+	std::tuple<int,int,bool,bool> movementKeys(0, 0, false, false);
+	glm::vec3 rotation(0.0f);
+	bool breakBlock = false, placeBlock = false;
+	glm::vec2 mouseMvt = input.getMouseMovement();
 	if(paused) {
 		if(input.justClicked(1)) {
 			glm::ivec2 pos = input.getMousePosition();
@@ -188,10 +540,8 @@ void PlayState::update(float dt) {
 		console.update(input);
 		
 		if(!console.isOpen()) {
-			player->handleKeys(input.getMovementKeys(), dt);
-			
-			glm::vec2 mouseMvt = input.getMouseMovement();
-			player->rotate(glm::vec3(mouseMvt.y, -mouseMvt.x, 0));
+			movementKeys = input.getMovementKeys();
+			rotation = glm::vec3(mouseMvt.y, -mouseMvt.x, 0);
 			
 			int scroll = input.justScrolled();
 			if(scroll > 0) {
@@ -206,61 +556,127 @@ void PlayState::update(float dt) {
 			
 			bool click1 = input.justClicked(1);
 			bool click2 = input.justClicked(2);
-			if(click1 || click2) {
-				bool hit;
-				int x, y, z;
-				std::tie(hit, x, y, z) = player->castRay(PLAYER_REACH, !click1, false);
-				if(hit && World::isValidHeight(y)) {
-					if(click2) {
-						if(!world.hasSolidBlock(x, y, z) && !world.containsMobs(x, y, z))
-							world.setBlock(x, y, z, Block::fromId(hotbar.held()));
-					} else {
-						auto blockTex = world.getBlock(x, y, z)->mainTexture();
-						world.removeBlock(x, y, z);
-						particleRenderer.spawnBlockBits(glm::vec3((float) x, (float) y, (float) z), blockTex);
-					}
-				}
-			}
+			breakBlock = click1 && !click2;
+			placeBlock = click2 && !click1;
+		}
+	}
+	
+	{
+		std::lock_guard<std::mutex> lock(inputMutex);
+		playerInput.movementKeys = movementKeys;
+		playerInput.rotation += rotation;
+		playerInput.breakBlock |= breakBlock;
+		playerInput.placeBlock |= placeBlock;
+		playerInput.heldBlock = hotbar.held();
+		for(auto& broken : brokenBlocks) {
+			particleRenderer.spawnBlockBits(broken.first, broken.second);
 		}
+		brokenBlocks.clear();
+	}
+	
+	if(client.isDeterministic()) {
+		simulation.step();
 	}
 	
-	if(paused || console.isOpen()) {
-		input.getMouseMovement();
-		player->handleKeys(std::tuple<int,int,bool,bool>(0,0,false,false), dt);
+	mobSnapshots = simulation.getMobs();
+	for(MobSnapshot& mob : mobSnapshots) {
+		if(mob.type == Serializer::Mob_Player) playerSnapshot = mob;
 	}
 	
 	int32_t camX, camY, camZ;
-	std::tie(camX, camY, camZ) = getBlockCoordsAt(player->pos());
+	std::tie(camX, camY, camZ) = getBlockCoordsAt(playerSnapshot.pos);
 	int32_t camChunkX, camChunkZ;
 	std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(camX, camZ);
-	int loads = 0;
-	SpiralIterator iter(camChunkX, camChunkZ);
-	while(iter.withinSquareDistance(renderDist + 1)) {
-		if(iter.withinDistance(renderDist + 2)) {
-			int x = iter.getX();
-			int z = iter.getZ();
-			if(!world.isChunkLoaded(x, z)) {
-				world.genChunk(x, z);
-				loads++;
-			} else if(!chunkRenderer.isChunkRendered(x, z)) {
-				world.markChunkDirty(x, z);
-				loads++;
+	if(distController.enabled()) {
+		int newDist = distController.update(client.getFrameTime(), renderDist);
+		if(newDist != renderDist) setRenderDistance(newDist);
+		loadBudget = distController.loadBudget(CHUNK_LOAD_BUDGET);
+	}
+	{
+		Profiler::Scope scope("chunk meshing");
+		{
+			// Only taking the snapshots needs the world: rather than wait for a running tick, try again next frame
+			std::unique_lock<std::mutex> lock(simulation.mutex(), std::try_to_lock);
+			if(lock.owns_lock()) {
+				chunkRenderer.unloadFarChunks(camChunkX, camChunkZ, renderDist);
+				chunkRenderer.collectUpdates();
 			}
-			if(loads >= LOADS_PER_FRAME) break;
 		}
-		iter.next();
+		int64_t start = Profiler::now();
+		size_t meshed = chunkRenderer.updateBlocks();
+		loadScheduler.reportMeshing(meshed, (Profiler::now() - start) / 1000.0f);
+	}
+	if(lodEnabled) {
+		Profiler::Scope scope("distant terrain update");
+		lodRenderer.update(camChunkX, camChunkZ, renderDist);
+	}
+	if(saving.valid() && saving.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		try {
+			saving.get();
+			console.write("Saved world to file.");
+		} catch(std::runtime_error& err) {
+			console.write(err.what());
+		}
+	}
+	{
+		Profiler::Scope scope("particle update");
+		particleRenderer.update(dt);
+	}
+}
+
+void PlayState::preTick(float dt) {
+	PlayerInput input;
+	{
+		std::lock_guard<std::mutex> lock(inputMutex);
+		input = playerInput;
+		playerInput.breakBlock = false;
+		playerInput.placeBlock = false;
 	}
 	
-	world.updateBlocks();
-	chunkRenderer.updateBlocks();
-	
-	world.updateEntities(dt);
+	player->handleKeys(input.movementKeys, dt);
+	player->rotate(input.rotation - appliedRotation);
+	appliedRotation = input.rotation;
+	
+	if(input.breakBlock || input.placeBlock) {
+		bool hit;
+		int x, y, z;
+		std::tie(hit, x, y, z) = player->castRay(PLAYER_REACH, input.placeBlock, false);
+		if(hit && World::isValidHeight(y)) {
+			if(input.placeBlock) {
+				if(!world.hasSolidBlock(x, y, z) && !world.containsMobs(x, y, z))
+					world.setBlock(x, y, z, Block::fromId(input.heldBlock));
+			} else {
+				auto blockTex = world.getBlock(x, y, z)->mainTexture();
+				world.removeBlock(x, y, z);
+				std::lock_guard<std::mutex> lock(inputMutex);
+				brokenBlocks.emplace_back(glm::vec3((float) x, (float) y, (float) z), blockTex);
+			}
+		}
+	}
 	
-	particleRenderer.update(dt);
+	int32_t camX, camY, camZ;
+	std::tie(camX, camY, camZ) = getBlockCoordsAt(player->pos());
+	int32_t camChunkX, camChunkZ;
+	std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(camX, camZ);
+	{
+		Profiler::Scope scope("chunk loading");
+		loadScheduler.update(camChunkX, camChunkZ, player->dirVector(), renderDist);
+		loadScheduler.process(loadBudget);
+	}
 }
 
-void printElapsedTime(const char* operation, double before) {
-	std::cout << operation << ": " << round((glfwGetTime() - before)*10000) / 10.0 << " ms" << std::endl;
+void PlayState::postTick() {
+	PlayerView view;
+	view.appliedRotation = appliedRotation;
+	view.orient = player->orient();
+	view.eyeUnderwater = player->isEyeUnderwater();
+	std::tie(view.targetHit, view.targetX, view.targetY, view.targetZ) = player->castRay(PLAYER_REACH, false, false);
+	view.movementMode = player->movementMode();
+	view.verticalSpeed = player->speed().y;
+	view.loadQueueSize = loadScheduler.queueSize();
+	
+	std::lock_guard<std::mutex> lock(inputMutex);
+	playerView = view;
 }
 
 void PlayState::render(int winWidth, int winHeight) {
@@ -269,14 +685,24 @@ void PlayState::render(int winWidth, int winHeight) {
 	float aspect = ((float) winWidth) / winHeight;
 	float near = 0.001f;
 	float far = 1000.0f;
-	glm::vec3 playerPos = player->eyePos();
+	// The camera follows the mouse immediately, even if the simulation hasn't applied the rotation yet
+	PlayerView playerState;
+	glm::vec3 orient;
+	{
+		std::lock_guard<std::mutex> lock(inputMutex);
+		playerState = playerView;
+		orient = playerView.orient + playerInput.rotation - playerView.appliedRotation;
+	}
+	orient.x = std::min(std::max(orient.x, -TAU/4), TAU/4);
+	glm::vec3 playerPos = playerSnapshot.pos + glm::vec3(0, EYE_HEIGHT, 0);
 	glm::mat4 proj = glm::perspective(fovy, aspect, near, far);
-	glm::mat4 view = globalToLocal(playerPos, player->orient());
+	glm::mat4 view = globalToLocal(playerPos, orient);
 	
-	ViewFrustum vf = computeViewFrustum(fovy, aspect, near, far, playerPos, player->orient());
+	ViewFrustum vf = computeViewFrustum(fovy, aspect, near, far, playerPos, orient);
+	lastFrustum = vf;
 	
 	int32_t camX, camY, camZ;
-	std::tie(camX, camY, camZ) = getBlockCoordsAt(player->pos());
+	std::tie(camX, camY, camZ) = getBlockCoordsAt(playerSnapshot.pos);
 	int32_t camChunkX, camChunkZ;
 	std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(camX, camZ);
 	
@@ -289,28 +715,52 @@ void PlayState::render(int winWidth, int winHeight) {
 	glEnable(GL_DEPTH_TEST);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	
+	// Shared by every pass of the frame
+	FrameData frameData;
+	frameData.view = view;
+	frameData.invView = glm::inverse(view);
+	frameData.proj = proj;
+	frameData.fogColor = glm::vec4(SKY_COLOR[0], SKY_COLOR[1], SKY_COLOR[2], 1.0f);
+	frameData.fogStart = fogStart;
+	frameData.fogEnd = fogEnd;
+	frameUniforms.update(&frameData);
+	
 	// Start the face rendering
-	RenderParams params = {
-		{ SKY_COLOR[0], SKY_COLOR[1], SKY_COLOR[2] },
-		true, true,
-		fogStart, fogEnd,
-	};
-	faceRenderer.startRendering(proj, view, params);
-	chunkRenderer.render(camChunkX, camChunkZ, renderDist, vf);
-	faceRenderer.stopRendering();
-	checkGlErrors("block rendering");
-	
-	entityRenderer.renderEntities(world, proj, view, params);
-	checkGlErrors("entity rendering");
-	
-	bool hit;
-	int x, y, z;
-	std::tie(hit, x, y, z) = player->castRay(PLAYER_REACH, false, false);
-	if(hit) {
+	RenderParams params = { true, true };
+	{
+		Profiler::Scope scope("block rendering");
+		faceRenderer.startRendering(params);
+		{
+			Profiler::Scope scope("section culling");
+			chunkRenderer.cullSections(playerPos, renderDist, vf);
+		}
+		{
+			Profiler::Scope scope("translucent sorting");
+			chunkRenderer.sortTranslucentFaces();
+		}
+		chunkRenderer.render();
+		if(lodEnabled) lodRenderer.render(camChunkX, camChunkZ, renderDist, vf);
+		faceRenderer.stopRendering();
+		checkGlErrors("block rendering");
+	}
+	
+	if(pipelineCheckRequested) {
+		pipelineCheckRequested = false;
+		pipelineCheckPassed = compareFacePipelines(params, winWidth, winHeight, camChunkX, camChunkZ, vf, pipelineCheckReport);
+		console.write(pipelineCheckReport);
+	}
+	
+	{
+		Profiler::Scope scope("entity rendering");
+		entityRenderer.renderEntities(mobSnapshots, params);
+		checkGlErrors("entity rendering");
+	}
+	
+	if(playerState.targetHit) {
 		blockOverlayProgram.use();
 		blockOverlayProgram.setUniform("view", view);
 		blockOverlayProgram.setUniform("proj", proj);
-		glm::mat4 model = glm::translate(glm::mat4(1.0), glm::vec3((float) x, (float) y, (float) z));
+		glm::mat4 model = glm::translate(glm::mat4(1.0), glm::vec3((float) playerState.targetX, (float) playerState.targetY, (float) playerState.targetZ));
 		blockOverlayProgram.setUniform("model", model);
 		blockOverlayProgram.setUniform("color", 0.0f, 0.0f, 0.0f, 1.0f);
 		blockOverlayBuffer.bind();
@@ -320,26 +770,36 @@ void PlayState::render(int winWidth, int winHeight) {
 		checkGlErrors("block overlay rendering");
 	}
 	
-	particleRenderer.render(proj, view, fovy, winHeight);
-	checkGlErrors("particle rendering");
+	{
+		Profiler::Scope scope("particle rendering");
+		particleRenderer.render(fovy, winHeight);
+		checkGlErrors("particle rendering");
+	}
 	
-	faceRenderer.startRendering(proj, view, params);
-	chunkRenderer.renderTranslucent(camChunkX, camChunkZ, renderDist, vf);
-	checkGlErrors("translucent block rendering");
+	faceRenderer.startRendering(params);
+	{
+		Profiler::Scope scope("translucent block rendering");
+		chunkRenderer.renderTranslucent();
+		if(lodEnabled) lodRenderer.renderTranslucent(camChunkX, camChunkZ, renderDist, vf);
+		checkGlErrors("translucent block rendering");
+	}
 	
-	glClear(GL_DEPTH_BUFFER_BIT);
-	params.applyView = false;
-	params.applyFog = false;
-	faceRenderer.setParams(params);
-	hotbar.render();
-	faceRenderer.stopRendering();
-	checkGlErrors("held block rendering");
+	{
+		Profiler::Scope scope("held block rendering");
+		glClear(GL_DEPTH_BUFFER_BIT);
+		params.applyView = false;
+		params.applyFog = false;
+		faceRenderer.setParams(params);
+		hotbar.render();
+		faceRenderer.stopRendering();
+		checkGlErrors("held block rendering");
+	}
 	
 	// After this point, no depth testing needed
 	glDisable(GL_DEPTH_TEST);
 	
 	// Draw underwater overlay
-	if(player->isEyeUnderwater()) {
+	if(playerState.eyeUnderwater) {
 		colorOverlayProgram.use();
 		colorOverlayProgram.setUniform("color", 0.11f, 0.43f, 0.97f, 0.3f);
 		colorOverlayBuffer.bind();
@@ -362,6 +822,7 @@ void PlayState::render(int winWidth, int winHeight) {
 	checkGlErrors("cursor rendering");
 	
 	TextRenderer& textRenderer = client.getTextRenderer();
+	Profiler::Scope textScope("text rendering");
 	
 	if(paused) {
 		colorOverlayProgram.use();
@@ -383,11 +844,38 @@ void PlayState::render(int winWidth, int winHeight) {
 		std::stringstream debugStream;
 		debugStream << client.getFPS() << " FPS" << std::endl;
 		debugStream << "Pos: " << vec3ToString(playerPos) << std::endl;
-		debugStream << "Mode: " << movementModeNames[static_cast<int>(player->movementMode())] << std::endl;
-		debugStream << "Vertical speed: " << player->speed().y << std::endl;
+		debugStream << "Mode: " << movementModeNames[static_cast<int>(playerState.movementMode)] << std::endl;
+		debugStream << "Vertical speed: " << playerState.verticalSpeed << std::endl;
 		debugStream << "Rendered chunks: " << chunkRenderer.renderedChunkCount() << std::endl;
+		debugStream << "Chunk load queue: " << playerState.loadQueueSize << std::endl;
+		debugStream << "Drawn sections: " << chunkRenderer.drawnSectionCount() << " / "
+			<< chunkRenderer.frustumSectionCount() << " in frustum"
+			<< (chunkRenderer.occlusionCulling() ? "" : " (occlusion culling disabled)") << std::endl;
+		if(lodEnabled) {
+			debugStream << "Distant terrain: " << lodRenderer.tileCount() << " tiles ("
+				<< lodRenderer.pendingTileCount() << " meshing), up to " << LodRenderer::lodDistance(renderDist) << " chunks" << std::endl;
+		}
+		debugStream << "Render distance: " << renderDist;
+		if(distController.enabled()) {
+			debugStream << " (auto: " << std::setprecision(1) << std::fixed << distController.smoothedFrameTime() << " / "
+				<< distController.targetFrameTime() << " ms, load budget " << loadBudget << " ms)";
+			debugStream.unsetf(std::ios::fixed);
+			debugStream << std::setprecision(6);
+		}
+		debugStream << std::endl;
+		for(const std::string& decision : distController.decisions()) {
+			debugStream << "  " << decision << std::endl;
+		}
 		debugStream << "Antialiasing: " << (antialiasing ? "enabled" : "disabled") << std::endl;
+		debugStream << "Cached text layouts: " << client.getTextRenderer().cachedLayoutCount()
+			<< " (glyph pages cleared: " << client.getTextRenderer().glyphEvictions() << ")" << std::endl;
 		//debugStream << "Unicode test: AéǄ‰₪ℝψЯאصखଇணఔฌ갃ば亶〠㊆😎😂" << std::endl;
+		debugStream << "Timings (min / avg / p99):" << std::endl;
+		debugStream << std::fixed << std::setprecision(2);
+		for(ProfileStats& stats : Profiler::getStats()) {
+			debugStream << std::string(2*(stats.depth + 1), ' ') << stats.name << ": "
+				<< stats.min << " / " << stats.avg << " / " << stats.p99 << " ms" << std::endl;
+		}
 		textRenderer.renderText(debugStream.str(), -winWidth/2 + 5, winHeight/2 - 20, glm::vec4(1.0, 1.0, 1.0, 1.0));
 		checkGlErrors("debug text rendering");
 	}
@@ -1,52 +1,114 @@
 #pragma once
 
 #include <vector>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <tuple>
+#include <utility>
+#include <string>
+#include <functional>
 
 #include "client.hpp"
 #include "pixcraft/util/glm.hpp"
 
 #include "face_renderer.hpp"
 #include "chunk_renderer.hpp"
+#include "lod_renderer.hpp"
+#include "chunk_load_scheduler.hpp"
 #include "entity_renderer.hpp"
 #include "particle_renderer.hpp"
 #include "hotbar.hpp"
 #include "gui.hpp"
 #include "console.hpp"
+#include "render_distance_controller.hpp"
+#include "view_frustum.hpp"
 
 #include "pixcraft/server/world_module.hpp"
 #include "pixcraft/server/world.hpp"
 #include "pixcraft/server/chunk.hpp"
 #include "pixcraft/server/mob.hpp"
+#include "pixcraft/server/player.hpp"
+#include "pixcraft/server/simulation.hpp"
 
 namespace PixCraft {
 	class PlayState : public GameState {
 	public:
 		PlayState(GameClient& client);
+		~PlayState();
 		
 		void update(float dt) override;
 		void render(int winWidth, int winHeight) override;
+		uint64_t worldChecksum() override;
+		
+		// For --pipeline-check: runs frames from a fixed camera until the chunks around it are loaded, then draws them
+		// offscreen with both face pipelines and prints how many pixels differ. Returns true if the images match.
+		bool checkFacePipelines(int winWidth, int winHeight);
 		
 	private:
 		static constexpr float SKY_COLOR[3] = {0.75f, 0.9f, 1.0f};
-		static const int LOADS_PER_FRAME = 1;
+		static constexpr float CHUNK_LOAD_BUDGET = 4.0f; // in ms per tick
 		static constexpr float PLAYER_REACH = 5.0f;
+		static const int CULLING_BENCHMARK_DISTANCE = 32;
+		static constexpr float PIPELINE_CHECK_FRAME_TIME = 1 / 60.0f;
+		static const int PIPELINE_CHECK_MAX_FRAMES = 3600;
+		static const int PIPELINE_CHECK_SETTLE_FRAMES = 60; // after the last chunk loads, for meshing and distant terrain
 		
 		bool antialiasing;
 		bool showDebug;
 		bool paused;
-		int renderDist;
+		std::atomic<int> renderDist;
 		float fogStart, fogEnd;
+		bool lodEnabled; // distant terrain, see LodRenderer
+		RenderDistanceController distController;
+		std::atomic<float> loadBudget; // in ms per tick, lowered by distController
 		
 		Console console;
 		
+		// Player input collected every frame, applied on the next tick
+		struct PlayerInput {
+			std::tuple<int,int,bool,bool> movementKeys;
+			glm::vec3 rotation; // total since the start, so that the camera can add what is not applied yet
+			bool breakBlock, placeBlock;
+			BlockId heldBlock;
+		};
+		
+		// Player state published after every tick, for rendering
+		struct PlayerView {
+			glm::vec3 appliedRotation;
+			glm::vec3 orient;
+			bool eyeUnderwater;
+			bool targetHit;
+			int targetX, targetY, targetZ;
+			MovementMode movementMode;
+			float verticalSpeed;
+			size_t loadQueueSize; // the scheduler is only touched with the world locked
+		};
+		
 		World world;
-		Player* player;
+		Player* player; // only accessed with the world locked
+		Simulation simulation;
+		
+		std::mutex inputMutex; // guards the following, which are shared with the simulation thread
+		PlayerInput playerInput;
+		PlayerView playerView;
+		std::vector<std::pair<glm::vec3, TexId>> brokenBlocks;
+		
+		std::future<void> saving; // world save running in the background
+		BlockClipboard clipboard; // for the copy and paste commands
+		
+		glm::vec3 appliedRotation; // simulation thread only
+		std::vector<MobSnapshot> mobSnapshots;
+		MobSnapshot playerSnapshot;
 		
 		FaceRenderer faceRenderer;
 		ChunkRenderer chunkRenderer;
+		LodRenderer lodRenderer;
+		ChunkLoadScheduler loadScheduler;
 		EntityRenderer entityRenderer;
 		ParticleRenderer particleRenderer;
 		Hotbar hotbar;
+		UniformBuffer frameUniforms; // FrameData, updated once per frame
 		
 		ShaderProgram cursorProgram;
 		IndexBuffer<glm::vec2> cursorBuffer;
@@ -57,7 +119,26 @@ namespace PixCraft {
 		
 		std::vector<Button> menuButtons;
 		
+		ViewFrustum lastFrustum; // for benchcull
+		bool pipelineCheckRequested; // by the pipelinecheck command, done during the next render
+		bool pipelineCheckPassed; // result of the last check
+		std::string pipelineCheckReport;
+		
+		void preTick(float dt);
+		void postTick();
+		
 		void setAntialiasing(bool enabled);
 		void setRenderDistance(int renderDist);
+		// Draws the blocks offscreen with both face pipelines, and describes how much the two images differ in the report;
+		// returns true if they match
+		bool compareFacePipelines(RenderParams params, int winWidth, int winHeight, int32_t camChunkX, int32_t camChunkZ, ViewFrustum& vf,
+			std::string& report);
+		
+		// Runs a bulk edit command with the world locked, and writes the message it returns;
+		// malformed arguments print the usage instead.
+		void runEditCommand(const Console::Arguments& args, size_t argCount, std::string usage, std::function<std::string()> edit);
+		// Coordinates may be relative to the player, with "~" or "~<offset>"; only call with the world locked
+		std::tuple<int32_t, int32_t, int32_t> parsePosition(const Console::Arguments& args, size_t first);
+		BlockRegion parseRegion(const Console::Arguments& args, size_t first);
 	};
 }
@@ -0,0 +1,77 @@
+#include "render_distance_controller.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <sstream>
+#include <iomanip>
+
+using namespace PixCraft;
+
+RenderDistanceController::RenderDistanceController()
+	: _enabled(false), _targetFrameTime(1000 / 60.0f), smoothed(0.0f), framesBelow(0), framesAbove(0),
+	  cooldown(0), raiseCooldown(0) { }
+
+bool RenderDistanceController::enabled() { return _enabled; }
+
+void RenderDistanceController::enabled(bool enabled) {
+	if(enabled && !_enabled) {
+		smoothed = _targetFrameTime;
+		framesBelow = framesAbove = 0;
+		cooldown = raiseCooldown = 0;
+	}
+	_enabled = enabled;
+}
+
+float RenderDistanceController::targetFrameTime() { return _targetFrameTime; }
+void RenderDistanceController::targetFrameTime(float target) {
+	// The load budget is scaled by the headroom relative to the target, which has to be a positive duration
+	if(!std::isfinite(target) || target <= 0.0f) throw std::out_of_range("Target frame time must be positive");
+	_targetFrameTime = target;
+}
+
+int RenderDistanceController::update(float frameTime, int renderDist) {
+	if(!_enabled) return renderDist;
+	
+	smoothed += SMOOTHING * (frameTime - smoothed);
+	framesBelow = smoothed < RAISE_BELOW * _targetFrameTime ? framesBelow + 1 : 0;
+	framesAbove = smoothed > LOWER_ABOVE * _targetFrameTime ? framesAbove + 1 : 0;
+	if(cooldown > 0) cooldown--;
+	if(raiseCooldown > 0) raiseCooldown--;
+	if(cooldown > 0) return renderDist;
+	
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(1);
+	if(framesAbove >= LOWER_FRAMES && renderDist > MIN_DISTANCE) {
+		ss << smoothed << " ms: lowered to " << renderDist - 1;
+		log(ss.str());
+		cooldown = COOLDOWN_FRAMES;
+		raiseCooldown = RAISE_COOLDOWN_FRAMES;
+		framesAbove = 0;
+		return renderDist - 1;
+	}
+	if(framesBelow >= RAISE_FRAMES && raiseCooldown == 0 && renderDist < MAX_DISTANCE) {
+		ss << smoothed << " ms: raised to " << renderDist + 1;
+		log(ss.str());
+		cooldown = COOLDOWN_FRAMES;
+		framesBelow = 0;
+		return renderDist + 1;
+	}
+	return renderDist;
+}
+
+float RenderDistanceController::loadBudget(float maxBudget) {
+	if(!_enabled) return maxBudget;
+	// Full budget up to the raising threshold, down to a quarter at the target and beyond
+	float headroom = (_targetFrameTime - smoothed) / ((1 - RAISE_BELOW) * _targetFrameTime);
+	return maxBudget * std::min(std::max(headroom, 0.25f), 1.0f);
+}
+
+float RenderDistanceController::smoothedFrameTime() { return smoothed; }
+
+const std::deque<std::string>& RenderDistanceController::decisions() { return _decisions; }
+
+void RenderDistanceController::log(std::string decision) {
+	_decisions.push_back(decision);
+	if(_decisions.size() > MAX_DECISIONS) _decisions.pop_front();
+}
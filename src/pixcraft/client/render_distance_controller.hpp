@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <deque>
+
+namespace PixCraft {
+	// Adjusts the render distance and the chunk load budget to hold a target frame time.
+	// The distance only changes after the smoothed frame time has stayed outside a band around the target for a while,
+	// and every change is followed by a cooldown, longer before raising the distance again after lowering it,
+	// so that the controller settles instead of oscillating.
+	class RenderDistanceController {
+	public:
+		static const int MIN_DISTANCE = 2;
+		static const int MAX_DISTANCE = 24;
+		
+		RenderDistanceController();
+		
+		bool enabled();
+		void enabled(bool enabled);
+		float targetFrameTime(); // in ms
+		void targetFrameTime(float target); // throws std::out_of_range unless finite and positive
+		
+		// Called once per frame with the last frame time (in ms) and the current render distance;
+		// returns the new render distance.
+		int update(float frameTime, int renderDist);
+		// Budget for chunk loading, in ms per tick: shrinks as frames get close to the target
+		float loadBudget(float maxBudget);
+		
+		float smoothedFrameTime();
+		// The last few decisions, oldest first, for the debug overlay
+		const std::deque<std::string>& decisions();
+	
+	private:
+		static constexpr float SMOOTHING = 0.05f;
+		static constexpr float RAISE_BELOW = 0.7f; // fraction of the target
+		static constexpr float LOWER_ABOVE = 1.05f;
+		static const int RAISE_FRAMES = 120; // frames the smoothed time has to stay below / above the band
+		static const int LOWER_FRAMES = 20;
+		static const int COOLDOWN_FRAMES = 60; // after any change, for the new chunks to load or unload
+		static const int RAISE_COOLDOWN_FRAMES = 600; // before raising again after lowering
+		static const size_t MAX_DECISIONS = 4;
+		
+		bool _enabled;
+		float _targetFrameTime;
+		float smoothed;
+		int framesBelow, framesAbove;
+		int cooldown, raiseCooldown;
+		std::deque<std::string> _decisions;
+		
+		void log(std::string decision);
+	};
+}
@@ -0,0 +1,75 @@
+#include "section_connectivity.hpp"
+
+#include <bitset>
+#include <vector>
+
+#include "pixcraft/util/util.hpp"
+
+using namespace PixCraft;
+
+SectionConnectivity SectionConnectivity::none() {
+	return SectionConnectivity { { 0, 0, 0, 0, 0, 0 } };
+}
+
+SectionConnectivity SectionConnectivity::all() {
+	return SectionConnectivity { { 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f } };
+}
+
+SectionConnectivity SectionConnectivity::compute(const ChunkSnapshot& chunk, int section) {
+	// Indices are local to the section, in the same order as in chunks (x + 16*z + 256*y)
+	std::bitset<SECTION_BLOCKS> visited;
+	int baseY = section * CHUNK_SECTION_HEIGHT;
+	size_t openBlocks = 0;
+	for(int idx = 0; idx < SECTION_BLOCKS; ++idx) {
+		int x = idx % CHUNK_SIZE, z = (idx / CHUNK_SIZE) % CHUNK_SIZE, y = idx / CHUNK_COLUMNS;
+		if(chunk.isOpaqueCube(x, baseY + y, z)) {
+			visited.set(idx); // never entered
+		} else {
+			openBlocks++;
+		}
+	}
+	if(openBlocks == 0) return none();
+	if(openBlocks == SECTION_BLOCKS) return all();
+	
+	SectionConnectivity result = none();
+	std::vector<uint16_t> stack;
+	for(int start = 0; start < SECTION_BLOCKS; ++start) {
+		if(visited[start]) continue;
+		// Faces touched by this connected region of open blocks
+		uint8_t faces = 0;
+		visited.set(start);
+		stack.push_back(start);
+		while(!stack.empty()) {
+			int idx = stack.back();
+			stack.pop_back();
+			int x = idx % CHUNK_SIZE, z = (idx / CHUNK_SIZE) % CHUNK_SIZE, y = idx / CHUNK_COLUMNS;
+			for(int side = 0; side < 6; ++side) {
+				int x2 = x + sideVectors[side][0];
+				int y2 = y + sideVectors[side][1];
+				int z2 = z + sideVectors[side][2];
+				if(x2 < 0 || x2 >= CHUNK_SIZE || y2 < 0 || y2 >= CHUNK_SECTION_HEIGHT || z2 < 0 || z2 >= CHUNK_SIZE) {
+					faces |= 1 << side;
+					continue;
+				}
+				int idx2 = x2 + CHUNK_SIZE*z2 + CHUNK_COLUMNS*y2;
+				if(!visited[idx2]) {
+					visited.set(idx2);
+					stack.push_back(idx2);
+				}
+			}
+		}
+		for(int side = 0; side < 6; ++side) {
+			if(faces & (1 << side)) result.connected[side] |= faces;
+		}
+	}
+	return result;
+}
+
+bool SectionConnectivity::connects(int from, int to) const {
+	return connected[from] & (1 << to);
+}
+
+int PixCraft::oppositeSide(int side) {
+	// Horizontal sides go around in a circle, then -Y and +Y
+	return side < 4 ? (side + 2) % 4 : 9 - side;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+#include "pixcraft/server/chunk.hpp"
+
+namespace PixCraft {
+	// Which faces of a chunk section can see each other through the blocks that aren't opaque cubes.
+	// Faces are numbered like sideVectors. Computed when meshing, for occlusion culling (see ChunkRenderer::cullSections).
+	struct SectionConnectivity {
+		uint8_t connected[6]; // bit j of connected[i] is set if faces i and j are connected
+		
+		static SectionConnectivity none();
+		static SectionConnectivity all();
+		// Flood fills the section through non-opaque blocks
+		static SectionConnectivity compute(const ChunkSnapshot& chunk, int section);
+		
+		bool connects(int from, int to) const;
+	};
+	
+	int oppositeSide(int side);
+}
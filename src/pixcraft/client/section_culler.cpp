@@ -0,0 +1,118 @@
+#include "section_culler.hpp"
+
+#include <cstring>
+#include <tuple>
+
+#include "pixcraft/server/world_module.hpp"
+#include "pixcraft/server/chunk.hpp"
+#include "pixcraft/util/util.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	// GCC vector extensions, compiled to SSE/NEON where available
+	typedef float float4 __attribute__((vector_size(16)));
+	typedef int32_t int4 __attribute__((vector_size(16)));
+	
+	float4 load4(const float* p) {
+		float4 v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+	
+	static_assert(CHUNK_SECTIONS % 4 == 0, "The sections of a chunk are culled four at a time");
+}
+
+void SectionCuller::addChunk(int32_t chunkX, int32_t chunkZ) {
+	uint64_t key = packCoords(chunkX, chunkZ);
+	if(slots.count(key)) return;
+	slots[key] = keys.size();
+	keys.push_back(key);
+	for(int section = 0; section < CHUNK_SECTIONS; ++section) {
+		minX.push_back(CHUNK_SIZE * chunkX);
+		minY.push_back(CHUNK_SECTION_HEIGHT * section);
+		minZ.push_back(CHUNK_SIZE * chunkZ);
+	}
+}
+
+void SectionCuller::removeChunk(int32_t chunkX, int32_t chunkZ) {
+	auto iter = slots.find(packCoords(chunkX, chunkZ));
+	if(iter == slots.end()) return;
+	size_t slot = iter->second;
+	size_t last = keys.size() - 1;
+	slots.erase(iter);
+	if(slot != last) {
+		keys[slot] = keys[last];
+		slots[keys[slot]] = slot;
+		for(int section = 0; section < CHUNK_SECTIONS; ++section) {
+			minX[slot*CHUNK_SECTIONS + section] = minX[last*CHUNK_SECTIONS + section];
+			minY[slot*CHUNK_SECTIONS + section] = minY[last*CHUNK_SECTIONS + section];
+			minZ[slot*CHUNK_SECTIONS + section] = minZ[last*CHUNK_SECTIONS + section];
+		}
+	}
+	keys.pop_back();
+	minX.resize(last * CHUNK_SECTIONS);
+	minY.resize(last * CHUNK_SECTIONS);
+	minZ.resize(last * CHUNK_SECTIONS);
+}
+
+void SectionCuller::clear() {
+	minX.clear();
+	minY.clear();
+	minZ.clear();
+	keys.clear();
+	slots.clear();
+}
+
+size_t SectionCuller::chunkCount() {
+	return keys.size();
+}
+
+void SectionCuller::cull(const ViewFrustum& vf, int32_t camChunkX, int32_t camChunkZ, int drawDist, std::vector<VisibleChunk>& out) {
+	// As in isSectionVisible, a box is outside if its n-vertex is in front of a plane.
+	// The n-vertex only depends on the signs of the normal, so its offset from the corner is folded into the plane.
+	glm::vec3 size(CHUNK_SIZE, CHUNK_SECTION_HEIGHT, CHUNK_SIZE);
+	glm::vec4 planes[6];
+	int i = 0;
+	for(const ViewPlane* viewPlane : { &vf.left, &vf.right, &vf.bottom, &vf.top, &vf.far, &vf.near }) {
+		glm::vec4 plane = viewPlane->plane;
+		glm::vec3 offset = size * glm::vec3(plane.x < 0, plane.y < 0, plane.z < 0) - 0.5f;
+		plane.w += glm::dot(glm::vec3(plane), offset);
+		planes[i++] = plane;
+	}
+	float camX = CHUNK_SIZE * camChunkX, camZ = CHUNK_SIZE * camChunkZ;
+	float maxDistSq = (float) (drawDist*CHUNK_SIZE) * (drawDist*CHUNK_SIZE);
+	
+	out.clear();
+	for(size_t chunk = 0; chunk < keys.size(); ++chunk) {
+		uint8_t sections = 0;
+		for(int section = 0; section < CHUNK_SECTIONS; section += 4) {
+			size_t idx = chunk*CHUNK_SECTIONS + section;
+			float4 x = load4(&minX[idx]), y = load4(&minY[idx]), z = load4(&minZ[idx]);
+			float4 dx = x - camX, dz = z - camZ;
+			int4 inside = dx*dx + dz*dz <= maxDistSq;
+			for(const glm::vec4& plane : planes) {
+				inside &= x*plane.x + y*plane.y + z*plane.z + plane.w <= 0.0f;
+			}
+			for(int lane = 0; lane < 4; ++lane) {
+				if(inside[lane]) sections |= 1 << (section + lane);
+			}
+		}
+		if(sections) out.push_back({ keys[chunk], sections });
+	}
+}
+
+void SectionCuller::cullScalar(ViewFrustum& vf, int32_t camChunkX, int32_t camChunkZ, int drawDist, std::vector<VisibleChunk>& out) {
+	out.clear();
+	for(auto& pair : slots) {
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = unpackCoords(pair.first);
+		int32_t dist = (chunkX-camChunkX)*(chunkX-camChunkX) + (chunkZ-camChunkZ)*(chunkZ-camChunkZ);
+		if(dist > drawDist*drawDist || !isVisible(vf, chunkX, chunkZ)) continue;
+		uint8_t sections = 0;
+		for(int section = 0; section < CHUNK_SECTIONS; ++section) {
+			if(isSectionVisible(vf, chunkX, section, chunkZ)) sections |= 1 << section;
+		}
+		if(sections) out.push_back({ pair.first, sections });
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+
+#include "view_frustum.hpp"
+
+namespace PixCraft {
+	struct VisibleChunk {
+		uint64_t key; // see packCoords
+		uint8_t sections; // bitmask
+	};
+	
+	// Bounding boxes of the sections of the rendered chunks, in contiguous coordinate arrays,
+	// so that frustum culling tests several sections at once.
+	// Chunks are added and removed with all of their sections; removing one moves the last chunk into its slot.
+	class SectionCuller {
+	public:
+		void addChunk(int32_t chunkX, int32_t chunkZ);
+		void removeChunk(int32_t chunkX, int32_t chunkZ);
+		void clear();
+		size_t chunkCount();
+		
+		// Replaces out by the chunks with sections both in the frustum and within drawDist chunks horizontally
+		void cull(const ViewFrustum& vf, int32_t camChunkX, int32_t camChunkZ, int drawDist, std::vector<VisibleChunk>& out);
+		// The same, one chunk at a time with isVisible and isSectionVisible, to compare with
+		void cullScalar(ViewFrustum& vf, int32_t camChunkX, int32_t camChunkZ, int drawDist, std::vector<VisibleChunk>& out);
+	
+	private:
+		std::vector<float> minX, minY, minZ; // corner of each section, CHUNK_SECTIONS consecutive ones per chunk
+		std::vector<uint64_t> keys; // per chunk
+		std::unordered_map<uint64_t, size_t> slots;
+	};
+}
@@ -25,6 +25,7 @@ ShaderProgram::ShaderProgram() : programId(0) {};
 
 void ShaderProgram::init(const char* vertexSrc, const char* geometrySrc, const char* fragmentSrc) {
 	programId = glCreateProgram();
+	locations.clear();
 	
 	GlId vertexShader = glCreateShader(GL_VERTEX_SHADER);
 	glShaderSource(vertexShader, 1, &vertexSrc, nullptr);
@@ -59,29 +60,55 @@ void ShaderProgram::init(const char* vertexSrc, const char* fragmentSrc) {
 	init(vertexSrc, nullptr, fragmentSrc);
 }
 
+GLint ShaderProgram::uniformLocation(const char* name) {
+	auto iter = locations.find(name);
+	if(iter != locations.end()) return iter->second;
+	GLint location = glGetUniformLocation(programId, name);
+	locations.emplace(name, location);
+	return location;
+}
+
 void ShaderProgram::setUniform(const char* name, bool val) {
-	glUniform1i(glGetUniformLocation(programId, name), val);
+	setUniform(uniformLocation(name), val);
 }
 void ShaderProgram::setUniform(const char* name, uint32_t val) {
-	glUniform1i(glGetUniformLocation(programId, name), val);
+	setUniform(uniformLocation(name), val);
 }
 void ShaderProgram::setUniform(const char* name, float val) {
-	glUniform1f(glGetUniformLocation(programId, name), val);
+	setUniform(uniformLocation(name), val);
 }
 void ShaderProgram::setUniform(const char* name, float x, float y) {
-	glUniform2f(glGetUniformLocation(programId, name), x, y);
+	glUniform2f(uniformLocation(name), x, y);
 }
 void ShaderProgram::setUniform(const char* name, glm::vec3 val) {
-	glUniform3fv(glGetUniformLocation(programId, name), 1, glm::value_ptr(val));
+	glUniform3fv(uniformLocation(name), 1, glm::value_ptr(val));
 }
 void ShaderProgram::setUniform(const char* name, float r, float g, float b) {
-	glUniform3f(glGetUniformLocation(programId, name), r, g, b);
+	glUniform3f(uniformLocation(name), r, g, b);
 }
 void ShaderProgram::setUniform(const char* name, float r, float g, float b, float a) {
-	glUniform4f(glGetUniformLocation(programId, name), r, g, b, a);
+	glUniform4f(uniformLocation(name), r, g, b, a);
 }
 void ShaderProgram::setUniform(const char* name, glm::mat4& val) {
-	glUniformMatrix4fv(glGetUniformLocation(programId, name), 1, GL_FALSE, glm::value_ptr(val));
+	setUniform(uniformLocation(name), val);
+}
+
+void ShaderProgram::setUniform(GLint location, bool val) {
+	glUniform1i(location, val);
+}
+void ShaderProgram::setUniform(GLint location, uint32_t val) {
+	glUniform1i(location, val);
+}
+void ShaderProgram::setUniform(GLint location, float val) {
+	glUniform1f(location, val);
+}
+void ShaderProgram::setUniform(GLint location, glm::mat4& val) {
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(val));
+}
+
+void ShaderProgram::bindUniformBlock(const char* name, GLuint bindingPoint) {
+	GLuint index = glGetUniformBlockIndex(programId, name);
+	if(index != GL_INVALID_INDEX) glUniformBlockBinding(programId, index, bindingPoint);
 }
 
 void ShaderProgram::use() {
@@ -92,6 +119,30 @@ void ShaderProgram::unuse() {
 }
 
 
+UniformBuffer::UniformBuffer() : uboId(0), size(0), bindingPoint(0) {}
+
+UniformBuffer::~UniformBuffer() {
+	if(uboId == 0) return;
+	glDeleteBuffers(1, &uboId);
+}
+
+void UniformBuffer::init(size_t size2, GLuint bindingPoint2) {
+	size = size2;
+	bindingPoint = bindingPoint2;
+	glGenBuffers(1, &uboId);
+	glBindBuffer(GL_UNIFORM_BUFFER, uboId);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::update(const void* data) {
+	glBindBuffer(GL_UNIFORM_BUFFER, uboId);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, uboId);
+}
+
+
 VertexArray::VertexArray() : vaoId(0) {}
 
 VertexArray::~VertexArray() {
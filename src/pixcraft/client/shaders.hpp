@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <string>
+#include <unordered_map>
 
 #include "glfw.hpp"
 #include "pixcraft/util/glm.hpp"
@@ -8,6 +10,7 @@
 namespace PixCraft {
 	namespace ShaderSources {
 		extern const char *blockVS, *blockGS, *blockFS;
+		extern const char *blockInstancedVS;
 		extern const char *entityVS, *entityFS;
 		extern const char *particleVS, *particleFS;
 		extern const char *menuBgVS, *menuBgFS;
@@ -16,11 +19,28 @@ namespace PixCraft {
 		extern const char *overlayVS;
 		extern const char *blockOverlayVS;
 		extern const char *guiVS;
+		extern const char *textVS;
 		extern const char *textFS;
 		extern const char *colorFS;
 		extern const char *textureFS;
 	}
 	
+	// Binding points of the uniform blocks shared between programs
+	const GLuint FRAME_DATA_BINDING = 0;
+	
+	// Rendering state shared by the block, entity and particle programs for a whole frame,
+	// as their "FrameData" uniform block; the layout follows std140
+	struct FrameData {
+		glm::mat4 view;
+		glm::mat4 invView;
+		glm::mat4 proj;
+		glm::vec4 fogColor;
+		float fogStart;
+		float fogEnd;
+		float padding[2];
+	};
+	static_assert(sizeof(FrameData) == 3*64 + 2*16, "FrameData doesn't match its std140 layout");
+	
 	class ShaderProgram {
 	public:
 		ShaderProgram();
@@ -28,6 +48,9 @@ namespace PixCraft {
 		void init(const char* vertexSrc, const char* geometrySrc, const char* fragmentSrc);
 		void init(const char* vertexSrc, const char* fragmentSrc);
 		
+		// Looked up once per name, then cached; frequently set uniforms should keep the location
+		GLint uniformLocation(const char* name);
+		
 		void setUniform(const char* name, bool val);
 		void setUniform(const char* name, uint32_t val);
 		void setUniform(const char* name, float val);
@@ -37,14 +60,39 @@ namespace PixCraft {
 		void setUniform(const char* name, float r, float g, float b, float a);
 		void setUniform(const char* name, glm::mat4& val);
 		
+		void setUniform(GLint location, bool val);
+		void setUniform(GLint location, uint32_t val);
+		void setUniform(GLint location, float val);
+		void setUniform(GLint location, glm::mat4& val);
+		
 		template<std::size_t N>
 		void setUniformArray(const char* name, std::array<glm::mat3, N> array);
 		
+		// Attaches a uniform block of the program to a binding point (see UniformBuffer); does nothing if it has none
+		void bindUniformBlock(const char* name, GLuint bindingPoint);
+		
 		void use();
 		void unuse();
 		
 	private:
 		GlId programId;
+		std::unordered_map<std::string, GLint> locations;
+	};
+	
+	// Storage for a uniform block, shared by every program attached to its binding point
+	class UniformBuffer {
+	public:
+		UniformBuffer();
+		~UniformBuffer();
+		
+		void init(size_t size, GLuint bindingPoint);
+		// Also binds the buffer to its binding point again
+		void update(const void* data);
+		
+	private:
+		GlId uboId;
+		size_t size;
+		GLuint bindingPoint;
 	};
 	
 	
@@ -78,6 +126,8 @@ namespace PixCraft {
 		
 		void updateData(const void* data, size_t vertexCount);
 		
+		GlId bufferId(); // the VBO, for texture buffers
+		
 	protected:
 		size_t vertexSize;
 		
@@ -5,7 +5,7 @@
 namespace PixCraft {
 	template<std::size_t N>
 	void ShaderProgram::setUniformArray(const char* name, std::array<glm::mat3, N> array) {
-		glUniformMatrix3fv(glGetUniformLocation(programId, name), N, GL_FALSE, glm::value_ptr(array[0]));
+		glUniformMatrix3fv(uniformLocation(name), N, GL_FALSE, glm::value_ptr(array[0]));
 	}
 
 
@@ -28,6 +28,9 @@ namespace PixCraft {
 	template<typename... Ts>
 	size_t VertexBuffer<Ts...>::vertexCount() { return _vertexCount; }
 
+	template<typename... Ts>
+	GlId VertexBuffer<Ts...>::bufferId() { return vboId; }
+
 	template<typename... Ts>
 	void VertexBuffer<Ts...>::updateData(const void* data, size_t vertexCount) {
 		glBindBuffer(GL_ARRAY_BUFFER, vboId);
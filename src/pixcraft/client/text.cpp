@@ -18,37 +18,35 @@ void TextRenderer::init() {
 	FT_Stroker_New(ft, &stroker);
 	FT_Stroker_Set(stroker, 64 * 3/2, FT_STROKER_LINECAP_ROUND, FT_STROKER_LINEJOIN_ROUND, 0);
 	
-	loadFont("res/font/NotoSans-Regular.ttf");
-	loadFont("res/font/NotoEmoji-Regular.ttf");
-	loadFont("res/font/NotoSansCJKjp-Regular.otf");
-	loadFont("res/font/LastResort.ttf");
-	
 	fontHeight = 16;
 	xHeight = 0;
-	for(unsigned int i = 0; i < faces.size(); ++i) {
-		FT_Set_Pixel_Sizes(faces[i], 0, fontHeight);
-	}
+	addFont("res/font/NotoSans-Regular.ttf");
+	addFont("res/font/NotoEmoji-Regular.ttf");
+	addFont("res/font/NotoSansCJKjp-Regular.otf");
+	addFont("res/font/LastResort.ttf");
+	loadFont(faces[0]);
 	
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Disable byte-alignment restriction
 	
-	glyphAtlas.init(512, 512);
+	glyphAtlas.init(ATLAS_SIZE, ATLAS_SIZE, ATLAS_PAGES);
 	
-	// Preload ASCII characters at least
-	glyphAtlas.bind();
-	for(uint32_t c = 0x20; c < 0x7F; ++c) {
-		prerenderCharacter(c);
-	}
+	// Glyphs are rasterized the first time they are drawn, and uploaded with the next flush
 	
-	program.init(ShaderSources::guiVS, ShaderSources::textFS);
-	buffer.init(0, 2*sizeof(float), 4*sizeof(float));
-	buffer.loadData(nullptr, 6*BUFFER_SIZE, GL_STREAM_DRAW);
+	program.init(ShaderSources::textVS, ShaderSources::textFS);
+	program.use();
+	program.setUniform("tex", (uint32_t) 0);
+	program.unuse();
+	frameNo = 0;
 	checkGlErrors("text renderer initialization");
 }
 
 void TextRenderer::free() {
-	for(unsigned int i = 0; i < faces.size(); ++i) {
-		FT_Done_Face(faces[i]);
+	layouts.clear();
+	unusedLayouts.clear();
+	for(FontFace& font : faces) {
+		if(font.loaded) FT_Done_Face(font.face);
 	}
+	faces.clear(); // after the faces, which read from the mappings
 	FT_Done_FreeType(ft);
 }
 
@@ -89,82 +87,150 @@ int TextRenderer::getTextHeight() {
 	return xHeight;
 }
 
-void TextRenderer::renderText(std::string str, float startX, float startY, glm::vec4 color) {
-	program.use();
-	buffer.bind();
-	
-	glyphAtlas.bind();
-	
-	program.setUniform("winSize", (float) winWidth, (float) winHeight);
-	program.setUniform("tex", (uint32_t) 0);
-	program.setUniform("textColor", color.r, color.g, color.b, color.a);
-	
-	float x = startX;
-	float y = startY;
+void TextRenderer::renderText(const std::string& str, float x, float y, glm::vec4 color) {
+	auto iter = layouts.find(str);
+	if(iter == layouts.end()) {
+		std::unique_ptr<TextLayout> layout;
+		if(unusedLayouts.empty()) {
+			layout.reset(new TextLayout());
+		} else {
+			layout = std::move(unusedLayouts.back());
+			unusedLayouts.pop_back();
+		}
+		layOut(str, *layout);
+		iter = layouts.emplace(str, std::move(layout)).first;
+	}
+	iter->second->lastUsed = frameNo;
+	renderLayout(*iter->second, x, y, color);
+}
+
+void TextRenderer::endFrame() {
+	bool full = layouts.size() > MAX_CACHED_LAYOUTS;
+	for(auto iter = layouts.begin(); iter != layouts.end();) {
+		uint64_t unusedFor = frameNo - iter->second->lastUsed;
+		if(unusedFor >= LAYOUT_LIFETIME || (full && unusedFor > 0)) {
+			if(unusedLayouts.size() < MAX_UNUSED_LAYOUTS) unusedLayouts.push_back(std::move(iter->second));
+			iter = layouts.erase(iter);
+		} else {
+			++iter;
+		}
+	}
+	frameNo++;
+	glyphAtlas.endFrame();
+}
+
+size_t TextRenderer::cachedLayoutCount() { return layouts.size(); }
+uint64_t TextRenderer::glyphEvictions() { return glyphAtlas.evictions(); }
+
+void TextRenderer::layOut(const std::string& str, TextLayout& layout) {
+	float x = 0;
+	float y = 0;
 	float lineHeight = round(fontHeight * 1.25);
+	int width = 0;
 	
 	std::string::const_iterator it = str.begin();
 	std::string::const_iterator end = str.end();
 	uint32_t cp;
 	
-	std::array<float, QUAD_SIZE*BUFFER_SIZE> quadBuffer;
-	auto bufferIt = quadBuffer.begin();
+	std::vector<float> quads;
+	quads.reserve(QUAD_SIZE * str.size());
+	uint32_t pages = 0;
 	
+	// New glyphs may clear an atlas page, so the string is laid out again until it only uses valid glyphs
+	uint64_t evictions = glyphAtlas.evictions();
 	while(it != end) {
 		cp = utf8::next(it, end);
 		if(cp == '\n') {
-			x = startX;
+			x = 0;
 			y -= lineHeight;
 			continue;
 		}
 		
-		if(characters.count(cp) == 0) prerenderCharacter(cp);
-		CharacterData characterData = characters[cp];
-		
-		renderGlyphData(bufferIt, characterData.glyphData, x, y);
-		
-		if(bufferIt == quadBuffer.end()) {
-			bufferIt = quadBuffer.begin();
-			buffer.updateData(quadBuffer.data(), quadBuffer.size()/4);
-			glDrawArrays(GL_TRIANGLES, 0, quadBuffer.size()/4);
+		auto charIter = characters.find(cp);
+		if(charIter == characters.end() || !glyphAtlas.isValid(charIter->second.glyphData.atlasId)) {
+			prerenderCharacter(cp);
+			charIter = characters.find(cp);
 		}
+		CharacterData& characterData = charIter->second;
+		
+		renderGlyphData(quads, characterData.glyphData, x, y);
+		pages |= 1u << glyphAtlas.getPage(characterData.glyphData.atlasId);
 		
 		x += characterData.advance >> 6; // Bitshift by 6 to get value in pixels (2^6 = 64)
+		width = std::max(width, (int) x);
+		
+		if(glyphAtlas.evictions() != evictions) {
+			evictions = glyphAtlas.evictions();
+			it = str.begin();
+			x = y = 0;
+			width = 0;
+			quads.clear();
+			pages = 0;
+		}
 	}
 	
-	if(bufferIt != quadBuffer.begin()) {
-		size_t vertices = (bufferIt - quadBuffer.begin())/4;
-		buffer.updateData(quadBuffer.data(), vertices);
-		glDrawArrays(GL_TRIANGLES, 0, vertices);
-	}
+	if(!layout.buffer.isInitialized()) layout.buffer.init(0, 2*sizeof(float), 5*sizeof(float));
+	layout.vertexCount = quads.size() / 5;
+	layout.buffer.loadData(quads.data(), layout.vertexCount, GL_STATIC_DRAW);
+	layout.text = str;
+	layout.width = width;
+	layout.pages = pages;
+	layout.atlasEvictions = evictions;
+	layout.lastUsed = frameNo;
+}
+
+void TextRenderer::renderLayout(TextLayout& layout, float x, float y, glm::vec4 color) {
+	if(layout.atlasEvictions != glyphAtlas.evictions()) layOut(layout.text, layout);
+	if(layout.vertexCount == 0) return;
+	glyphAtlas.touchPages(layout.pages);
+	glyphAtlas.flush(); // all the glyphs rasterized since the last draw, one upload per page
 	
-	buffer.unbind();
+	program.use();
+	glyphAtlas.bind();
+	
+	program.setUniform("winSize", (float) winWidth, (float) winHeight);
+	program.setUniform("offset", x, y);
+	program.setUniform("textColor", color.r, color.g, color.b, color.a);
+	
+	layout.buffer.bind();
+	glDrawArrays(GL_TRIANGLES, 0, layout.vertexCount);
+	layout.buffer.unbind();
 	program.unuse();
 }
 
-void TextRenderer::loadFont(const char* filename) {
+void TextRenderer::addFont(std::string path) {
 	faces.emplace_back();
-	if(FT_New_Face(ft, filename, 0, &faces.back())) {
+	faces.back().path = std::move(path);
+	faces.back().loaded = false;
+}
+
+void TextRenderer::loadFont(FontFace& font) {
+	font.file.open(font.path);
+	if(FT_New_Memory_Face(ft, font.file.data(), font.file.size(), 0, &font.face)) {
+		font.file.close();
 		std::stringstream errorMsg;
-		errorMsg << "Failed to load font " << filename << "." << std::endl;
+		errorMsg << "Failed to load font " << font.path << "." << std::endl;
 		throw std::runtime_error(errorMsg.str());
 	}
+	FT_Set_Pixel_Sizes(font.face, 0, fontHeight);
+	font.loaded = true;
 }
 
 void TextRenderer::prerenderCharacter(uint32_t cp) {
 	unsigned int i = 0;
-	FT_UInt glyphIdx;
-	while(i < faces.size() && (glyphIdx = FT_Get_Char_Index(faces[i], cp)) == 0) {
-		++i;
+	FT_UInt glyphIdx = 0;
+	for(; i < faces.size(); ++i) {
+		if(!faces[i].loaded) loadFont(faces[i]);
+		if((glyphIdx = FT_Get_Char_Index(faces[i].face, cp)) != 0) break;
 	}
 	
-	if(i == faces.size() || FT_Load_Glyph(faces[i], glyphIdx, FT_LOAD_DEFAULT)) {
+	if(i == faces.size() || FT_Load_Glyph(faces[i].face, glyphIdx, FT_LOAD_DEFAULT)) {
 		std::stringstream errorMsg;
 		errorMsg << "Failed to load glyph for U+" << std::hex << cp << "." << std::endl;
 		throw std::runtime_error(errorMsg.str());
 	}
 	
-	FT_GlyphSlot glyphSlot = faces[i]->glyph;
+	FT_GlyphSlot glyphSlot = faces[i].face->glyph;
 	int32_t advanceX = glyphSlot->advance.x;
 	int32_t height = glyphSlot->metrics.height;
 	
@@ -182,7 +248,7 @@ void TextRenderer::prerenderCharacter(uint32_t cp) {
 	glm::ivec2 size(bitmapGlyph->bitmap.width, bitmapGlyph->bitmap.rows);
 	glm::ivec2 offset(bitmapGlyph->left - outlineBitmapGlyph->left, outlineBitmapGlyph->top - bitmapGlyph->top);
 	
-	unsigned char* buffer = new unsigned char[outlineSize.x*outlineSize.y*2];
+	std::vector<unsigned char> buffer(outlineSize.x*outlineSize.y*2);
 	for(int x = 0; x < outlineSize.x; ++x) {
 		for(int y = 0; y < outlineSize.y; ++y) {
 			size_t i = x*2 + y*outlineSize.x*2;
@@ -195,7 +261,17 @@ void TextRenderer::prerenderCharacter(uint32_t cp) {
 			}
 		}
 	}
-	unsigned int atlasId = glyphAtlas.addTexture(outlineSize.x, outlineSize.y, buffer);
+	// Glyphs rasterized again after their atlas page was cleared keep their atlas entry
+	auto previous = characters.find(cp);
+	unsigned int atlasId;
+	if(previous != characters.end()) {
+		atlasId = previous->second.glyphData.atlasId;
+		glyphAtlas.replaceTexture(atlasId, outlineSize.x, outlineSize.y, buffer.data());
+	} else {
+		atlasId = glyphAtlas.addTexture(outlineSize.x, outlineSize.y, buffer.data());
+	}
+	FT_Done_Glyph(glyph);
+	FT_Done_Glyph(outlineGlyph);
 	
 	GlyphData glyphData = GlyphData {
 		atlasId,
@@ -209,7 +285,8 @@ void TextRenderer::prerenderCharacter(uint32_t cp) {
 	};
 }
 
-void TextRenderer::renderGlyphData(float*& bufferIt, GlyphData& data, float x, float y) {
+void TextRenderer::renderGlyphData(std::vector<float>& quads, GlyphData& data, float x, float y) {
+	float page = glyphAtlas.getPage(data.atlasId);
 	float l = glyphAtlas.getL(data.atlasId);
 	float r = glyphAtlas.getR(data.atlasId);
 	float t = glyphAtlas.getT(data.atlasId);
@@ -221,13 +298,39 @@ void TextRenderer::renderGlyphData(float*& bufferIt, GlyphData& data, float x, f
 	float ypos = y + data.bearing.y;
 	
 	float vertices[QUAD_SIZE] = {
-		xpos,     ypos,       l, b,
-		xpos,     ypos - h,   l, t,
-		xpos + w, ypos,       r, b,
-		xpos + w, ypos,       r, b,
-		xpos,     ypos - h,   l, t,
-		xpos + w, ypos - h,   r, t
+		xpos,     ypos,       l, b, page,
+		xpos,     ypos - h,   l, t, page,
+		xpos + w, ypos,       r, b, page,
+		xpos + w, ypos,       r, b, page,
+		xpos,     ypos - h,   l, t, page,
+		xpos + w, ypos - h,   r, t, page
 	};
-	std::copy(vertices, vertices + QUAD_SIZE, bufferIt);
-	bufferIt += QUAD_SIZE;
+	quads.insert(quads.end(), vertices, vertices + QUAD_SIZE);
+}
+
+
+TextLabel::TextLabel(std::string text) : _text(text), laidOut(false) { }
+
+const std::string& TextLabel::text() { return _text; }
+
+void TextLabel::text(std::string text) {
+	if(text == _text) return;
+	_text = text;
+	laidOut = false;
+}
+
+int TextLabel::width(TextRenderer& textRenderer) {
+	update(textRenderer);
+	return layout.width;
+}
+
+void TextLabel::render(TextRenderer& textRenderer, float x, float y, glm::vec4 color) {
+	update(textRenderer);
+	textRenderer.renderLayout(layout, x, y, color);
+}
+
+void TextLabel::update(TextRenderer& textRenderer) {
+	if(laidOut) return;
+	textRenderer.layOut(_text, layout);
+	laidOut = true;
 }
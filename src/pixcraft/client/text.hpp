@@ -3,6 +3,9 @@
 #include <cstdint>
 #include <unordered_map>
 #include <array>
+#include <vector>
+#include <string>
+#include <memory>
 
 #include "glfw.hpp"
 #include "pixcraft/util/glm.hpp"
@@ -13,6 +16,7 @@
 
 #include "shaders.hpp"
 #include "texture_atlas.hpp"
+#include "pixcraft/util/mapped_file.hpp"
 
 namespace PixCraft {
 	struct GlyphData {
@@ -27,6 +31,17 @@ namespace PixCraft {
 		int32_t height;
 	};
 	
+	// Quads of a string, relative to the start of its first baseline, ready to be drawn in one call
+	struct TextLayout {
+		VertexBuffer<glm::vec2, glm::vec3> buffer; // position, then texture coordinates and atlas page
+		size_t vertexCount;
+		std::string text;
+		int width;
+		uint32_t pages; // bitmask of the atlas pages its glyphs are on
+		uint64_t atlasEvictions; // laid out again when the atlas clears a page
+		uint64_t lastUsed; // frame, for the cache of TextRenderer
+	};
+	
 	class TextRenderer {
 	public:
 		void init();
@@ -38,28 +53,74 @@ namespace PixCraft {
 		int getTextWidth(std::string str);
 		int getTextHeight();
 		
-		void renderText(std::string str, float x, float y, glm::vec4 color);
+		// Layouts are cached by string, and only moved by the position, so text that doesn't change
+		// costs one draw call per frame; see endFrame for their lifetime
+		void renderText(const std::string& str, float x, float y, glm::vec4 color);
+		// Drops the layouts that were not drawn in the last LAYOUT_LIFETIME frames
+		void endFrame();
+		size_t cachedLayoutCount();
+		uint64_t glyphEvictions(); // atlas pages cleared to make room for new glyphs
+		
+		// For layouts kept outside of the cache, see TextLabel
+		void layOut(const std::string& str, TextLayout& layout);
+		void renderLayout(TextLayout& layout, float x, float y, glm::vec4 color);
 		
 	private:
-		static const size_t QUAD_SIZE = 24;
-		static const int BUFFER_SIZE = 32;
+		static const size_t QUAD_SIZE = 30;
+		static const int ATLAS_SIZE = 512;
+		static const int ATLAS_PAGES = 4;
+		// In frames; short, since text that changes every frame (like the debug overlay) leaves a layout behind each time
+		static const uint64_t LAYOUT_LIFETIME = 8;
+		static const size_t MAX_CACHED_LAYOUTS = 256; // beyond this, layouts not drawn in the current frame are dropped
+		static const size_t MAX_UNUSED_LAYOUTS = 16; // dropped layouts whose buffers are kept for new ones
 		
 		FT_Library ft;
 		FT_Stroker stroker;
-		std::vector<FT_Face> faces;
+		// In order of preference; only the first is opened up front, the fallbacks when a character is missing
+		// from all the faces before them
+		struct FontFace {
+			std::string path;
+			MappedFile file; // FreeType reads the font straight from the mapping, which has to outlive the face
+			FT_Face face;
+			bool loaded;
+		};
+		std::vector<FontFace> faces;
 		TextureAtlas glyphAtlas;
 		std::unordered_map<uint32_t, CharacterData> characters;
 		
 		int winWidth, winHeight;
 		ShaderProgram program;
-		VertexBuffer<glm::vec2, glm::vec2> buffer;
 		int fontHeight;
 		int xHeight;
 		
-		void loadFont(const char* filename);
+		std::unordered_map<std::string, std::unique_ptr<TextLayout>> layouts;
+		std::vector<std::unique_ptr<TextLayout>> unusedLayouts;
+		uint64_t frameNo;
+		
+		void addFont(std::string path);
+		void loadFont(FontFace& font);
 		
 		void prerenderCharacter(uint32_t c);
 		
-		void renderGlyphData(float*& bufferIt, GlyphData& data, float x, float y);
+		void renderGlyphData(std::vector<float>& quads, GlyphData& data, float x, float y);
+	};
+	
+	// Text laid out once and kept until it changes, for labels that stay on screen
+	class TextLabel {
+	public:
+		TextLabel(std::string text);
+		
+		const std::string& text();
+		void text(std::string text);
+		
+		int width(TextRenderer& textRenderer);
+		void render(TextRenderer& textRenderer, float x, float y, glm::vec4 color);
+		
+	private:
+		std::string _text;
+		bool laidOut;
+		TextLayout layout;
+		
+		void update(TextRenderer& textRenderer);
 	};
 }
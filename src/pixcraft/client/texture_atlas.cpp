@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <stdexcept>
 #include <cstddef>
+#include <cstring>
 
 #include <iostream>
 
@@ -10,86 +11,203 @@ using namespace PixCraft;
 
 const GLint internalFormat = GL_RG8;
 const GLenum format = GL_RG;
+const int PIXEL_SIZE = 2;
 
 Rect newRect(int left, int bottom, int width, int height) {
 	return Rect { left, left + width, bottom, bottom + height, width, height };
 }
 
-void TextureAtlas::init(int width2, int height2) {
+void TextureAtlas::init(int width2, int height2, int pageCount) {
 	width = width2; height = height2;
+	frameNo = 0;
+	_evictions = 0;
+	if(pageCount > 32) throw std::logic_error("Texture atlases have at most 32 pages");
+	
 	glActiveTexture(GL_TEXTURE0);
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	
-	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0,
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, width, height, pageCount, 0,
 		format, GL_UNSIGNED_BYTE, nullptr);
 	
-	freeSpace.push_back(newRect(0, 0, width, height));
+	pages.resize(pageCount);
+	for(Page& page : pages) {
+		page.generation = 0;
+		clearPage(page);
+	}
+	flush();
+}
+
+unsigned int TextureAtlas::addTexture(int width2, int height2, const void* data) {
+	textures.push_back(packTexture(width2, height2, data));
+	return textures.size() - 1;
 }
 
-unsigned int TextureAtlas::addTexture(int width, int height, void* data) {
-	int width2 = width + 1;
-	int height2 = height + 1;
+void TextureAtlas::replaceTexture(unsigned int textureId, int width2, int height2, const void* data) {
+	textures[textureId] = packTexture(width2, height2, data);
+}
+
+TextureAtlas::Entry TextureAtlas::packTexture(int width2, int height2, const void* data) {
+	// One pixel of padding on the left and bottom keeps neighbours from bleeding into each other
+	int paddedWidth = width2 + 1;
+	int paddedHeight = height2 + 1;
+	if(paddedWidth > width || paddedHeight > height)
+		throw std::runtime_error("Texture too large for texture atlas.");
 	
-	int bestGap = -1;
-	size_t bestRectIdx;
-	for(size_t i = 0; i < freeSpace.size(); ++i) {
-		Rect freeRect = freeSpace[i];
-		if(width2 <= freeRect.width && height2 <= freeRect.height) {
-			int gap = std::min(freeRect.width - width2, freeRect.height - height2);
-			if(bestGap == -1 || gap < bestGap) {
-				bestGap = gap;
-				bestRectIdx = i;
-			}
-		}
+	int x, y;
+	int nodeIdx = -1;
+	unsigned int pageIdx = 0;
+	for(; pageIdx < pages.size(); ++pageIdx) {
+		nodeIdx = findPlace(pages[pageIdx], paddedWidth, paddedHeight, x, y);
+		if(nodeIdx != -1) break;
+	}
+	if(nodeIdx == -1) {
+		auto lru = std::min_element(pages.begin(), pages.end(),
+			[](const Page& a, const Page& b) { return a.lastUsed < b.lastUsed; });
+		if(lru->lastUsed == frameNo)
+			throw std::runtime_error("No more space in texture atlas.");
+		clearPage(*lru);
+		_evictions++;
+		pageIdx = lru - pages.begin();
+		nodeIdx = findPlace(*lru, paddedWidth, paddedHeight, x, y);
 	}
 	
-	if(bestGap == -1)
-		throw std::runtime_error("No more space in texture atlas.");
-	
-	Rect bestRect = freeSpace[bestRectIdx];
-	freeSpace.erase(freeSpace.begin() + bestRectIdx);
+	// Raise the skyline over the box, then cut the nodes it now covers, and merge nodes of equal height
+	Page& page = pages[pageIdx];
+	std::vector<SkylineNode>& skyline = page.skyline;
+	skyline.insert(skyline.begin() + nodeIdx, SkylineNode { x, y + paddedHeight, paddedWidth });
+	size_t i = nodeIdx + 1;
+	while(i < skyline.size()) {
+		int overlap = skyline[i-1].x + skyline[i-1].width - skyline[i].x;
+		if(overlap <= 0) break;
+		skyline[i].x += overlap;
+		skyline[i].width -= overlap;
+		if(skyline[i].width > 0) break;
+		skyline.erase(skyline.begin() + i);
+	}
+	i = 0;
+	while(i + 1 < skyline.size()) {
+		if(skyline[i].y == skyline[i+1].y) {
+			skyline[i].width += skyline[i+1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		} else {
+			++i;
+		}
+	}
 	
-	if(bestRect.width < bestRect.height) {
-		freeSpace.push_back(newRect(bestRect.left, bestRect.bottom + height2, bestRect.width, bestRect.height - height2));
-		freeSpace.push_back(newRect(bestRect.left + width2, bestRect.bottom, bestRect.width - width2, height2));
+	Rect rect = newRect(x + 1, y + 1, width2, height2);
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+	for(int row = 0; row < height2; ++row) {
+		std::memcpy(&page.pixels[((rect.bottom + row)*width + rect.left) * PIXEL_SIZE],
+			src + row*width2*PIXEL_SIZE, width2*PIXEL_SIZE);
+	}
+	if(page.dirty.width == 0) {
+		page.dirty = rect;
 	} else {
-		freeSpace.push_back(newRect(bestRect.left + width2, bestRect.bottom, bestRect.width - width2, bestRect.height));
-		freeSpace.push_back(newRect(bestRect.left, bestRect.bottom + height2, width2, bestRect.height - height2));
+		int left = std::min(page.dirty.left, rect.left), bottom = std::min(page.dirty.bottom, rect.bottom);
+		page.dirty = newRect(left, bottom,
+			std::max(page.dirty.right, rect.right) - left, std::max(page.dirty.top, rect.top) - bottom);
 	}
+	page.lastUsed = frameNo;
 	
-	Rect texture = newRect(bestRect.left + 1, bestRect.bottom + 1, width, height);
-	textures.push_back(texture);
-	
-	glTexSubImage2D(GL_TEXTURE_2D, 0, texture.left, texture.bottom, texture.width, texture.height, format, GL_UNSIGNED_BYTE, data);
-	checkGlErrors("rendering to glyph atlas");
-	
-	return textures.size() - 1;
+	return Entry { rect, pageIdx, page.generation };
+}
+
+bool TextureAtlas::isValid(unsigned int textureId) {
+	const Entry& entry = textures[textureId];
+	return entry.generation == pages[entry.page].generation;
+}
+
+unsigned int TextureAtlas::getPage(unsigned int textureId) {
+	return textures[textureId].page;
 }
 
 float TextureAtlas::getL(unsigned int textureId) {
-	return (float) textures[textureId].left / width;
+	return (float) textures[textureId].rect.left / width;
 }
 
 float TextureAtlas::getR(unsigned int textureId) {
-	return (float) textures[textureId].right / width;
+	return (float) textures[textureId].rect.right / width;
 }
 
 float TextureAtlas::getB(unsigned int textureId) {
-	return (float) textures[textureId].bottom / height;
+	return (float) textures[textureId].rect.bottom / height;
 }
 
 float TextureAtlas::getT(unsigned int textureId) {
-	return (float) textures[textureId].top / height;
+	return (float) textures[textureId].rect.top / height;
+}
+
+void TextureAtlas::touchPages(uint32_t usedPages) {
+	for(size_t i = 0; i < pages.size(); ++i) {
+		if(usedPages & (1u << i)) pages[i].lastUsed = frameNo;
+	}
+}
+
+void TextureAtlas::endFrame() {
+	frameNo++;
+}
+
+uint64_t TextureAtlas::evictions() { return _evictions; }
+
+void TextureAtlas::flush() {
+	bool bound = false;
+	for(size_t i = 0; i < pages.size(); ++i) {
+		Page& page = pages[i];
+		if(page.dirty.width == 0) continue;
+		if(!bound) {
+			bind();
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+			bound = true;
+		}
+		const Rect& dirty = page.dirty;
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, dirty.left, dirty.bottom, i, dirty.width, dirty.height, 1,
+			format, GL_UNSIGNED_BYTE, &page.pixels[(dirty.bottom*width + dirty.left) * PIXEL_SIZE]);
+		page.dirty = newRect(0, 0, 0, 0);
+	}
+	if(bound) {
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		checkGlErrors("uploading texture atlas");
+	}
 }
 
 void TextureAtlas::bind() {
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
-}
\ No newline at end of file
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+}
+
+int TextureAtlas::findPlace(Page& page, int boxWidth, int boxHeight, int& x, int& y) {
+	// Bottom-left rule: the lowest top, then the leftmost
+	int bestNode = -1;
+	int bestTop = height + 1;
+	for(size_t i = 0; i < page.skyline.size(); ++i) {
+		int left = page.skyline[i].x;
+		if(left + boxWidth > width) break;
+		int bottom = 0;
+		int remaining = boxWidth;
+		for(size_t j = i; remaining > 0; ++j) {
+			bottom = std::max(bottom, page.skyline[j].y);
+			remaining -= page.skyline[j].width;
+		}
+		if(bottom + boxHeight <= height && bottom + boxHeight < bestTop) {
+			bestNode = i;
+			bestTop = bottom + boxHeight;
+			x = left;
+			y = bottom;
+		}
+	}
+	return bestNode;
+}
+
+void TextureAtlas::clearPage(Page& page) {
+	page.skyline.assign(1, SkylineNode { 0, 0, width });
+	page.pixels.assign(width * height * PIXEL_SIZE, 0);
+	page.dirty = newRect(0, 0, width, height);
+	page.lastUsed = 0;
+	page.generation++;
+}
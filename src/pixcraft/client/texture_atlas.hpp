@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 
 #include "glfw.hpp"
 
@@ -9,25 +10,61 @@ namespace PixCraft {
 		int left, right, bottom, top, width, height;
 	};
 	
+	// Two-channel textures packed into the layers ("pages") of an array texture, with a skyline packer per page.
+	// Textures are first written to a copy of the pages in memory; flush uploads them, in one call per modified page.
+	// When no page has room left, the least recently used one is cleared, and the textures it held become invalid.
 	class TextureAtlas {
 	public:
-		void init(int width, int height);
+		void init(int width, int height, int pageCount);
 		
-		unsigned int addTexture(int width, int height, void* data);
-		//void overlay(unsigned int textureId, int overlayWidth, int overlayHeight, void* data);
+		unsigned int addTexture(int width, int height, const void* data);
+		// Packs new contents for a texture, usually one that became invalid, under the same id, so that ids don't pile up
+		void replaceTexture(unsigned int textureId, int width, int height, const void* data);
+		bool isValid(unsigned int textureId); // false once its page was cleared
 		
+		unsigned int getPage(unsigned int textureId);
 		float getL(unsigned int textureId);
 		float getR(unsigned int textureId);
 		float getT(unsigned int textureId);
 		float getB(unsigned int textureId);
 		
-		void bind();
+		// Pages are given as a bitmask; pages used during the current frame are never cleared
+		void touchPages(uint32_t pages);
+		void endFrame();
+		uint64_t evictions(); // how many times a page was cleared
 		
+		void flush();
+		void bind();
+	
 	private:
+		struct SkylineNode {
+			int x, y, width;
+		};
+		
+		struct Page {
+			std::vector<SkylineNode> skyline; // from left to right, covering the whole width
+			std::vector<uint8_t> pixels;
+			Rect dirty; // empty if nothing is waiting for flush
+			uint64_t lastUsed; // frame
+			uint64_t generation; // cleared pages start a new one
+		};
+		
+		struct Entry {
+			Rect rect;
+			unsigned int page;
+			uint64_t generation;
+		};
+		
 		GlId texture;
 		int width, height;
+		std::vector<Page> pages;
+		std::vector<Entry> textures;
+		uint64_t frameNo;
+		uint64_t _evictions;
 		
-		std::vector<Rect> freeSpace;
-		std::vector<Rect> textures;
+		Entry packTexture(int width, int height, const void* data);
+		// Finds the lowest place for a box, and returns its skyline node, or -1 if the page is full
+		int findPlace(Page& page, int width, int height, int& x, int& y);
+		void clearPage(Page& page);
 	};
 }
@@ -3,98 +3,253 @@
 #include <vector>
 #include <string>
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
 
 #include <iostream>
 
 #include <stb_image.h>
 #include "glfw.hpp"
 #include "../util/glm.hpp"
+#include "pixcraft/util/mapped_file.hpp"
+#include "pixcraft/util/wyhash.h"
 
 namespace PixCraft::TextureManager {
 	namespace {
-		std::vector<std::string> blockTextureFiles;
+		std::vector<std::string> blockTextureFiles(BLOCK_TEXTURE_NAMES, BLOCK_TEXTURE_NAMES + BLOCK_TEXTURE_COUNT);
 		GlId blockTextureArray;
 		
 		std::vector<std::string> otherTextureFiles;
 		std::vector<GlId> otherTextures;
 		std::vector<glm::uvec2> otherTextureDim;
 		
-		TexId requireBlockTexture(const char* filename) {
-			blockTextureFiles.push_back(std::string(filename));
-			return blockTextureFiles.size() - 1;
-		}
-		
 		TexId requireTexture(const char* filename) {
 			otherTextureFiles.push_back(std::string(filename));
 			return otherTextureFiles.size() - 1;
 		}
+		
+		// Decoded textures are baked into this file, with their mipmaps, and read back as long as the PNGs don't change.
+		// Layout: the header, the width and height of each other texture, then the pixels (RGBA, bottom row first)
+		// of the block texture array, level by level with all its layers, then of each other texture, level by level.
+		const char* CACHE_PATH = "data/textures.bin";
+		const uint32_t CACHE_MAGIC = 0x43545850; // "PXTC"
+		const uint32_t CACHE_VERSION = 1;
+		
+		struct CacheHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t sourceHash;
+			uint32_t blockLayers;
+			uint32_t blockSize;
+			uint32_t otherCount;
+			uint32_t padding;
+		};
+		
+		struct Image {
+			int width, height;
+			std::vector<uint8_t> pixels; // RGBA
+		};
+		
+		int levelCount(int width, int height) {
+			int levels = 1;
+			while(std::max(width, height) >> levels) ++levels;
+			return levels;
+		}
+		
+		int levelSize(int size, int level) {
+			return std::max(1, size >> level);
+		}
+		
+		size_t mipChainSize(int width, int height, int layers) {
+			size_t size = 0;
+			for(int level = 0; level < levelCount(width, height); ++level) {
+				size += (size_t) levelSize(width, level) * levelSize(height, level) * layers * 4;
+			}
+			return size;
+		}
+		
+		// Names, sizes and modification times of the PNGs; the cache is stale when any of them changes
+		uint64_t hashSources(const std::vector<std::string>& paths) {
+			uint64_t hash = CACHE_VERSION;
+			for(const std::string& path : paths) {
+				std::error_code error; // missing files fail later, when decoded
+				uint64_t size = std::filesystem::file_size(path, error);
+				uint64_t modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+				hash = wyhash(path.data(), path.size(), hash);
+				hash = wyhash64(hash, wyhash64(size, modified));
+			}
+			return hash;
+		}
+		
+		// Box filter, clamped at the edges of odd sizes
+		Image downsample(const Image& src) {
+			Image dst { levelSize(src.width, 1), levelSize(src.height, 1), {} };
+			dst.pixels.resize(dst.width * dst.height * 4);
+			for(int y = 0; y < dst.height; ++y) {
+				int y0 = std::min(2*y, src.height - 1), y1 = std::min(2*y + 1, src.height - 1);
+				for(int x = 0; x < dst.width; ++x) {
+					int x0 = std::min(2*x, src.width - 1), x1 = std::min(2*x + 1, src.width - 1);
+					for(int c = 0; c < 4; ++c) {
+						int sum = src.pixels[(y0*src.width + x0)*4 + c] + src.pixels[(y0*src.width + x1)*4 + c]
+							+ src.pixels[(y1*src.width + x0)*4 + c] + src.pixels[(y1*src.width + x1)*4 + c];
+						dst.pixels[(y*dst.width + x)*4 + c] = (sum + 2) / 4;
+					}
+				}
+			}
+			return dst;
+		}
+		
+		std::vector<Image> decodeMipChain(const std::string& path) {
+			int width, height, nrChannels;
+			unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
+			if(!data) throw std::runtime_error("Failed to load texture " + path);
+			std::vector<Image> levels;
+			levels.push_back(Image { width, height, std::vector<uint8_t>(data, data + width*height*4) });
+			stbi_image_free(data);
+			while((int) levels.size() < levelCount(width, height)) {
+				levels.push_back(downsample(levels.back()));
+			}
+			return levels;
+		}
+		
+		// Decodes the PNGs on all cores, and lays them out like the cache file
+		std::vector<uint8_t> bakeTextures(const std::vector<std::string>& paths, uint64_t sourceHash) {
+			stbi_set_flip_vertically_on_load(true); // before the threads start, as it is global
+			std::vector<std::vector<Image>> images(paths.size());
+			std::atomic<size_t> next(0);
+			auto decode = [&]() {
+				size_t i;
+				while((i = next++) < paths.size()) images[i] = decodeMipChain(paths[i]);
+			};
+			unsigned threadCount = std::max<unsigned>(1, std::min<size_t>(std::thread::hardware_concurrency(), paths.size()));
+			std::vector<std::future<void>> threads;
+			for(unsigned t = 1; t < threadCount; ++t) {
+				threads.push_back(std::async(std::launch::async, decode));
+			}
+			decode();
+			for(std::future<void>& thread : threads) thread.get(); // rethrows their errors
+			
+			size_t blockCount = blockTextureFiles.size();
+			for(size_t i = 0; i < blockCount; ++i) {
+				if(images[i][0].width != BLOCK_TEX_SIZE || images[i][0].height != BLOCK_TEX_SIZE)
+					throw std::runtime_error("Block texture has incorrect dimensions");
+			}
+			
+			CacheHeader header { CACHE_MAGIC, CACHE_VERSION, sourceHash,
+				(uint32_t) blockCount, BLOCK_TEX_SIZE, (uint32_t) otherTextureFiles.size(), 0 };
+			std::vector<uint8_t> baked(reinterpret_cast<uint8_t*>(&header), reinterpret_cast<uint8_t*>(&header + 1));
+			for(size_t i = blockCount; i < images.size(); ++i) {
+				uint32_t dim[2] = { (uint32_t) images[i][0].width, (uint32_t) images[i][0].height };
+				baked.insert(baked.end(), reinterpret_cast<uint8_t*>(dim), reinterpret_cast<uint8_t*>(dim + 2));
+			}
+			for(int level = 0; level < levelCount(BLOCK_TEX_SIZE, BLOCK_TEX_SIZE); ++level) {
+				for(size_t i = 0; i < blockCount; ++i) {
+					baked.insert(baked.end(), images[i][level].pixels.begin(), images[i][level].pixels.end());
+				}
+			}
+			for(size_t i = blockCount; i < images.size(); ++i) {
+				for(const Image& level : images[i]) {
+					baked.insert(baked.end(), level.pixels.begin(), level.pixels.end());
+				}
+			}
+			return baked;
+		}
+		
+		bool isValidCache(const uint8_t* data, size_t size, uint64_t sourceHash) {
+			CacheHeader header;
+			if(size < sizeof(header)) return false;
+			std::memcpy(&header, data, sizeof(header));
+			if(header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.sourceHash != sourceHash
+				|| header.blockLayers != blockTextureFiles.size() || header.blockSize != BLOCK_TEX_SIZE
+				|| header.otherCount != otherTextureFiles.size())
+				return false;
+			
+			size_t expectedSize = sizeof(header) + header.otherCount * 2 * sizeof(uint32_t);
+			if(size < expectedSize) return false;
+			std::vector<uint32_t> dims(header.otherCount * 2);
+			std::memcpy(dims.data(), data + sizeof(header), dims.size() * sizeof(uint32_t));
+			expectedSize += mipChainSize(BLOCK_TEX_SIZE, BLOCK_TEX_SIZE, header.blockLayers);
+			for(size_t i = 0; i < header.otherCount; ++i) {
+				if(dims[2*i] == 0 || dims[2*i+1] == 0) return false;
+				expectedSize += mipChainSize(dims[2*i], dims[2*i+1], 1);
+			}
+			return size == expectedSize;
+		}
+		
+		// All the levels are given, so each one is uploaded as is, with a single call for all the block textures
+		void uploadTextures(const uint8_t* data) {
+			CacheHeader header;
+			std::memcpy(&header, data, sizeof(header));
+			std::vector<uint32_t> dims(header.otherCount * 2);
+			std::memcpy(dims.data(), data + sizeof(header), dims.size() * sizeof(uint32_t));
+			const uint8_t* pixels = data + sizeof(header) + dims.size() * sizeof(uint32_t);
+			
+			glGenTextures(1, &blockTextureArray);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, blockTextureArray);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			for(int level = 0; level < levelCount(BLOCK_TEX_SIZE, BLOCK_TEX_SIZE); ++level) {
+				int size = levelSize(BLOCK_TEX_SIZE, level);
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, size, size, header.blockLayers, 0,
+					GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+				pixels += size * size * header.blockLayers * 4;
+			}
+			
+			otherTextures.assign(header.otherCount, 0);
+			glGenTextures(otherTextures.size(), otherTextures.data());
+			otherTextureDim.clear();
+			for(unsigned int i = 0; i < header.otherCount; ++i) {
+				int width = dims[2*i], height = dims[2*i+1];
+				glBindTexture(GL_TEXTURE_2D, otherTextures[i]);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				for(int level = 0; level < levelCount(width, height); ++level) {
+					int levelWidth = levelSize(width, level), levelHeight = levelSize(height, level);
+					glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, levelWidth, levelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+					pixels += levelWidth * levelHeight * 4;
+				}
+				otherTextureDim.emplace_back(width, height);
+			}
+		}
 	}
 	
-	const TexId PLACEHOLDER = requireBlockTexture("placeholder");
-	const TexId STONE = requireBlockTexture("stone");
-	const TexId DIRT = requireBlockTexture("dirt");
-	const TexId GRASS_SIDE = requireBlockTexture("grass_side");
-	const TexId GRASS_TOP = requireBlockTexture("grass_top");
-	const TexId TRUNK_SIDE = requireBlockTexture("trunk_side");
-	const TexId TRUNK_INSIDE = requireBlockTexture("trunk_inside");
-	const TexId LEAVES = requireBlockTexture("leaves");
-	const TexId WATER = requireBlockTexture("water");
-	const TexId PLANKS = requireBlockTexture("planks");
-	
 	const TexId SLIME = requireTexture("entity/slime");
 	
 	const TexId LOGO = requireTexture("gui/logo");
 	const TexId BUTTON = requireTexture("gui/button");
 	
 	void loadTextures() {
-		glGenTextures(1, &blockTextureArray);
-		glBindTexture(GL_TEXTURE_2D_ARRAY, blockTextureArray);
-		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, BLOCK_TEX_SIZE, BLOCK_TEX_SIZE,
-			blockTextureFiles.size(), 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		
-		int width, height, nrChannels;
-		stbi_set_flip_vertically_on_load(true);
-		
-		for(unsigned int i = 0; i < blockTextureFiles.size(); ++i) {
-			std::string filename = "res/block/" + blockTextureFiles[i] + ".png";
-			unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
-			if(!data) throw std::runtime_error("Failed to load block texture");
-			if(width != BLOCK_TEX_SIZE || height != BLOCK_TEX_SIZE) throw std::runtime_error("Block texture has incorrect dimensions");
-			if(nrChannels == 3)
-				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, BLOCK_TEX_SIZE, BLOCK_TEX_SIZE, 1, GL_RGB, GL_UNSIGNED_BYTE, data);
-			else if(nrChannels == 4)
-				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, BLOCK_TEX_SIZE, BLOCK_TEX_SIZE, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			stbi_image_free(data);
-		}
-		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		std::vector<std::string> paths;
+		for(const std::string& name : blockTextureFiles) paths.push_back("res/block/" + name + ".png");
+		for(const std::string& name : otherTextureFiles) paths.push_back("res/" + name + ".png");
+		uint64_t sourceHash = hashSources(paths);
 		
-		otherTextures.assign(otherTextureFiles.size(), 0);
-		glGenTextures(otherTextureFiles.size(), otherTextures.data());
+		MappedFile cache;
+		try {
+			cache.open(CACHE_PATH);
+		} catch(std::runtime_error&) { } // not baked yet
 		
-		for(unsigned int i = 0; i < otherTextureFiles.size(); ++i) {
-			std::string filename = "res/" + otherTextureFiles[i] + ".png";
-			unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
-			if(!data) throw std::runtime_error("Failed to load texture");
-			
-			glBindTexture(GL_TEXTURE_2D, otherTextures[i]);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			
-			if(nrChannels == 3)
-				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-			else if(nrChannels == 4)
-				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
-			
-			stbi_image_free(data);
-			
-			otherTextureDim.emplace_back(width, height);
+		if(cache.isOpen() && isValidCache(cache.data(), cache.size(), sourceHash)) {
+			uploadTextures(cache.data());
+		} else {
+			std::vector<uint8_t> baked = bakeTextures(paths, sourceHash);
+			uploadTextures(baked.data());
+			cache.close(); // before overwriting it
+			std::error_code error;
+			std::filesystem::create_directories(std::filesystem::path(CACHE_PATH).parent_path(), error);
+			std::ofstream file(CACHE_PATH, std::ios::binary);
+			file.write(reinterpret_cast<const char*>(baked.data()), baked.size());
+			file.close();
+			if(!file) std::cout << "Can't write texture cache " << CACHE_PATH << std::endl;
 		}
 		checkGlErrors("texture loading");
 	}
@@ -2,11 +2,9 @@
 
 #include <cstdint>
 
+#include "pixcraft/server/block_textures.hpp"
+
 namespace PixCraft {
-	typedef uint32_t TexId;
-	
-	#define TEX(name) (TextureManager::name)
-	
 	namespace TextureManager {
 		void loadTextures();
 		void bindBlockTextureArray();
@@ -16,19 +14,7 @@ namespace PixCraft {
 		
 		const unsigned int BLOCK_TEX_SIZE = 16;
 		
-		// Block textures
-		extern const TexId PLACEHOLDER;
-		extern const TexId STONE;
-		extern const TexId DIRT;
-		extern const TexId GRASS_SIDE;
-		extern const TexId GRASS_TOP;
-		extern const TexId TRUNK_SIDE;
-		extern const TexId TRUNK_INSIDE;
-		extern const TexId LEAVES;
-		extern const TexId WATER;
-		extern const TexId PLANKS;
-		
-		// Other textures
+		// Other textures; block textures are in pixcraft/server/block_textures.hpp
 		extern const TexId SLIME;
 		
 		extern const TexId LOGO;
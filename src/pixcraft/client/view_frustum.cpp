@@ -3,6 +3,7 @@
 #include <cmath>
 
 #include "pixcraft/server/world_module.hpp"
+#include "pixcraft/server/chunk.hpp"
 #include "pixcraft/util/util.hpp"
 
 using namespace PixCraft;
@@ -56,4 +57,16 @@ bool PixCraft::isVisible(ViewFrustum& vf, int32_t chunkX, int32_t chunkZ) {
 	if(glm::dot(glm::vec4(nPoint, 1.0f), vf.near.plane) > 0) return false;
 	
 	return true;
-}
\ No newline at end of file
+}
+
+bool PixCraft::isSectionVisible(ViewFrustum& vf, int32_t chunkX, int section, int32_t chunkZ) {
+	// The precomputed n-vertices span the whole chunk height, so they are recomputed for the section
+	glm::vec3 corner(CHUNK_SIZE*chunkX - 0.5, CHUNK_SECTION_HEIGHT*section - 0.5, CHUNK_SIZE*chunkZ - 0.5);
+	glm::vec3 size(CHUNK_SIZE, CHUNK_SECTION_HEIGHT, CHUNK_SIZE);
+	for(const ViewPlane* viewPlane : { &vf.left, &vf.right, &vf.bottom, &vf.top, &vf.far, &vf.near }) {
+		const glm::vec4& plane = viewPlane->plane;
+		glm::vec3 nPoint = corner + size * glm::vec3(plane.x < 0, plane.y < 0, plane.z < 0);
+		if(glm::dot(glm::vec4(nPoint, 1.0f), plane) > 0) return false;
+	}
+	return true;
+}
@@ -24,4 +24,5 @@ namespace PixCraft {
 	ViewFrustum computeViewFrustum(float fovy, float screenRatio, float near, float far, glm::vec3 pos, glm::vec3 orient);
 	
 	bool isVisible(ViewFrustum& vf, int32_t chunkX, int32_t chunkZ);
+	bool isSectionVisible(ViewFrustum& vf, int32_t chunkX, int section, int32_t chunkZ);
 }
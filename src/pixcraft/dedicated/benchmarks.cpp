@@ -0,0 +1,205 @@
+#include "benchmarks.hpp"
+
+#include <iostream>
+#include <functional>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+
+#include "pixcraft/server/blocks.hpp"
+#include "pixcraft/server/chunk.hpp"
+#include "pixcraft/server/mob.hpp"
+#include "pixcraft/server/world.hpp"
+#include "pixcraft/server/worldgen.hpp"
+#include "pixcraft/client/face_data.hpp"
+#include "pixcraft/util/profiler.hpp"
+#include "pixcraft/util/mpsc_queue.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	const int GEN_RADIUS = 12; // generates a 24x24 square of chunks
+	const int SAVE_RADIUS = 32;
+	const int FILL_SIZE = 64;
+	const int QUEUE_PRODUCERS = 4;
+	const uint32_t QUEUE_PUSHES = 1000000; // per producer
+	
+	// Returns the throughput in chunks/s
+	float timeGeneration(std::function<void(Chunk&, int32_t, int32_t)> generate) {
+		int64_t start = Profiler::now();
+		int count = 0;
+		for(int32_t x = -GEN_RADIUS; x < GEN_RADIUS; ++x) {
+			for(int32_t z = -GEN_RADIUS; z < GEN_RADIUS; ++z) {
+				Chunk chunk;
+				generate(chunk, x, z);
+				count++;
+			}
+		}
+		return count / ((Profiler::now() - start) / 1000000.0f);
+	}
+	
+	void benchGeneration(uint64_t seed) {
+		WorldGenerator gen(seed);
+		float heightmap = timeGeneration([&](Chunk& chunk, int32_t x, int32_t z) { gen.generateHeightmapChunk(chunk, x, z); });
+		float density = timeGeneration([&](Chunk& chunk, int32_t x, int32_t z) { gen.generateChunk(chunk, x, z); });
+		std::cout << "Heightmap terrain: " << heightmap << " chunks/s" << std::endl;
+		std::cout << "Density terrain:   " << density << " chunks/s (" << density / heightmap << "x)" << std::endl;
+	}
+	
+	void benchSaving(uint64_t seed) {
+		WorldGenerator gen(seed);
+		flatbuffers::FlatBufferBuilder builder;
+		std::vector<flatbuffers::Offset<Serializer::Chunk>> chunkOffsets;
+		int64_t encodeTime = 0;
+		for(int32_t x = -SAVE_RADIUS; x < SAVE_RADIUS; ++x) {
+			for(int32_t z = -SAVE_RADIUS; z < SAVE_RADIUS; ++z) {
+				Chunk chunk;
+				gen.generateChunk(chunk, x, z);
+				int64_t start = Profiler::now();
+				chunkOffsets.push_back(chunk.serialize(x, z, builder));
+				encodeTime += Profiler::now() - start;
+			}
+		}
+		auto chunkVector = builder.CreateVector(chunkOffsets);
+		builder.Finish(Serializer::CreateWorld(builder, chunkVector));
+		
+		int64_t start = Profiler::now();
+		for(const Serializer::Chunk* chunkData : *Serializer::GetWorld(builder.GetBufferPointer())->chunks()) {
+			Chunk chunk;
+			chunk.unserialize(chunkData);
+		}
+		int64_t decodeTime = Profiler::now() - start;
+		
+		// Throughputs are relative to the raw blocks, which is what saves used to contain
+		float rawSize = chunkOffsets.size() * CHUNK_BLOCKS * sizeof(BlockId) / 1048576.0f;
+		float size = builder.GetSize() / 1048576.0f;
+		std::cout << chunkOffsets.size() << " chunks: " << size << " MiB saved, against " << rawSize << " MiB of raw blocks ("
+			<< rawSize / size << "x smaller)" << std::endl;
+		std::cout << "Encoding: " << rawSize / (encodeTime / 1000000.0f) << " MiB/s" << std::endl;
+		std::cout << "Decoding: " << rawSize / (decodeTime / 1000000.0f) << " MiB/s" << std::endl;
+	}
+	
+	void benchFilling(uint64_t seed) {
+		World world(seed);
+		for(int32_t x = 0; x < FILL_SIZE / CHUNK_SIZE; ++x) {
+			for(int32_t z = 0; z < FILL_SIZE / CHUNK_SIZE; ++z) {
+				world.genChunk(x, z);
+			}
+		}
+		BlockRegion region(0, 0, 0, FILL_SIZE - 1, FILL_SIZE - 1, FILL_SIZE - 1);
+		float blockCount = region.sizeX() * region.sizeY() * region.sizeZ();
+		
+		int64_t start = Profiler::now();
+		world.fill(region, BlockRegistry::STONE_ID);
+		world.fill(region, 0);
+		float bulk = 2 * blockCount / ((Profiler::now() - start) / 1000000.0f);
+		
+		Block& planks = Block::fromId(BlockRegistry::PLANKS_ID);
+		start = Profiler::now();
+		for(int32_t y = region.y1; y <= region.y2; ++y) {
+			for(int32_t z = region.z1; z <= region.z2; ++z) {
+				for(int32_t x = region.x1; x <= region.x2; ++x) {
+					world.setBlock(x, y, z, planks);
+				}
+			}
+		}
+		float single = blockCount / ((Profiler::now() - start) / 1000000.0f);
+		
+		std::cout << "Bulk fill:  " << bulk / 1000000.0f << "M blocks/s (" << bulk / single << "x faster)" << std::endl;
+		std::cout << "One by one: " << single / 1000000.0f << "M blocks/s" << std::endl;
+	}
+	
+	void benchQueue() {
+		// Each element is a producer index and a sequence number, which must come out in order for each producer
+		MpscQueue<std::pair<int, uint32_t>> queue;
+		std::atomic<int> running(QUEUE_PRODUCERS);
+		std::vector<std::thread> producers;
+		int64_t start = Profiler::now();
+		for(int p = 0; p < QUEUE_PRODUCERS; ++p) {
+			producers.emplace_back([&queue, &running, p]() {
+				for(uint32_t i = 0; i < QUEUE_PUSHES; ++i) queue.push(std::make_pair(p, i));
+				running--;
+			});
+		}
+		
+		std::vector<uint32_t> expected(QUEUE_PRODUCERS, 0);
+		std::vector<std::pair<int, uint32_t>> popped;
+		size_t pops = 0;
+		while(true) {
+			bool done = running == 0; // read before popping, so that the last pushes are not missed
+			popped.clear();
+			queue.popAll(popped);
+			if(!popped.empty()) pops++;
+			for(auto& element : popped) {
+				if(element.second != expected[element.first]++)
+					throw std::runtime_error("Edit queue lost, duplicated or reordered an element");
+			}
+			if(done) break;
+		}
+		float elapsed = (Profiler::now() - start) / 1000000.0f;
+		for(std::thread& producer : producers) producer.join();
+		for(uint32_t count : expected) {
+			if(count != QUEUE_PUSHES) throw std::runtime_error("Edit queue lost an element");
+		}
+		
+		float total = (float) QUEUE_PRODUCERS * QUEUE_PUSHES;
+		std::cout << QUEUE_PRODUCERS << " producers: " << total / elapsed / 1000000.0f << "M pushes/s, "
+			<< total / pops << " elements per pop on average" << std::endl;
+		std::cout << "All elements received once, in order" << std::endl;
+	}
+	
+	bool packingThrows(uint32_t x, uint32_t y, uint32_t z, uint32_t side, TexId texId) {
+		try {
+			FaceData face(x, y, z, side, texId);
+			return face.texId() != texId; // unreachable
+		} catch(std::out_of_range&) {
+			return true;
+		}
+	}
+	
+	void benchFaceData() {
+		// Every combination of fields must come back out unchanged
+		int64_t start = Profiler::now();
+		uint64_t packed = 0;
+		for(uint32_t texId = 0; texId <= FaceData::MAX_TEXTURE; ++texId) {
+			for(uint32_t side = 0; side <= FaceData::MAX_SIDE; ++side) {
+				for(uint32_t y = 0; y <= FaceData::MAX_Y; ++y) {
+					for(uint32_t z = 0; z <= FaceData::MAX_Z; ++z) {
+						for(uint32_t x = 0; x <= FaceData::MAX_X; ++x) {
+							FaceData face(x, y, z, side, texId);
+							if(face.offsetX() != x || face.offsetY() != y || face.offsetZ() != z || face.side() != side || face.texId() != texId)
+								throw std::runtime_error("Face data doesn't round trip");
+							packed++;
+						}
+					}
+				}
+			}
+		}
+		float elapsed = (Profiler::now() - start) / 1000000.0f;
+		
+		// Each field just past its range, or with high bits that truncation would drop, is rejected alone
+		const uint32_t max[5] = { FaceData::MAX_X, FaceData::MAX_Y, FaceData::MAX_Z, FaceData::MAX_SIDE, FaceData::MAX_TEXTURE };
+		for(int field = 0; field < 5; ++field) {
+			for(uint32_t value : { max[field] + 1, (max[field] + 1) * 2 + 1, UINT32_MAX }) {
+				uint32_t fields[5] = { 0, 0, 0, 0, 0 };
+				fields[field] = value;
+				if(!packingThrows(fields[0], fields[1], fields[2], fields[3], fields[4]))
+					throw std::runtime_error("Out of range face data was packed");
+			}
+		}
+		
+		std::cout << packed << " faces packed and unpacked: " << packed / elapsed / 1000000.0f << "M faces/s" << std::endl;
+		std::cout << "All fields round trip, out of range fields are rejected" << std::endl;
+	}
+}
+
+bool PixCraft::runBenchmark(std::string name, uint64_t seed) {
+	if(name == "gen") benchGeneration(seed);
+	else if(name == "save") benchSaving(seed);
+	else if(name == "fill") benchFilling(seed);
+	else if(name == "queue") benchQueue();
+	else if(name == "facedata") benchFaceData();
+	else return false;
+	return true;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace PixCraft {
+	// Runs a named microbenchmark and prints its results; returns false if there is no such benchmark.
+	// - gen: chunk generation throughput, of the density terrain against the previous heightmap terrain
+	// - save: size and speed of the chunk encoding in saves, on a generated world
+	// - fill: bulk edits of a 64x64x64 region, against setting the blocks one by one
+	// - queue: throughput of the edit queue under contention; throws if an element is lost, duplicated or reordered
+	// - facedata: packs and unpacks every face the renderer can draw; throws if one doesn't round trip or if an out of range one is packed
+	bool runBenchmark(std::string name, uint64_t seed);
+}
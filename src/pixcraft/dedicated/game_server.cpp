@@ -0,0 +1,333 @@
+#include "game_server.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "pixcraft/server/blocks.hpp"
+#include "pixcraft/server/player.hpp"
+#include "pixcraft/server/slime.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	bool isFinite(glm::vec3 v) {
+		return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+	}
+	
+	bool sameState(const Network::MobState& a, const Network::MobState& b) {
+		return a.pos().x() == b.pos().x() && a.pos().y() == b.pos().y() && a.pos().z() == b.pos().z()
+			&& a.orient().x() == b.orient().x() && a.orient().y() == b.orient().y() && a.orient().z() == b.orient().z();
+	}
+}
+
+GameServer::GameServer(uint16_t port, uint64_t seed)
+	: world(seed), simulation(world), listener(Socket::listen(port)), nextMobId(1), generations(0),
+	  _clientCount(0), _bytesSent(0) {
+	for(int32_t dx = -MAX_VIEW_DISTANCE; dx <= MAX_VIEW_DISTANCE; ++dx) {
+		for(int32_t dz = -MAX_VIEW_DISTANCE; dz <= MAX_VIEW_DISTANCE; ++dz) {
+			if(dx*dx + dz*dz <= MAX_VIEW_DISTANCE*MAX_VIEW_DISTANCE)
+				chunkOffsets.emplace_back(dx, dz);
+		}
+	}
+	std::sort(chunkOffsets.begin(), chunkOffsets.end(), [](std::pair<int32_t, int32_t> a, std::pair<int32_t, int32_t> b) {
+		return a.first*a.first + a.second*a.second < b.first*b.first + b.second*b.second;
+	});
+
+	for(int i = 0; i < 4; ++i) {
+		world.mobs.emplace_back(new Slime(world, spawnPos(3*i, 0)));
+	}
+
+	simulation.setCallbacks([this](float) { preTick(); }, [this]() { postTick(); });
+}
+
+GameServer::~GameServer() {
+	stop();
+}
+
+void GameServer::start() {
+	simulation.start(false);
+}
+
+void GameServer::stop() {
+	simulation.stop();
+}
+
+size_t GameServer::clientCount() { return _clientCount; }
+uint64_t GameServer::bytesSent() { return _bytesSent; }
+uint64_t GameServer::tickNo() { return simulation.tickNo(); }
+
+void GameServer::preTick() {
+	acceptClients();
+	for(auto& client : clients) {
+		receiveMessages(*client);
+	}
+}
+
+void GameServer::postTick() {
+	generations = 0;
+	sendBlockChanges();
+	for(auto& client : clients) {
+		if(!client->player) continue;
+		sendMobUpdates(*client);
+		updateInterest(*client);
+	}
+	// The chunks generated for the clients were sent whole already
+	world.retrieveDirtyChunks();
+
+	if(simulation.tickNo() % UNLOAD_INTERVAL == 0)
+		unloadUnusedChunks();
+
+	for(auto& client : clients) {
+		uint64_t sentBefore = client->connection.bytesSent();
+		client->connection.flush();
+		_bytesSent += client->connection.bytesSent() - sentBefore;
+		// Updates other than new chunks are always queued, so the backlog is bounded here
+		if(client->connection.queuedBytes() > MAX_BACKLOG_BYTES) client->connection.close();
+	}
+	for(auto it = clients.begin(); it != clients.end();) {
+		if((*it)->connection.isOpen()) {
+			++it;
+		} else {
+			disconnect(**it);
+			it = clients.erase(it);
+		}
+	}
+	_clientCount = clients.size();
+}
+
+void GameServer::acceptClients() {
+	while(true) {
+		Socket socket = listener.accept();
+		if(!socket.isValid()) break;
+		clients.emplace_back(new ClientSession{Connection(std::move(socket)), 0, nullptr, 0, 0, {}, {}});
+	}
+}
+
+void GameServer::receiveMessages(ClientSession& client) {
+	std::vector<uint8_t> data;
+	while(client.connection.receive(data)) {
+		const Network::Message* message = Protocol::parse(data);
+		if(!message) {
+			std::cout << "Received an invalid message, disconnecting client" << std::endl;
+			client.connection.close();
+			return;
+		}
+
+		flatbuffers::FlatBufferBuilder builder;
+		switch(message->payload_type()) {
+		case Network::Payload_ClientHello: {
+			client.viewDistance = std::min(std::max(message->payload_as_ClientHello()->view_distance(), 1), MAX_VIEW_DISTANCE);
+			if(client.player) break;
+			Player* player = new Player(world, spawnPos(8, 8));
+			player->movementMode(MovementMode::noClip);
+			world.mobs.emplace_back(player);
+			client.player = player;
+			client.playerId = getMobId(player);
+			client.lastMoveTick = simulation.tickNo();
+			Protocol::send(client.connection, builder, Network::Payload_ServerHello,
+				Network::CreateServerHello(builder, client.playerId, simulation.tickNo()));
+			break;
+		}
+		case Network::Payload_ClientPosition: {
+			auto position = message->payload_as_ClientPosition();
+			if(!client.player || !position->pos() || !position->orient()) break;
+			glm::vec3 pos(position->pos()->x(), position->pos()->y(), position->pos()->z());
+			glm::vec3 orient(position->orient()->x(), position->orient()->y(), position->orient()->z());
+			if(!isFinite(pos) || !isFinite(orient)) break;
+			// The position drives chunk loading, so the move is limited by the ticks since the last one
+			uint64_t ticks = std::min(simulation.tickNo() - client.lastMoveTick, MAX_MOVE_TICKS);
+			float maxMove = MAX_MOVE_PER_TICK * ticks;
+			glm::vec3 move = pos - client.player->pos();
+			float distance = glm::length(move);
+			if(distance > maxMove) move *= maxMove / distance;
+			client.player->pos(client.player->pos() + move);
+			client.player->orient(orient);
+			client.lastMoveTick = simulation.tickNo();
+			break;
+		}
+		case Network::Payload_BlockEdit: {
+			// Invalid edits are dropped when the queue is applied, later in this tick
+			auto edit = message->payload_as_BlockEdit();
+			world.queueEdit(edit->x(), edit->y(), edit->z(), static_cast<BlockId>(edit->block()));
+			break;
+		}
+		case Network::Payload_Ping: {
+			auto ping = message->payload_as_Ping();
+			Protocol::send(client.connection, builder, Network::Payload_Pong, Network::CreatePong(builder, ping->id(), ping->time()));
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+void GameServer::disconnect(ClientSession& client) {
+	client.connection.close();
+	if(!client.player) return;
+	mobIds.erase(client.player);
+	auto it = std::find_if(world.mobs.begin(), world.mobs.end(), [&](std::unique_ptr<Mob>& mob) { return mob.get() == client.player; });
+	if(it != world.mobs.end()) world.mobs.erase(it);
+	client.player = nullptr;
+}
+
+void GameServer::sendBlockChanges() {
+	BlockPosSet dirtyBlocks = world.retrieveDirtyBlocks();
+	std::unordered_set<uint64_t> dirtyChunks = world.retrieveDirtyChunks();
+
+	// Group the changed blocks per chunk
+	std::unordered_map<uint64_t, std::vector<Network::BlockDelta>> deltas;
+	for(const BlockPos& pos : dirtyBlocks) {
+		int32_t x, y, z;
+		std::tie(x, y, z) = pos;
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = World::getChunkPosAt(x, z);
+		uint64_t chunkIdx = packCoords(chunkX, chunkZ);
+		if(dirtyChunks.count(chunkIdx) || !world.isChunkLoaded(chunkX, chunkZ)) continue;
+		Block* block = world.getBlock(x, y, z);
+		BlockId id = block ? block->id() : 0;
+		uint32_t index = Protocol::blockIndex(x - chunkX*CHUNK_SIZE, y, z - chunkZ*CHUNK_SIZE);
+		deltas[chunkIdx].emplace_back(index, static_cast<Serializer::BlockType>(id));
+	}
+	for(auto& pair : deltas) {
+		if(pair.second.size() > MAX_DELTAS) dirtyChunks.insert(pair.first);
+	}
+
+	for(uint64_t chunkIdx : dirtyChunks) {
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = unpackCoords(chunkIdx);
+		if(!world.isChunkLoaded(chunkX, chunkZ)) continue;
+		for(auto& client : clients) {
+			if(client->sentChunks.count(chunkIdx)) sendChunk(*client, chunkX, chunkZ);
+		}
+	}
+	for(auto& pair : deltas) {
+		if(dirtyChunks.count(pair.first)) continue;
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = unpackCoords(pair.first);
+		// The message is built once, and copied to each interested connection
+		flatbuffers::FlatBufferBuilder builder;
+		Protocol::finish(builder, Network::Payload_BlockDeltas,
+			Network::CreateBlockDeltas(builder, chunkX, chunkZ, builder.CreateVectorOfStructs(pair.second)));
+		for(auto& client : clients) {
+			if(client->sentChunks.count(pair.first)) client->connection.send(builder);
+		}
+	}
+}
+
+void GameServer::sendChunk(ClientSession& client, int32_t chunkX, int32_t chunkZ) {
+	flatbuffers::FlatBufferBuilder builder;
+	auto chunkData = world.getChunk(chunkX, chunkZ).serialize(chunkX, chunkZ, builder);
+	Protocol::send(client.connection, builder, Network::Payload_ChunkData, Network::CreateChunkData(builder, chunkData));
+	client.sentChunks.insert(packCoords(chunkX, chunkZ));
+}
+
+void GameServer::updateInterest(ClientSession& client) {
+	glm::vec3 pos = client.player->pos();
+	int32_t camChunkX, camChunkZ;
+	std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(std::floor(pos.x), std::floor(pos.z));
+
+	// Chunks are only unloaded one chunk beyond the view distance, so that moving along a border doesn't resend them
+	int unloadDist = client.viewDistance + 1;
+	for(auto it = client.sentChunks.begin(); it != client.sentChunks.end();) {
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = unpackCoords(*it);
+		int32_t dx = chunkX - camChunkX, dz = chunkZ - camChunkZ;
+		if(dx*dx + dz*dz <= unloadDist*unloadDist) {
+			++it;
+			continue;
+		}
+		flatbuffers::FlatBufferBuilder builder;
+		Protocol::send(client.connection, builder, Network::Payload_ChunkUnload, Network::CreateChunkUnload(builder, chunkX, chunkZ));
+		it = client.sentChunks.erase(it);
+	}
+
+	if(client.connection.queuedBytes() > MAX_QUEUED_BYTES) return;
+	int sent = 0;
+	for(auto& offset : chunkOffsets) {
+		int32_t dx = offset.first, dz = offset.second;
+		if(dx*dx + dz*dz > client.viewDistance*client.viewDistance) break;
+		int32_t chunkX = camChunkX + dx, chunkZ = camChunkZ + dz;
+		if(client.sentChunks.count(packCoords(chunkX, chunkZ))) continue;
+		if(!world.isChunkLoaded(chunkX, chunkZ)) {
+			if(generations >= GENERATIONS_PER_TICK) break;
+			world.genChunk(chunkX, chunkZ);
+			generations++;
+		}
+		sendChunk(client, chunkX, chunkZ);
+		if(++sent >= CHUNKS_PER_TICK) break;
+	}
+}
+
+void GameServer::sendMobUpdates(ClientSession& client) {
+	glm::vec3 center = client.player->pos();
+	float maxDist = client.viewDistance * CHUNK_SIZE;
+
+	std::vector<Network::MobState> changed;
+	std::unordered_set<uint32_t> visible;
+	for(auto& mob : world.mobs) {
+		if(mob.get() == client.player) continue;
+		glm::vec3 pos = mob->pos();
+		if(glm::length(glm::vec2(pos.x - center.x, pos.z - center.z)) > maxDist) continue;
+
+		uint32_t id = getMobId(mob.get());
+		visible.insert(id);
+		glm::vec3 orient = mob->orient();
+		Network::MobState state(id, mob->serializedType(), Serializer::Vec3(pos.x, pos.y, pos.z), Serializer::Vec3(orient.x, orient.y, orient.z));
+		auto it = client.sentMobs.find(id);
+		if(it != client.sentMobs.end() && sameState(it->second, state)) continue;
+		client.sentMobs[id] = state;
+		changed.push_back(state);
+	}
+
+	std::vector<uint32_t> removed;
+	for(auto it = client.sentMobs.begin(); it != client.sentMobs.end();) {
+		if(visible.count(it->first)) {
+			++it;
+		} else {
+			removed.push_back(it->first);
+			it = client.sentMobs.erase(it);
+		}
+	}
+
+	if(changed.empty() && removed.empty()) return;
+	flatbuffers::FlatBufferBuilder builder;
+	Protocol::send(client.connection, builder, Network::Payload_MobUpdates,
+		Network::CreateMobUpdates(builder, simulation.tickNo(), builder.CreateVectorOfStructs(changed), builder.CreateVector(removed)));
+}
+
+void GameServer::unloadUnusedChunks() {
+	std::unordered_set<uint64_t> used;
+	for(auto& client : clients) {
+		for(uint64_t chunkIdx : client->sentChunks) used.insert(chunkIdx);
+	}
+	for(auto& mob : world.mobs) {
+		glm::vec3 pos = mob->pos();
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = World::getChunkPosAt(std::floor(pos.x), std::floor(pos.z));
+		used.insert(packCoords(chunkX, chunkZ));
+	}
+	for(uint64_t chunkIdx : world.getLoadedChunks()) {
+		// The server doesn't write saves, so the diffs of edited chunks only exist in memory: keep them loaded
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = unpackCoords(chunkIdx);
+		if(used.count(chunkIdx) || world.getChunk(chunkX, chunkZ).modified()) continue;
+		world.unloadChunk(chunkX, chunkZ);
+	}
+}
+
+glm::vec3 GameServer::spawnPos(int32_t x, int32_t z) {
+	int32_t chunkX, chunkZ;
+	std::tie(chunkX, chunkZ) = World::getChunkPosAt(x, z);
+	if(!world.isChunkLoaded(chunkX, chunkZ)) world.genChunk(chunkX, chunkZ);
+	return glm::vec3(x + 0.5f, world.getSurfaceHeight(x, z), z + 0.5f);
+}
+
+uint32_t GameServer::getMobId(const Mob* mob) {
+	auto it = mobIds.find(mob);
+	if(it != mobIds.end()) return it->second;
+	uint32_t id = nextMobId++;
+	mobIds[mob] = id;
+	return id;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "pixcraft/server/world.hpp"
+#include "pixcraft/server/simulation.hpp"
+#include "pixcraft/network/connection.hpp"
+#include "pixcraft/network/protocol.hpp"
+
+namespace PixCraft {
+	// Owns a World and streams it to the connected clients.
+	// Networking happens at the start and end of each simulation tick, with the world locked.
+	class GameServer {
+	public:
+		static const int MAX_VIEW_DISTANCE = 16;
+		static const int CHUNKS_PER_TICK = 2; // per client
+		static const int GENERATIONS_PER_TICK = 16;
+		static const size_t MAX_QUEUED_BYTES = 1 << 20; // don't stream new chunks to clients that can't keep up
+		static const size_t MAX_BACKLOG_BYTES = 16 << 20; // disconnect clients that stopped reading altogether
+		static const size_t MAX_DELTAS = 512; // beyond this many changed blocks, the whole chunk is resent
+		static const int UNLOAD_INTERVAL = 60; // in ticks
+		static constexpr float MAX_MOVE_PER_TICK = 1.0f; // twice the no-clip speed; clients can't teleport further
+		static constexpr uint64_t MAX_MOVE_TICKS = 20; // a client that stays silent doesn't build up a longer move
+		
+		GameServer(uint16_t port, uint64_t seed);
+		~GameServer();
+		
+		void start();
+		void stop();
+		
+		size_t clientCount();
+		uint64_t bytesSent();
+		uint64_t tickNo();
+	
+	private:
+		struct ClientSession {
+			Connection connection;
+			uint32_t playerId;
+			Player* player;
+			int viewDistance;
+			uint64_t lastMoveTick;
+			std::unordered_set<uint64_t> sentChunks;
+			std::unordered_map<uint32_t, Network::MobState> sentMobs;
+		};
+		
+		World world;
+		Simulation simulation;
+		Socket listener;
+		
+		std::vector<std::unique_ptr<ClientSession>> clients;
+		std::unordered_map<const Mob*, uint32_t> mobIds;
+		uint32_t nextMobId;
+		std::vector<std::pair<int32_t, int32_t>> chunkOffsets; // sorted by distance
+		int generations;
+		
+		std::atomic<size_t> _clientCount;
+		std::atomic<uint64_t> _bytesSent;
+		
+		void preTick();
+		void postTick();
+		
+		void acceptClients();
+		void receiveMessages(ClientSession& client);
+		void disconnect(ClientSession& client);
+		
+		void sendBlockChanges();
+		void sendChunk(ClientSession& client, int32_t chunkX, int32_t chunkZ);
+		void updateInterest(ClientSession& client);
+		void sendMobUpdates(ClientSession& client);
+		void unloadUnusedChunks();
+		
+		glm::vec3 spawnPos(int32_t x, int32_t z); // on top of the terrain
+		uint32_t getMobId(const Mob* mob);
+	};
+}
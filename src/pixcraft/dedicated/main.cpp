@@ -0,0 +1,77 @@
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+
+#include "game_server.hpp"
+#include "soak_test.hpp"
+#include "benchmarks.hpp"
+
+#include "pixcraft/network/connection.hpp"
+#include "pixcraft/network/protocol.hpp"
+#include "pixcraft/server/blocks.hpp"
+#include "pixcraft/util/random.hpp"
+#include "pixcraft/util/version.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	const int STATS_INTERVAL = 5; // in seconds
+	
+	int usage(char* name) {
+		std::cout << "Usage: " << name << " [--port <port>] [--seed <seed>] [--soak <clients> [--duration <seconds>]] [--bench <name>]" << std::endl;
+		return 1;
+	}
+}
+
+int main(int argc, char** argv) {
+	uint16_t port = Protocol::DEFAULT_PORT;
+	uint64_t seed = generateSeed();
+	int soakClients = 0;
+	float soakDuration = 30.0f;
+	std::string benchmark;
+	try {
+		for(int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			if(i+1 >= argc) return usage(argv[0]);
+			if(arg == "--port") port = std::stoi(argv[++i]);
+			else if(arg == "--seed") seed = std::stoull(argv[++i]);
+			else if(arg == "--soak") soakClients = std::stoi(argv[++i]);
+			else if(arg == "--duration") soakDuration = std::stof(argv[++i]);
+			else if(arg == "--bench") benchmark = argv[++i];
+			else return usage(argv[0]);
+		}
+	} catch(std::logic_error& err) {
+		return usage(argv[0]);
+	}
+	
+	try {
+		Socket::initNetworking();
+		BlockRegistry::defineBlocks();
+		
+		if(!benchmark.empty()) {
+			return runBenchmark(benchmark, seed) ? 0 : usage(argv[0]);
+		}
+		
+		if(soakClients > 0) {
+			runSoakTest(soakClients, soakDuration, port);
+			return 0;
+		}
+		
+		GameServer server(port, seed);
+		server.start();
+		std::cout << "PixCraft server " << getVersionString() << " listening on port " << port << " (seed " << seed << ")" << std::endl;
+		uint64_t lastBytes = 0;
+		while(true) {
+			std::this_thread::sleep_for(std::chrono::seconds(STATS_INTERVAL));
+			uint64_t bytes = server.bytesSent();
+			std::cout << server.clientCount() << " clients, tick " << server.tickNo() << ", "
+				<< (bytes - lastBytes) / 1024.0f / STATS_INTERVAL << " KiB/s sent" << std::endl;
+			lastBytes = bytes;
+		}
+	} catch(std::runtime_error& err) {
+		std::cout << "A runtime error occured: " << err.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,108 @@
+#include "soak_test.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cmath>
+
+#include "game_server.hpp"
+
+#include "pixcraft/network/net_client.hpp"
+#include "pixcraft/server/blocks.hpp"
+#include "pixcraft/util/profiler.hpp"
+#include "pixcraft/util/random.hpp"
+#include "pixcraft/util/util.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	const int VIEW_DISTANCE = 6;
+	const float STEP_TIME = 1 / 60.0f;
+	const float PING_INTERVAL = 0.25f;
+	const float EDIT_INTERVAL = 1.0f;
+	const float CIRCLE_RADIUS = 48.0f;
+	const float CIRCLE_SPEED = 0.1f; // in rad/s, 4.8 blocks/s at this radius
+
+	float percentile(std::vector<float>& sorted, float p) {
+		if(sorted.empty()) return 0.0f;
+		return sorted[std::min((size_t) (p * sorted.size()), sorted.size() - 1)];
+	}
+}
+
+void PixCraft::runSoakTest(int clientCount, float duration, uint16_t port) {
+	GameServer server(port, generateSeed());
+	server.start();
+
+	std::vector<std::unique_ptr<NetClient>> clients;
+	for(int i = 0; i < clientCount; ++i) {
+		clients.emplace_back(new NetClient("127.0.0.1", port, VIEW_DISTANCE));
+	}
+	std::cout << "Soak test: " << clientCount << " clients for " << duration << "s..." << std::endl;
+
+	int64_t start = Profiler::now();
+	uint64_t startTick = server.tickNo();
+	float nextPing = 0.0f, nextEdit = 0.0f;
+	int64_t nextStep = start;
+	while(true) {
+		float t = (Profiler::now() - start) / 1000000.0f;
+		if(t >= duration) break;
+
+		bool ping = t >= nextPing;
+		if(ping) nextPing += PING_INTERVAL;
+		bool edit = t >= nextEdit;
+		if(edit) nextEdit += EDIT_INTERVAL;
+
+		for(int i = 0; i < clientCount; ++i) {
+			NetClient& client = *clients[i];
+			// Each client runs along its own circle, so that they see overlapping but different chunks
+			float angle = TAU*i / clientCount + CIRCLE_SPEED*t;
+			glm::vec3 pos(CIRCLE_RADIUS*std::cos(angle), 50.0f, CIRCLE_RADIUS*std::sin(angle));
+			client.sendPosition(pos, glm::vec3(angle, 0.0f, 0.0f));
+			if(ping) client.sendPing();
+			if(edit) client.sendBlockEdit(std::floor(pos.x), 40, std::floor(pos.z), BlockRegistry::PLANKS_ID);
+			client.update();
+			// Nothing renders the mirrored worlds, so their update sets are drained here
+			client.getWorld().retrieveDirtyBlocks();
+			client.getWorld().retrieveDirtyChunks();
+		}
+
+		nextStep += STEP_TIME * 1000000;
+		int64_t wait = nextStep - Profiler::now();
+		if(wait > 0) std::this_thread::sleep_for(std::chrono::microseconds(wait));
+	}
+	float elapsed = (Profiler::now() - start) / 1000000.0f;
+	uint64_t ticks = server.tickNo() - startTick;
+	server.stop();
+
+	std::vector<float> latencies;
+	uint64_t bytesReceived = 0, messages = 0, chunks = 0, deltas = 0;
+	int disconnected = 0;
+	for(auto& client : clients) {
+		latencies.insert(latencies.end(), client->getLatencies().begin(), client->getLatencies().end());
+		bytesReceived += client->getConnection().bytesReceived();
+		messages += client->messagesReceived();
+		chunks += client->chunksReceived();
+		deltas += client->deltasReceived();
+		if(!client->getConnection().isOpen()) disconnected++;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	float avgLatency = 0.0f;
+	for(float latency : latencies) avgLatency += latency;
+	if(!latencies.empty()) avgLatency /= latencies.size();
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Server: " << ticks << " ticks in " << elapsed << "s (" << ticks / elapsed << " ticks/s), "
+		<< server.bytesSent() / 1024.0f << " KiB sent" << std::endl;
+	std::cout << "Clients: " << bytesReceived / 1024.0f << " KiB received (" << bytesReceived / 1024.0f / elapsed << " KiB/s, "
+		<< bytesReceived / 1024.0f / elapsed / clientCount << " KiB/s per client), "
+		<< messages << " messages, " << chunks << " chunks, " << deltas << " block deltas, "
+		<< disconnected << " disconnected" << std::endl;
+	// Pongs are only sent at the start of the next tick, so round trips include up to a tick of waiting
+	std::cout << "Round trip (ms): avg " << avgLatency << ", p50 " << percentile(latencies, 0.5f)
+		<< ", p99 " << percentile(latencies, 0.99f) << ", max " << (latencies.empty() ? 0.0f : latencies.back())
+		<< " (" << latencies.size() << " pings)" << std::endl;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+namespace PixCraft {
+	// Runs a GameServer with a number of simulated clients moving around for a given duration (in seconds),
+	// then prints the bandwidth and latency they observed.
+	void runSoakTest(int clientCount, float duration, uint16_t port);
+}
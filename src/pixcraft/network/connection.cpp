@@ -0,0 +1,208 @@
+#include "connection.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+	#define INVALID_HANDLE ((SocketHandle) INVALID_SOCKET)
+	#define closeHandle(h) closesocket(h)
+	#define wouldBlock() (WSAGetLastError() == WSAEWOULDBLOCK)
+	#define SEND_FLAGS 0
+#else
+	#include <sys/socket.h>
+	#include <sys/types.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <netdb.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <cerrno>
+	#define INVALID_HANDLE (-1)
+	#define closeHandle(h) ::close(h)
+	#define wouldBlock() (errno == EAGAIN || errno == EWOULDBLOCK)
+	#define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+using namespace PixCraft;
+
+void Socket::initNetworking() {
+	#ifdef _WIN32
+	WSADATA data;
+	if(WSAStartup(MAKEWORD(2, 2), &data) != 0)
+		throw std::runtime_error("Failed to initialize Winsock");
+	#endif
+}
+
+Socket Socket::listen(uint16_t port) {
+	Socket sock(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+	if(!sock.isValid()) throw std::runtime_error("Failed to create socket");
+
+	int yes = 1;
+	setsockopt(sock.handle, SOL_SOCKET, SO_REUSEADDR, (const char*) &yes, sizeof(yes));
+
+	sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if(::bind(sock.handle, (sockaddr*) &addr, sizeof(addr)) != 0)
+		throw std::runtime_error("Failed to bind socket to port " + std::to_string(port));
+	if(::listen(sock.handle, SOMAXCONN) != 0)
+		throw std::runtime_error("Failed to listen on socket");
+
+	sock.setNonBlocking();
+	return sock;
+}
+
+Socket Socket::connect(std::string host, uint16_t port) {
+	addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* result;
+	if(getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+		throw std::runtime_error("Failed to resolve " + host);
+
+	Socket sock(::socket(result->ai_family, result->ai_socktype, result->ai_protocol));
+	if(!sock.isValid()) {
+		freeaddrinfo(result);
+		throw std::runtime_error("Failed to create socket");
+	}
+	int status = ::connect(sock.handle, result->ai_addr, result->ai_addrlen);
+	freeaddrinfo(result);
+	if(status != 0)
+		throw std::runtime_error("Failed to connect to " + host + ":" + std::to_string(port));
+
+	sock.setNonBlocking();
+	return sock;
+}
+
+Socket::Socket() : handle(INVALID_HANDLE) { }
+Socket::Socket(SocketHandle handle) : handle(handle) { }
+
+Socket::Socket(Socket&& other) : handle(other.handle) {
+	other.handle = INVALID_HANDLE;
+}
+
+Socket& Socket::operator=(Socket&& other) {
+	if(this != &other) {
+		close();
+		handle = other.handle;
+		other.handle = INVALID_HANDLE;
+	}
+	return *this;
+}
+
+Socket::~Socket() {
+	close();
+}
+
+bool Socket::isValid() { return handle != INVALID_HANDLE; }
+
+void Socket::close() {
+	if(isValid()) {
+		closeHandle(handle);
+		handle = INVALID_HANDLE;
+	}
+}
+
+Socket Socket::accept() {
+	Socket client(::accept(handle, nullptr, nullptr));
+	if(client.isValid()) client.setNonBlocking();
+	return client;
+}
+
+int Socket::send(const uint8_t* data, size_t size) {
+	int sent = ::send(handle, (const char*) data, size, SEND_FLAGS);
+	if(sent < 0) return wouldBlock() ? 0 : -1;
+	return sent;
+}
+
+int Socket::receive(uint8_t* data, size_t size) {
+	int received = ::recv(handle, (char*) data, size, 0);
+	if(received == 0) return -1; // closed by the peer
+	if(received < 0) return wouldBlock() ? 0 : -1;
+	return received;
+}
+
+void Socket::setNonBlocking() {
+	#ifdef _WIN32
+	u_long mode = 1;
+	ioctlsocket(handle, FIONBIO, &mode);
+	#else
+	fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+	#endif
+	// Messages are small and latency-sensitive
+	int yes = 1;
+	setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char*) &yes, sizeof(yes));
+}
+
+
+Connection::Connection(Socket socket2)
+	: socket(std::move(socket2)), open(socket.isValid()), outStart(0), inStart(0), _bytesSent(0), _bytesReceived(0) { }
+
+bool Connection::isOpen() { return open; }
+
+void Connection::close() {
+	socket.close();
+	open = false;
+}
+
+void Connection::send(flatbuffers::FlatBufferBuilder& builder) {
+	if(!open) return;
+	uint8_t* buf = builder.GetBufferPointer();
+	outBuffer.insert(outBuffer.end(), buf, buf + builder.GetSize());
+}
+
+bool Connection::flush() {
+	while(open && outStart < outBuffer.size()) {
+		int sent = socket.send(outBuffer.data() + outStart, outBuffer.size() - outStart);
+		if(sent < 0) close();
+		if(sent <= 0) break;
+		outStart += sent;
+		_bytesSent += sent;
+	}
+	if(outStart == outBuffer.size()) {
+		outBuffer.clear();
+		outStart = 0;
+	}
+	return open;
+}
+
+size_t Connection::queuedBytes() { return outBuffer.size() - outStart; }
+
+bool Connection::receive(std::vector<uint8_t>& message) {
+	// Consumed messages are cut from the front once they make up half of the buffer, not one by one,
+	// so that a burst of small messages stays linear
+	if(inStart > 0 && inStart >= inBuffer.size() / 2) {
+		inBuffer.erase(inBuffer.begin(), inBuffer.begin() + inStart);
+		inStart = 0;
+	}
+
+	uint8_t buf[16384];
+	while(open) {
+		int received = socket.receive(buf, sizeof(buf));
+		if(received < 0) close();
+		if(received <= 0) break;
+		inBuffer.insert(inBuffer.end(), buf, buf + received);
+		_bytesReceived += received;
+	}
+
+	if(inBuffer.size() - inStart < 4) return false;
+	const uint8_t* header = inBuffer.data() + inStart;
+	uint32_t size = header[0] | header[1] << 8 | header[2] << 16 | (uint32_t) header[3] << 24;
+	if(size > MAX_MESSAGE_SIZE) {
+		close();
+		return false;
+	}
+	if(inBuffer.size() - inStart < 4 + size) return false;
+	message.assign(inBuffer.begin() + inStart + 4, inBuffer.begin() + inStart + 4 + size);
+	inStart += 4 + size;
+	return true;
+}
+
+uint64_t Connection::bytesSent() { return _bytesSent; }
+uint64_t Connection::bytesReceived() { return _bytesReceived; }
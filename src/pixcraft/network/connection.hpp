@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "flatbuffers/flatbuffers.h"
+
+namespace PixCraft {
+	#ifdef _WIN32
+	typedef uintptr_t SocketHandle;
+	#else
+	typedef int SocketHandle;
+	#endif
+
+	// Non-blocking TCP socket
+	class Socket {
+	public:
+		// Must be called once before creating sockets (starts Winsock on Windows)
+		static void initNetworking();
+
+		static Socket listen(uint16_t port);
+		static Socket connect(std::string host, uint16_t port);
+
+		Socket();
+		Socket(Socket&& other);
+		Socket& operator=(Socket&& other);
+		~Socket();
+
+		bool isValid();
+		void close();
+
+		// Returns an invalid socket if no connection is pending
+		Socket accept();
+
+		// Return the number of bytes transferred, 0 if the call would block, or -1 if the connection was closed or failed
+		int send(const uint8_t* data, size_t size);
+		int receive(uint8_t* data, size_t size);
+
+	private:
+		SocketHandle handle;
+
+		explicit Socket(SocketHandle handle);
+		void setNonBlocking();
+	};
+
+	// Exchanges messages prefixed by their size over a socket, without ever blocking:
+	// sent messages are queued until flush() manages to write them.
+	class Connection {
+	public:
+		static const uint32_t MAX_MESSAGE_SIZE = 1 << 24;
+
+		Connection(Socket socket);
+
+		bool isOpen();
+		void close();
+
+		// The builder must have been finished with FinishSizePrefixed
+		void send(flatbuffers::FlatBufferBuilder& builder);
+		// Returns false if the connection was closed
+		bool flush();
+		size_t queuedBytes();
+
+		// Returns true and fills message (without the size prefix) if a complete message has arrived
+		bool receive(std::vector<uint8_t>& message);
+
+		uint64_t bytesSent();
+		uint64_t bytesReceived();
+
+	private:
+		Socket socket;
+		bool open;
+
+		std::vector<uint8_t> outBuffer;
+		size_t outStart;
+		std::vector<uint8_t> inBuffer;
+		size_t inStart; // received messages before this are consumed
+
+		uint64_t _bytesSent, _bytesReceived;
+	};
+}
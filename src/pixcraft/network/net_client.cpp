@@ -0,0 +1,120 @@
+#include "net_client.hpp"
+
+#include <stdexcept>
+
+#include "pixcraft/server/blocks.hpp"
+#include "pixcraft/server/chunk.hpp"
+#include "pixcraft/util/profiler.hpp"
+
+using namespace PixCraft;
+
+NetClient::NetClient(std::string host, uint16_t port, int viewDistance)
+	: connection(Socket::connect(host, port)), _playerId(0), nextPingId(0),
+	  _chunksReceived(0), _deltasReceived(0), _messagesReceived(0) {
+	flatbuffers::FlatBufferBuilder builder;
+	Protocol::send(connection, builder, Network::Payload_ClientHello, Network::CreateClientHello(builder, viewDistance));
+	connection.flush();
+}
+
+bool NetClient::update() {
+	std::vector<uint8_t> data;
+	while(connection.receive(data)) {
+		const Network::Message* message = Protocol::parse(data);
+		if(!message) {
+			connection.close();
+			break;
+		}
+		try {
+			handle(message);
+		} catch(std::runtime_error&) {
+			// A chunk the server sent is malformed
+			connection.close();
+			break;
+		}
+		_messagesReceived++;
+	}
+	return connection.flush();
+}
+
+void NetClient::sendPosition(glm::vec3 pos, glm::vec3 orient) {
+	flatbuffers::FlatBufferBuilder builder;
+	Serializer::Vec3 pos2(pos.x, pos.y, pos.z);
+	Serializer::Vec3 orient2(orient.x, orient.y, orient.z);
+	Protocol::send(connection, builder, Network::Payload_ClientPosition, Network::CreateClientPosition(builder, &pos2, &orient2));
+}
+
+void NetClient::sendBlockEdit(int32_t x, int32_t y, int32_t z, BlockId block) {
+	flatbuffers::FlatBufferBuilder builder;
+	Protocol::send(connection, builder, Network::Payload_BlockEdit,
+		Network::CreateBlockEdit(builder, x, y, z, static_cast<Serializer::BlockType>(block)));
+}
+
+void NetClient::sendPing() {
+	flatbuffers::FlatBufferBuilder builder;
+	Protocol::send(connection, builder, Network::Payload_Ping, Network::CreatePing(builder, nextPingId++, Profiler::now()));
+}
+
+World& NetClient::getWorld() { return world; }
+uint32_t NetClient::playerId() { return _playerId; }
+std::unordered_map<uint32_t, Network::MobState>& NetClient::getMobs() { return mobs; }
+std::vector<float>& NetClient::getLatencies() { return latencies; }
+Connection& NetClient::getConnection() { return connection; }
+uint64_t NetClient::chunksReceived() { return _chunksReceived; }
+uint64_t NetClient::deltasReceived() { return _deltasReceived; }
+uint64_t NetClient::messagesReceived() { return _messagesReceived; }
+
+void NetClient::handle(const Network::Message* message) {
+	switch(message->payload_type()) {
+	case Network::Payload_ServerHello:
+		_playerId = message->payload_as_ServerHello()->player_id();
+		break;
+	case Network::Payload_Pong:
+		latencies.push_back((Profiler::now() - message->payload_as_Pong()->time()) / 1000.0f);
+		break;
+	case Network::Payload_ChunkData: {
+		const Serializer::Chunk* chunkData = message->payload_as_ChunkData()->chunk();
+		if(!chunkData) break;
+		world.loadChunk(chunkData);
+		world.markChunkDirty(chunkData->chunk_x(), chunkData->chunk_z());
+		_chunksReceived++;
+		break;
+	}
+	case Network::Payload_ChunkUnload: {
+		auto unload = message->payload_as_ChunkUnload();
+		world.unloadChunk(unload->chunk_x(), unload->chunk_z());
+		break;
+	}
+	case Network::Payload_BlockDeltas: {
+		auto deltas = message->payload_as_BlockDeltas();
+		if(!deltas->deltas()) break;
+		int32_t chunkX = deltas->chunk_x();
+		int32_t chunkZ = deltas->chunk_z();
+		if(!world.isChunkLoaded(chunkX, chunkZ)) break;
+		Chunk& chunk = world.getChunk(chunkX, chunkZ);
+		for(const Network::BlockDelta* delta : *deltas->deltas()) {
+			// Deltas from a misbehaving server are dropped
+			BlockId id = static_cast<BlockId>(delta->block());
+			if(delta->index() >= CHUNK_BLOCKS || !BlockRegistry::isValidId(id)) continue;
+			uint8_t x, y, z;
+			std::tie(x, y, z) = Protocol::unpackBlockIndex(delta->index());
+			chunk.setBlockId(x, y, z, id, BlockRegistry::isOpaqueCube(id));
+			world.markDirty(chunkX*CHUNK_SIZE + x, y, chunkZ*CHUNK_SIZE + z);
+		}
+		_deltasReceived += deltas->deltas()->size();
+		break;
+	}
+	case Network::Payload_MobUpdates: {
+		auto updates = message->payload_as_MobUpdates();
+		if(!updates->mobs() || !updates->removed()) break;
+		for(const Network::MobState* mob : *updates->mobs()) {
+			mobs[mob->id()] = *mob;
+		}
+		for(uint32_t id : *updates->removed()) {
+			mobs.erase(id);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
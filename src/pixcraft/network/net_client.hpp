@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "pixcraft/util/glm.hpp"
+
+#include "pixcraft/server/world.hpp"
+#include "pixcraft/server/mob.hpp"
+#include "connection.hpp"
+#include "protocol.hpp"
+
+namespace PixCraft {
+	// Connects to a GameServer, and mirrors the part of its world that the server streams to it.
+	class NetClient {
+	public:
+		NetClient(std::string host, uint16_t port, int viewDistance);
+
+		// Handles the messages received since the last call, and flushes the queued ones;
+		// returns false once disconnected.
+		bool update();
+
+		void sendPosition(glm::vec3 pos, glm::vec3 orient);
+		void sendBlockEdit(int32_t x, int32_t y, int32_t z, BlockId block);
+		void sendPing();
+
+		World& getWorld();
+		uint32_t playerId();
+		// Mobs around the player, by server id
+		std::unordered_map<uint32_t, Network::MobState>& getMobs();
+
+		// Round-trip times of the pings answered so far, in ms
+		std::vector<float>& getLatencies();
+		Connection& getConnection();
+		uint64_t chunksReceived();
+		uint64_t deltasReceived();
+		uint64_t messagesReceived();
+
+	private:
+		Connection connection;
+		World world;
+		uint32_t _playerId;
+		std::unordered_map<uint32_t, Network::MobState> mobs;
+
+		uint32_t nextPingId;
+		std::vector<float> latencies;
+		uint64_t _chunksReceived, _deltasReceived, _messagesReceived;
+
+		void handle(const Network::Message* message);
+	};
+}
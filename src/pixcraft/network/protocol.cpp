@@ -0,0 +1,9 @@
+#include "protocol.hpp"
+
+using namespace PixCraft;
+
+const Network::Message* Protocol::parse(std::vector<uint8_t>& data) {
+	flatbuffers::Verifier verifier(data.data(), data.size());
+	if(!Network::VerifyMessageBuffer(verifier)) return nullptr;
+	return Network::GetMessage(data.data());
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <tuple>
+
+#include "pixcraft/util/network_generated.h"
+#include "pixcraft/server/world_module.hpp"
+#include "connection.hpp"
+
+namespace PixCraft::Protocol {
+	const uint16_t DEFAULT_PORT = 25665;
+	
+	// Index of a block inside a chunk in BlockDelta messages
+	inline uint32_t blockIndex(uint8_t x, uint8_t y, uint8_t z) {
+		return x + CHUNK_SIZE*z + CHUNK_SIZE*CHUNK_SIZE*y;
+	}
+	inline std::tuple<uint8_t, uint8_t, uint8_t> unpackBlockIndex(uint32_t idx) {
+		return std::tuple<uint8_t, uint8_t, uint8_t>(idx % CHUNK_SIZE, idx / (CHUNK_SIZE*CHUNK_SIZE), idx / CHUNK_SIZE % CHUNK_SIZE);
+	}
+	
+	// Wraps the payload in a Message, so that the builder can be sent to connections
+	template<typename T>
+	void finish(flatbuffers::FlatBufferBuilder& builder, Network::Payload type, flatbuffers::Offset<T> payload) {
+		builder.FinishSizePrefixed(Network::CreateMessage(builder, type, payload.Union()));
+	}
+	
+	// Wraps the payload in a Message and queues it on the connection
+	template<typename T>
+	void send(Connection& connection, flatbuffers::FlatBufferBuilder& builder, Network::Payload type, flatbuffers::Offset<T> payload) {
+		finish(builder, type, payload);
+		connection.send(builder);
+	}
+	
+	// Returns nullptr if the data is not a valid message
+	const Network::Message* parse(std::vector<uint8_t>& data);
+}
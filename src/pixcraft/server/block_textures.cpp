@@ -0,0 +1,16 @@
+#include "block_textures.hpp"
+
+namespace PixCraft::TextureManager {
+	const char* const BLOCK_TEXTURE_NAMES[BLOCK_TEXTURE_COUNT] = {
+		"placeholder",
+		"stone",
+		"dirt",
+		"grass_side",
+		"grass_top",
+		"trunk_side",
+		"trunk_inside",
+		"leaves",
+		"water",
+		"planks"
+	};
+}
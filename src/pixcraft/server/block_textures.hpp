@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+namespace PixCraft {
+	typedef uint32_t TexId;
+	
+	#define TEX(name) (TextureManager::name)
+	
+	// The block definitions refer to their textures by id, including on the dedicated server, which doesn't load any.
+	// The client loads them as the layers of its block texture array, in this order.
+	namespace TextureManager {
+		const TexId PLACEHOLDER = 0;
+		const TexId STONE = 1;
+		const TexId DIRT = 2;
+		const TexId GRASS_SIDE = 3;
+		const TexId GRASS_TOP = 4;
+		const TexId TRUNK_SIDE = 5;
+		const TexId TRUNK_INSIDE = 6;
+		const TexId LEAVES = 7;
+		const TexId WATER = 8;
+		const TexId PLANKS = 9;
+		
+		const TexId BLOCK_TEXTURE_COUNT = 10;
+		
+		// Files in res/block, without their extension, by id
+		extern const char* const BLOCK_TEXTURE_NAMES[BLOCK_TEXTURE_COUNT];
+	}
+}
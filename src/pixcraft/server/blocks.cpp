@@ -14,8 +14,27 @@ using namespace PixCraft;
 namespace PixCraft::BlockRegistry {
 	namespace {
 		std::vector<std::unique_ptr<Block>> protoBlocks;
+		
+		void bakeProperties() {
+			size_t count = protoBlocks.size() + 1;
+			properties.rendering.assign(count, BlockRendering::none);
+			properties.collision.assign(count, BlockCollision::air);
+			properties.faceTextures.assign(count, std::array<TexId, 6>());
+			properties.hasUpdate.assign(count, false);
+			for(BlockId id = 1; id < count; ++id) {
+				Block& block = fromId(id);
+				properties.rendering[id] = block.rendering();
+				properties.collision[id] = block.collision();
+				for(uint8_t face = 0; face < 6; ++face) {
+					properties.faceTextures[id][face] = block.getFaceTexture(face);
+				}
+				properties.hasUpdate[id] = block.updates();
+			}
+		}
 	}
 	
+	PropertyTables properties;
+	
 	BlockId registerBlock(Block* block) {
 		BlockId id = protoBlocks.size() + 1;
 		block->setId(id);
@@ -39,6 +58,7 @@ namespace PixCraft::BlockRegistry {
 		fromId(LEAVES_ID).mainTexture(TEX(LEAVES)).rendering(BlockRendering::transparentCube);
 		fromId(WATER_ID).define();
 		fromId(PLANKS_ID).mainTexture(TEX(PLANKS));
+		bakeProperties();
 	}
 
 	Block& fromId(BlockId id) {
@@ -52,7 +72,7 @@ namespace PixCraft::BlockRegistry {
 
 
 Block::Block() :
-	_id((BlockId) -1), _rendering(BlockRendering::opaqueCube), _mainTexture(0), _collision(BlockCollision::solidCube) { }
+	_id((BlockId) -1), _rendering(BlockRendering::opaqueCube), _mainTexture(0), _collision(BlockCollision::solidCube), _updates(false) { }
 
 void Block::define() {}
 
@@ -65,11 +85,13 @@ bool Block::update(World& world, int32_t x, int32_t y, int32_t z) { return false
 Block& Block::rendering(BlockRendering rendering) { _rendering = rendering; return *this; }
 Block& Block::mainTexture(TexId texture) { _mainTexture = texture; return *this; }
 Block& Block::collision(BlockCollision collision) { _collision = collision; return *this; }
+Block& Block::updates(bool updates) { _updates = updates; return *this; }
 
 BlockId Block::id() { return _id; }
 BlockRendering Block::rendering() { return _rendering; }
 TexId Block::mainTexture() { return _mainTexture; }
 BlockCollision Block::collision() { return _collision; }
+bool Block::updates() { return _updates; }
 
 Block& Block::fromId(BlockId id) {
 	return BlockRegistry::fromId(id);
@@ -104,6 +126,7 @@ void WaterBlock::define() {
 	mainTexture(TEX(WATER));
 	rendering(BlockRendering::translucentCube);
 	collision(BlockCollision::fluidCube);
+	updates(true);
 }
 
 bool WaterBlock::update(World& world, int32_t x, int32_t y, int32_t z) {
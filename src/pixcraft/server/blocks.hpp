@@ -3,12 +3,20 @@
 #include <cstdint>
 #include <vector>
 #include <memory>
+#include <array>
 
-#include "pixcraft/client/textures.hpp"
-
+#include "block_textures.hpp"
 #include "world_module.hpp"
 
 namespace PixCraft {
+	enum class BlockRendering {
+		opaqueCube, transparentCube, translucentCube, none
+	};
+	
+	enum class BlockCollision {
+		solidCube, fluidCube, air
+	};
+	
 	class Block;
 	namespace BlockRegistry {
 		BlockId registerBlock(Block* block);
@@ -16,6 +24,8 @@ namespace PixCraft {
 		
 		Block& fromId(BlockId id);
 		unsigned int registeredCount();
+		// Air (0) and the registered blocks, from 1 to registeredCount()
+		inline bool isValidId(BlockId id) { return id <= registeredCount(); }
 		
 		extern const BlockId STONE_ID;
 		extern const BlockId DIRT_ID;
@@ -24,19 +34,27 @@ namespace PixCraft {
 		extern const BlockId LEAVES_ID;
 		extern const BlockId WATER_ID;
 		extern const BlockId PLANKS_ID;
-	};
-	
-	enum class BlockRendering {
-		opaqueCube, transparentCube, translucentCube
-	};
-	
-	enum class BlockCollision {
-		solidCube, fluidCube, air
+		
+		// Properties of every block id (including 0, air), baked into flat arrays by defineBlocks.
+		// Hot loops should read these rather than go through the virtual Block objects.
+		struct PropertyTables {
+			std::vector<BlockRendering> rendering;
+			std::vector<BlockCollision> collision;
+			std::vector<std::array<TexId, 6>> faceTextures;
+			std::vector<uint8_t> hasUpdate; // whether Block::update does anything
+		};
+		extern PropertyTables properties;
+		
+		inline BlockRendering rendering(BlockId id) { return properties.rendering[id]; }
+		inline bool isOpaqueCube(BlockId id) { return properties.rendering[id] == BlockRendering::opaqueCube; }
+		inline BlockCollision collision(BlockId id) { return properties.collision[id]; }
+		inline TexId faceTexture(BlockId id, uint8_t face) { return properties.faceTextures[id][face]; }
+		inline bool hasUpdate(BlockId id) { return properties.hasUpdate[id]; }
 	};
 	
 	class Block {
 		friend BlockId BlockRegistry::registerBlock(Block* block);
-		
+	
 	public:
 		Block();
 		virtual ~Block() = default;
@@ -48,19 +66,22 @@ namespace PixCraft {
 		Block& rendering(BlockRendering rendering);
 		Block& mainTexture(TexId texture);
 		Block& collision(BlockCollision collision);
+		Block& updates(bool updates); // has to be set by blocks that override update()
 		
 		BlockId id();
 		BlockRendering rendering();
 		TexId mainTexture();
 		BlockCollision collision();
+		bool updates();
 		
 		static Block& fromId(BlockId id);
-
+	
 	private:
 		BlockId _id;
 		BlockRendering _rendering;
 		TexId _mainTexture;
 		BlockCollision _collision;
+		bool _updates;
 		
 		void setId(BlockId id);
 	};
@@ -2,9 +2,13 @@
 
 #include <stdexcept>
 #include <algorithm>
+#include <memory>
 
 #include "blocks.hpp"
 #include "world.hpp"
+#include "section_encoding.hpp"
+
+#include "pixcraft/util/wyhash.h"
 
 using namespace PixCraft;
 
@@ -12,40 +16,244 @@ inline uint32_t blockIdx(uint8_t x, uint8_t y, uint8_t z) {
 	return x + CHUNK_SIZE*z + CHUNK_SIZE*CHUNK_SIZE*y;
 }
 
+static_assert(CHUNK_HEIGHT < 256, "Column heights are stored as bytes");
+
+inline uint32_t columnIdx(uint8_t x, uint8_t z) {
+	return x + CHUNK_SIZE*z;
+}
+
 inline uint8_t xFromIdx(uint32_t idx) { return idx % CHUNK_SIZE; }
 inline uint8_t yFromIdx(uint32_t idx) { return idx / CHUNK_SIZE / CHUNK_SIZE; }
 inline uint8_t zFromIdx(uint32_t idx) { return (idx / CHUNK_SIZE) % CHUNK_SIZE; }
 
-Chunk::Chunk() : world(nullptr), blocks(), opaqueCubeCache() { }
+namespace {
+	std::shared_ptr<ChunkSection> emptySection() {
+		static std::shared_ptr<ChunkSection> section = std::make_shared<ChunkSection>();
+		return section;
+	}
+	
+	void cacheOpaqueCubes(ChunkSection& section) {
+		for(int i = 0; i < SECTION_BLOCKS; ++i) {
+			section.opaqueCubeCache[i] = BlockRegistry::isOpaqueCube(section.blocks[i]);
+		}
+	}
+	
+	uint64_t hashSections(const std::shared_ptr<const ChunkSection>* sections) {
+		uint64_t hash = 0;
+		for(int s = 0; s < CHUNK_SECTIONS; ++s) {
+			hash = wyhash(sections[s]->blocks, sizeof(sections[s]->blocks), hash);
+		}
+		return hash;
+	}
+}
+
+ChunkSnapshot::ChunkSnapshot() : heightmap(), opaqueHeightmap() { }
+
+bool ChunkSnapshot::isLoaded() const { return sections[0] != nullptr; }
+
+bool ChunkSnapshot::hasBlock(int32_t x, int32_t y, int32_t z) const {
+	if(!isLoaded() || INVALID_BLOCK_POS(x, y, z)) return false;
+	uint32_t idx = blockIdx(x, y, z);
+	return sections[idx / SECTION_BLOCKS]->blocks[idx % SECTION_BLOCKS] != 0;
+}
+
+Block* ChunkSnapshot::getBlock(int32_t x, int32_t y, int32_t z) const {
+	BlockId id = getBlockId(x, y, z);
+	return id != 0 ? &Block::fromId(id) : nullptr;
+}
+
+BlockId ChunkSnapshot::getBlockId(int32_t x, int32_t y, int32_t z) const {
+	if(!isLoaded() || INVALID_BLOCK_POS(x, y, z)) return 0;
+	uint32_t idx = blockIdx(x, y, z);
+	return sections[idx / SECTION_BLOCKS]->blocks[idx % SECTION_BLOCKS];
+}
+
+bool ChunkSnapshot::isOpaqueCube(int32_t x, int32_t y, int32_t z) const {
+	if(!isLoaded() || INVALID_BLOCK_POS(x, y, z)) return false;
+	uint32_t idx = blockIdx(x, y, z);
+	return sections[idx / SECTION_BLOCKS]->opaqueCubeCache[idx % SECTION_BLOCKS];
+}
+
+uint8_t ChunkSnapshot::getHeight(uint8_t x, uint8_t z) const {
+	return heightmap[columnIdx(x, z)];
+}
+
+flatbuffers::Offset<Serializer::Chunk> ChunkSnapshot::serialize(int32_t chunkX, int32_t chunkZ, flatbuffers::FlatBufferBuilder& builder) const {
+	flatbuffers::Offset<Serializer::ChunkSection> sectionOffsets[CHUNK_SECTIONS];
+	for(int s = 0; s < CHUNK_SECTIONS; ++s) {
+		sectionOffsets[s] = SectionEncoding::encode(sections[s]->blocks, builder);
+	}
+	auto sectionVector = builder.CreateVector(sectionOffsets, CHUNK_SECTIONS);
+	auto updateVector = builder.CreateVector(scheduledUpdates);
+	return Serializer::CreateChunk(builder, chunkX, chunkZ, 0, updateVector, sectionVector);
+}
+
+flatbuffers::Offset<Serializer::Chunk> ChunkSnapshot::serializeDiff(int32_t chunkX, int32_t chunkZ, const ChunkSnapshot& generated,
+	flatbuffers::FlatBufferBuilder& builder) const {
+	std::vector<uint16_t> diffIndices;
+	std::vector<BlockId> diffBlocks;
+	for(int s = 0; s < CHUNK_SECTIONS; ++s) {
+		const BlockId* blocks = sections[s]->blocks;
+		const BlockId* generatedBlocks = generated.sections[s]->blocks;
+		if(std::equal(blocks, blocks + SECTION_BLOCKS, generatedBlocks)) continue;
+		for(int i = 0; i < SECTION_BLOCKS; ++i) {
+			if(blocks[i] != generatedBlocks[i]) {
+				diffIndices.push_back(s*SECTION_BLOCKS + i);
+				diffBlocks.push_back(blocks[i]);
+			}
+		}
+	}
+	if(diffIndices.empty() && scheduledUpdates.empty()) return flatbuffers::Offset<Serializer::Chunk>();
+	
+	auto updateVector = builder.CreateVector(scheduledUpdates);
+	auto diffIndexVector = builder.CreateVector(diffIndices);
+	auto diffBlockVector = builder.CreateVector(diffBlocks);
+	return Serializer::CreateChunk(builder, chunkX, chunkZ, 0, updateVector, 0, diffIndexVector, diffBlockVector);
+}
+
+uint64_t ChunkSnapshot::checksum() const {
+	return hashSections(sections);
+}
+
+const ChunkSnapshot& ChunkNeighbourhood::chunkAt(int32_t& relX, int32_t& relZ) const {
+	if(relX < 0) {
+		relX += CHUNK_SIZE;
+		return neighbours[0];
+	} else if(relX >= CHUNK_SIZE) {
+		relX -= CHUNK_SIZE;
+		return neighbours[1];
+	} else if(relZ < 0) {
+		relZ += CHUNK_SIZE;
+		return neighbours[2];
+	} else if(relZ >= CHUNK_SIZE) {
+		relZ -= CHUNK_SIZE;
+		return neighbours[3];
+	}
+	return center;
+}
+
+BlockId ChunkNeighbourhood::getBlockId(int32_t relX, int32_t y, int32_t relZ) const {
+	const ChunkSnapshot& chunk = chunkAt(relX, relZ);
+	return chunk.getBlockId(relX, y, relZ);
+}
+
+bool ChunkNeighbourhood::isOpaqueCube(int32_t relX, int32_t y, int32_t relZ) const {
+	const ChunkSnapshot& chunk = chunkAt(relX, relZ);
+	return chunk.isOpaqueCube(relX, y, relZ);
+}
+
+Chunk::Chunk() : world(nullptr), heightmap(), opaqueHeightmap(), _modified(false) {
+	for(int s = 0; s < CHUNK_SECTIONS; ++s) {
+		sections[s] = emptySection();
+	}
+}
 
 void Chunk::init(World* world2) { world = world2; }
 
 flatbuffers::Offset<Serializer::Chunk> Chunk::serialize(int32_t chunkX, int32_t chunkZ, flatbuffers::FlatBufferBuilder& builder) {
-	auto blockVector = builder.CreateVector(blocks, CHUNK_BLOCKS);
-	std::vector<uint32_t> updateVector(scheduledUpdates.begin(), scheduledUpdates.end());
-	auto updateVector2 = builder.CreateVector(updateVector);
-	return Serializer::CreateChunk(builder, chunkX, chunkZ, blockVector, updateVector2);
+	return snapshot().serialize(chunkX, chunkZ, builder);
 }
 
 void Chunk::unserialize(const Serializer::Chunk* chunkData) {
-	if(chunkData->blocks()->size() != CHUNK_BLOCKS) {
-		throw std::runtime_error("Wrong number of blocks in loaded chunk");
+	auto sectionData = chunkData->sections();
+	auto diffIndices = chunkData->diff_indices();
+	auto diffBlocks = chunkData->diff_blocks();
+	if(sectionData) {
+		if(sectionData->size() != CHUNK_SECTIONS) {
+			throw std::runtime_error("Wrong number of sections in loaded chunk");
+		}
+		for(int s = 0; s < CHUNK_SECTIONS; ++s) {
+			if(SectionEncoding::isEmpty(sectionData->Get(s))) {
+				sections[s] = emptySection();
+				continue;
+			}
+			sections[s] = std::make_shared<ChunkSection>();
+			SectionEncoding::decode(sectionData->Get(s), sections[s]->blocks);
+			cacheOpaqueCubes(*sections[s]);
+		}
+	} else if(diffIndices) {
+		if(!diffBlocks || diffBlocks->size() != diffIndices->size()) {
+			throw std::runtime_error("Invalid block diff in loaded chunk");
+		}
+		for(unsigned int i = 0; i < diffIndices->size(); ++i) {
+			uint16_t idx = diffIndices->Get(i);
+			BlockId id = diffBlocks->Get(i);
+			if(idx >= CHUNK_BLOCKS || !BlockRegistry::isValidId(id)) {
+				throw std::runtime_error("Invalid block diff in loaded chunk");
+			}
+			setBlockId(xFromIdx(idx), yFromIdx(idx), zFromIdx(idx), id, BlockRegistry::isOpaqueCube(id));
+		}
+	} else {
+		// Saved before sections were encoded separately
+		if(!chunkData->blocks() || chunkData->blocks()->size() != CHUNK_BLOCKS) {
+			throw std::runtime_error("Wrong number of blocks in loaded chunk");
+		}
+		for(BlockId id : *chunkData->blocks()) {
+			if(!BlockRegistry::isValidId(id)) throw std::runtime_error("Unknown block in loaded chunk");
+		}
+		copySections(chunkData->blocks()->data());
+	}
+	if(chunkData->scheduled_updates()) {
+		for(uint32_t idx : *chunkData->scheduled_updates()) {
+			if(idx >= CHUNK_BLOCKS) {
+				throw std::runtime_error("Invalid scheduled update in loaded chunk");
+			}
+			scheduledUpdates.insert(idx);
+		}
 	}
-	std::copy(chunkData->blocks()->begin(), chunkData->blocks()->end(), blocks);
-	for(int i = 0; i < CHUNK_BLOCKS; ++i) {
-		opaqueCubeCache[i] = blocks[i] == 0 ? false : Block::fromId(blocks[i]).rendering() == BlockRendering::opaqueCube;
+	
+	_modified = true;
+	// The heightmaps were kept up to date while applying a diff. Otherwise they are recomputed rather than
+	// trusted from the file or the network, since meshing and water checks rely on them being right.
+	if(!diffIndices) computeHeightmaps();
+}
+
+void Chunk::setBlocks(const BlockId* blocks) {
+	copySections(blocks);
+	computeHeightmaps();
+	_modified = true;
+}
+
+void Chunk::copySections(const BlockId* blocks) {
+	for(int s = 0; s < CHUNK_SECTIONS; ++s) {
+		const BlockId* begin = blocks + s*SECTION_BLOCKS;
+		const BlockId* end = begin + SECTION_BLOCKS;
+		if(std::all_of(begin, end, [](BlockId id) { return id == 0; })) {
+			sections[s] = emptySection();
+			continue;
+		}
+		sections[s] = std::make_shared<ChunkSection>();
+		std::copy(begin, end, sections[s]->blocks);
+		cacheOpaqueCubes(*sections[s]);
 	}
-	scheduledUpdates.insert(chunkData->scheduled_updates()->begin(), chunkData->scheduled_updates()->end());
 }
 
+ChunkSnapshot Chunk::snapshot() {
+	ChunkSnapshot snapshot;
+	std::copy(sections, sections + CHUNK_SECTIONS, snapshot.sections);
+	std::copy(heightmap, heightmap + CHUNK_COLUMNS, snapshot.heightmap);
+	std::copy(opaqueHeightmap, opaqueHeightmap + CHUNK_COLUMNS, snapshot.opaqueHeightmap);
+	snapshot.scheduledUpdates.assign(scheduledUpdates.begin(), scheduledUpdates.end());
+	return snapshot;
+}
+
+uint64_t Chunk::checksum() {
+	std::shared_ptr<const ChunkSection> constSections[CHUNK_SECTIONS];
+	std::copy(sections, sections + CHUNK_SECTIONS, constSections);
+	return hashSections(constSections);
+}
+
+bool Chunk::modified() { return _modified; }
+void Chunk::modified(bool modified) { _modified = modified; }
+
 bool Chunk::hasBlock(uint8_t x, uint8_t y, uint8_t z) {
 	if(INVALID_BLOCK_POS(x, y, z)) return false;
-	return blocks[blockIdx(x, y, z)] != 0;
+	return blockAt(blockIdx(x, y, z)) != 0;
 }
 
 Block* Chunk::getBlock(uint8_t x, uint8_t y, uint8_t z) {
 	if(INVALID_BLOCK_POS(x, y, z)) return nullptr;
-	BlockId id = blocks[blockIdx(x, y, z)];
+	BlockId id = blockAt(blockIdx(x, y, z));
 	if(id != 0) {
 		return &Block::fromId(id);
 	} else {
@@ -53,29 +261,36 @@ Block* Chunk::getBlock(uint8_t x, uint8_t y, uint8_t z) {
 	}
 }
 
+BlockId Chunk::getBlockId(uint8_t x, uint8_t y, uint8_t z) {
+	if(INVALID_BLOCK_POS(x, y, z)) return 0;
+	return blockAt(blockIdx(x, y, z));
+}
+
 void Chunk::setBlock(uint8_t x, uint8_t y, uint8_t z, Block& block) {
 	if(INVALID_BLOCK_POS(x, y, z)) throw std::logic_error("Invalid block position in chunk");
-	blocks[blockIdx(x, y, z)] = block.id();
-	opaqueCubeCache[blockIdx(x, y, z)] = block.rendering() == BlockRendering::opaqueCube;
+	setBlockId(x, y, z, block.id(), BlockRegistry::isOpaqueCube(block.id()));
 }
 
 void Chunk::removeBlock(uint8_t x, uint8_t y, uint8_t z) {
 	if(INVALID_BLOCK_POS(x, y, z)) throw std::logic_error("Invalid block position in chunk");
-	blocks[blockIdx(x, y, z)] = 0;
-	opaqueCubeCache[blockIdx(x, y, z)] = false;
+	setBlockId(x, y, z, 0, false);
 }
 
-void Chunk::requestUpdate(uint8_t x, uint8_t y, uint8_t z) {
-	if(INVALID_BLOCK_POS(x, y, z)) return;
-	scheduledUpdates.insert(blockIdx(x, y, z));
+bool Chunk::requestUpdate(uint8_t x, uint8_t y, uint8_t z) {
+	if(INVALID_BLOCK_POS(x, y, z)) return false;
+	uint32_t idx = blockIdx(x, y, z);
+	if(!BlockRegistry::hasUpdate(blockAt(idx))) return false;
+	scheduledUpdates.insert(idx);
+	return true;
 }
 
 void Chunk::updateBlocks(int32_t chunkX, int32_t chunkZ) {
 	std::unordered_set<uint32_t> updates;
 	scheduledUpdates.swap(updates);
 	for(uint32_t blockIdx : updates) {
-		BlockId id = blocks[blockIdx];
-		if(id != 0) {
+		// The block may have been replaced since the update was requested
+		BlockId id = blockAt(blockIdx);
+		if(BlockRegistry::hasUpdate(id)) {
 			int32_t x = CHUNK_SIZE*chunkX + xFromIdx(blockIdx);
 			uint8_t y = yFromIdx(blockIdx);
 			int32_t z = CHUNK_SIZE*chunkZ + zFromIdx(blockIdx);
@@ -88,11 +303,106 @@ void Chunk::updateBlocks(int32_t chunkX, int32_t chunkZ) {
 	}
 }
 
+uint8_t Chunk::getHeight(uint8_t x, uint8_t z) {
+	return heightmap[columnIdx(x, z)];
+}
+
+uint8_t Chunk::getOpaqueHeight(uint8_t x, uint8_t z) {
+	return opaqueHeightmap[columnIdx(x, z)];
+}
+
 bool Chunk::isOpaqueCube(uint8_t x, uint8_t y, uint8_t z) {
-	return opaqueCubeCache[blockIdx(x, y, z)];
+	uint32_t idx = blockIdx(x, y, z);
+	return sections[idx / SECTION_BLOCKS]->opaqueCubeCache[idx % SECTION_BLOCKS];
 }
 
 void Chunk::setBlockId(uint8_t x, uint8_t y, uint8_t z, BlockId id, bool isOpaqueCube) {
-	blocks[blockIdx(x, y, z)] = id;
-	opaqueCubeCache[blockIdx(x, y, z)] = isOpaqueCube;
+	uint32_t idx = blockIdx(x, y, z);
+	if(blockAt(idx) == id) return; // don't copy a shared section for nothing
+	ChunkSection& section = writableSection(idx);
+	section.blocks[idx % SECTION_BLOCKS] = id;
+	section.opaqueCubeCache[idx % SECTION_BLOCKS] = isOpaqueCube;
+	updateHeightmaps(x, y, z, id == 0, isOpaqueCube);
+	_modified = true;
+}
+
+size_t Chunk::editBox(uint8_t x1, uint8_t y1, uint8_t z1, uint8_t x2, uint8_t y2, uint8_t z2,
+	const std::function<BlockId(uint8_t, uint8_t, uint8_t, BlockId)>& edit) {
+	size_t changed = 0;
+	for(int s = y1 / CHUNK_SECTION_HEIGHT; s <= y2 / CHUNK_SECTION_HEIGHT; ++s) {
+		ChunkSection* section = nullptr;
+		uint8_t minY = std::max<int>(y1, s*CHUNK_SECTION_HEIGHT);
+		uint8_t maxY = std::min<int>(y2, (s+1)*CHUNK_SECTION_HEIGHT - 1);
+		for(uint8_t y = minY; y <= maxY; ++y) {
+			for(uint8_t z = z1; z <= z2; ++z) {
+				for(uint8_t x = x1; x <= x2; ++x) {
+					uint32_t idx = blockIdx(x, y, z);
+					BlockId current = blockAt(idx);
+					BlockId id = edit(x, y, z, current);
+					if(id == current) continue;
+					if(!section) section = &writableSection(idx);
+					section->blocks[idx % SECTION_BLOCKS] = id;
+					section->opaqueCubeCache[idx % SECTION_BLOCKS] = BlockRegistry::isOpaqueCube(id);
+					changed++;
+				}
+			}
+		}
+	}
+	
+	if(changed > 0) {
+		for(uint8_t z = z1; z <= z2; ++z) {
+			for(uint8_t x = x1; x <= x2; ++x) {
+				computeColumnHeights(x, z);
+			}
+		}
+		_modified = true;
+	}
+	return changed;
+}
+
+BlockId Chunk::blockAt(uint32_t idx) {
+	return sections[idx / SECTION_BLOCKS]->blocks[idx % SECTION_BLOCKS];
+}
+
+ChunkSection& Chunk::writableSection(uint32_t idx) {
+	std::shared_ptr<ChunkSection>& section = sections[idx / SECTION_BLOCKS];
+	// New references to a section are only made by snapshot(), with the world locked like here,
+	// so a count of 1 means no other thread can be reading it.
+	if(section.use_count() != 1) {
+		section = std::make_shared<ChunkSection>(*section);
+	}
+	return *section;
+}
+
+void Chunk::updateHeightmaps(uint8_t x, uint8_t y, uint8_t z, bool isAir, bool isOpaqueCube) {
+	uint8_t& height = heightmap[columnIdx(x, z)];
+	if(!isAir) {
+		height = std::max(height, (uint8_t) (y + 1));
+	} else if(y + 1 == height) {
+		// The top block was removed: look for the next one down
+		while(height > 0 && blockAt(blockIdx(x, height - 1, z)) == 0) height--;
+	}
+	
+	uint8_t& opaqueHeight = opaqueHeightmap[columnIdx(x, z)];
+	if(isOpaqueCube) {
+		opaqueHeight = std::max(opaqueHeight, (uint8_t) (y + 1));
+	} else if(y + 1 == opaqueHeight) {
+		while(opaqueHeight > 0 && !this->isOpaqueCube(x, opaqueHeight - 1, z)) opaqueHeight--;
+	}
+}
+
+void Chunk::computeHeightmaps() {
+	for(uint8_t x = 0; x < CHUNK_SIZE; ++x) {
+		for(uint8_t z = 0; z < CHUNK_SIZE; ++z) {
+			computeColumnHeights(x, z);
+		}
+	}
+}
+
+void Chunk::computeColumnHeights(uint8_t x, uint8_t z) {
+	uint8_t height = CHUNK_HEIGHT;
+	while(height > 0 && blockAt(blockIdx(x, height - 1, z)) == 0) height--;
+	heightmap[columnIdx(x, z)] = height;
+	while(height > 0 && !isOpaqueCube(x, height - 1, z)) height--;
+	opaqueHeightmap[columnIdx(x, z)] = height;
 }
@@ -3,6 +3,8 @@
 #include <vector>
 #include <unordered_set>
 #include <tuple>
+#include <memory>
+#include <functional>
 
 #include "world_module.hpp"
 #include "pixcraft/util/serializer_generated.h"
@@ -11,33 +13,124 @@ namespace PixCraft {
 	#define CHUNK_BLOCKS (CHUNK_SIZE*CHUNK_SIZE*CHUNK_HEIGHT)
 	#define MAX_CHUNK_FACES (CHUNK_BLOCKS*3)
 	
+	#define CHUNK_SECTION_HEIGHT 16
+	#define CHUNK_SECTIONS (CHUNK_HEIGHT/CHUNK_SECTION_HEIGHT)
+	#define SECTION_BLOCKS (CHUNK_SIZE*CHUNK_SIZE*CHUNK_SECTION_HEIGHT)
+	
+	#define CHUNK_COLUMNS (CHUNK_SIZE*CHUNK_SIZE)
+	
 	#define INVALID_BLOCK_POS(x, y, z) (x < 0 || x >= CHUNK_SIZE || y < 0 || y >= CHUNK_HEIGHT || z < 0 || z >= CHUNK_SIZE)
 	
+	// A horizontal slice of a chunk; sections are shared between a chunk and its snapshots until the chunk is modified.
+	struct ChunkSection {
+		BlockId blocks[SECTION_BLOCKS];
+		bool opaqueCubeCache[SECTION_BLOCKS];
+	};
+	
+	// Immutable copy of a chunk's blocks, which can be read from any thread.
+	// Taking one (see Chunk::snapshot) only copies a few pointers, but requires the world to be locked.
+	class ChunkSnapshot {
+	public:
+		ChunkSnapshot(); // an unloaded chunk, with no blocks
+		
+		bool isLoaded() const;
+		
+		bool hasBlock(int32_t x, int32_t y, int32_t z) const;
+		Block* getBlock(int32_t x, int32_t y, int32_t z) const;
+		BlockId getBlockId(int32_t x, int32_t y, int32_t z) const; // 0 outside of the chunk
+		bool isOpaqueCube(int32_t x, int32_t y, int32_t z) const;
+		uint8_t getHeight(uint8_t x, uint8_t z) const; // see Chunk::getHeight
+		
+		flatbuffers::Offset<Serializer::Chunk> serialize(int32_t chunkX, int32_t chunkZ, flatbuffers::FlatBufferBuilder& builder) const;
+		// Only saves the blocks that differ from the generated chunk;
+		// returns a null offset if there are none, and no scheduled updates either
+		flatbuffers::Offset<Serializer::Chunk> serializeDiff(int32_t chunkX, int32_t chunkZ, const ChunkSnapshot& generated,
+			flatbuffers::FlatBufferBuilder& builder) const;
+		uint64_t checksum() const;
+	
+	private:
+		friend class Chunk;
+		
+		std::shared_ptr<const ChunkSection> sections[CHUNK_SECTIONS];
+		uint8_t heightmap[CHUNK_COLUMNS];
+		uint8_t opaqueHeightmap[CHUNK_COLUMNS];
+		std::vector<uint32_t> scheduledUpdates;
+	};
+	
+	// Snapshots of a chunk and its four horizontal neighbours, for meshing.
+	// Coordinates are relative to the center chunk, and may be up to one chunk outside of it along one axis.
+	struct ChunkNeighbourhood {
+		ChunkSnapshot center;
+		ChunkSnapshot neighbours[4]; // -X, +X, -Z, +Z
+		
+		BlockId getBlockId(int32_t relX, int32_t y, int32_t relZ) const;
+		bool isOpaqueCube(int32_t relX, int32_t y, int32_t relZ) const;
+	
+	private:
+		const ChunkSnapshot& chunkAt(int32_t& relX, int32_t& relZ) const;
+	};
+	
 	class Chunk {
 	public:
 		Chunk();
 		void init(World* world);
 		
 		flatbuffers::Offset<Serializer::Chunk> serialize(int32_t chunkX, int32_t chunkZ, flatbuffers::FlatBufferBuilder& builder);
+		// Diffs (see ChunkSnapshot::serializeDiff) are applied on top of the current blocks, so the chunk must be generated first
 		void unserialize(const Serializer::Chunk* chunkData);
 		
+		// Replaces every block at once (in x + 16*z + 256*y order), much faster than setting them one by one
+		void setBlocks(const BlockId* blocks);
+		
+		// Requires the world to be locked; see ChunkSnapshot
+		ChunkSnapshot snapshot();
+		
+		uint64_t checksum();
+		
+		// Whether blocks were changed since the chunk was generated; loaded chunks are assumed to be.
+		// Chunks that weren't are left out of world saves.
+		bool modified();
+		void modified(bool modified);
+		
 		bool hasBlock(uint8_t x, uint8_t y, uint8_t z);
 		Block* getBlock(uint8_t x, uint8_t y, uint8_t z);
+		BlockId getBlockId(uint8_t x, uint8_t y, uint8_t z);
 		void setBlock(uint8_t x, uint8_t y, uint8_t z, Block& block);
 		void removeBlock(uint8_t x, uint8_t y, uint8_t z);
 		
-		void requestUpdate(uint8_t x, uint8_t y, uint8_t z);
+		// Returns false if the block has no update logic, in which case nothing is scheduled
+		bool requestUpdate(uint8_t x, uint8_t y, uint8_t z);
 		void updateBlocks(int32_t chunkX, int32_t chunkZ);
 		
+		// Height of the highest block (resp. opaque cube) of a column, plus one; 0 for an empty column.
+		// Kept up to date by every block change.
+		uint8_t getHeight(uint8_t x, uint8_t z);
+		uint8_t getOpaqueHeight(uint8_t x, uint8_t z);
+		
 		// Fast functions; they do not check for invalid positions, and do not update blocks.
 		bool isOpaqueCube(uint8_t x, uint8_t y, uint8_t z);
 		void setBlockId(uint8_t x, uint8_t y, uint8_t z, BlockId id, bool isOpaqueCube);
-		
+		// Replaces each block of a box (with inclusive bounds) by edit(x, y, z, current id), and returns how many changed.
+		// Each section is only made writable once, and the heightmaps are recomputed once per column at the end.
+		size_t editBox(uint8_t x1, uint8_t y1, uint8_t z1, uint8_t x2, uint8_t y2, uint8_t z2,
+			const std::function<BlockId(uint8_t, uint8_t, uint8_t, BlockId)>& edit);
+	
 	private:
 		World* world;
 		
-		BlockId blocks[CHUNK_BLOCKS];
-		bool opaqueCubeCache[CHUNK_BLOCKS];
+		// Sections that are entirely air all point to the same shared section
+		std::shared_ptr<ChunkSection> sections[CHUNK_SECTIONS];
+		uint8_t heightmap[CHUNK_COLUMNS];
+		uint8_t opaqueHeightmap[CHUNK_COLUMNS];
 		std::unordered_set<uint32_t> scheduledUpdates;
+		bool _modified;
+		
+		BlockId blockAt(uint32_t idx);
+		// Copies the section first if a snapshot still uses it
+		ChunkSection& writableSection(uint32_t idx);
+		void copySections(const BlockId* blocks); // doesn't update the heightmaps
+		void updateHeightmaps(uint8_t x, uint8_t y, uint8_t z, bool isAir, bool isOpaqueCube);
+		void computeHeightmaps();
+		void computeColumnHeights(uint8_t x, uint8_t z);
 	};
-}
\ No newline at end of file
+}
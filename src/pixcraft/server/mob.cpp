@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <stdexcept>
+#include <atomic>
 
 #include "pixcraft/util/util.hpp"
 
@@ -14,6 +15,12 @@ using namespace PixCraft;
 
 const float BUOYANCY = 20.0f;
 
+namespace {
+	std::atomic<uint32_t> nextMobId(0);
+}
+
+
+uint32_t Mob::id() { return _id; }
 
 glm::vec3 Mob::pos() { return _pos; }
 void Mob::pos(glm::vec3 pos) { _pos = pos; }
@@ -48,19 +55,22 @@ float Mob::getWaterHeight() {
 	std::tie(minX, minY, minZ) = getBlockCoordsAt(c1);
 	int maxX, maxY, maxZ;
 	std::tie(maxX, maxY, maxZ) = getBlockCoordsAt(c2);
+	// Nothing to find above the highest block of the columns
+	int32_t top = minY - 1;
+	for(int32_t x = minX; x <= maxX; ++x) {
+		for(int32_t z = minZ; z <= maxZ; ++z) {
+			top = std::max(top, world.getSurfaceHeight(x, z) - 1);
+		}
+	}
 	int waterLevel = 0;
-	for(int32_t y = minY; y <= maxY; ++y) {
-		for(int32_t x = minX; x <= maxX; ++x) {
+	for(int32_t y = std::min(top, maxY); y >= minY && waterLevel == 0; --y) {
+		for(int32_t x = minX; x <= maxX && waterLevel == 0; ++x) {
 			for(int32_t z = minZ; z <= maxZ; ++z) {
-				Block* block = world.getBlock(x, y, z);
-				if(block == &Block::fromId(BlockRegistry::WATER_ID)) {
+				if(world.getBlockId(x, y, z) == BlockRegistry::WATER_ID) {
 					waterLevel = y;
 					break;
 				}
 			}
-			if(waterLevel == y) {
-				break;
-			}
 		}
 	}
 	if(waterLevel == 0) return 0;
@@ -120,7 +130,7 @@ std::unique_ptr<Mob> Mob::unserialize(World& world, const void* mobData, uint8_t
 }
 
 Mob::Mob(World& world, float height, float radius, bool canFly, bool collidesWithBlocks, glm::vec3 pos, glm::vec3 orient)
-	: world(world), height(height), radius(radius), canFly(canFly), collidesWithBlocks(collidesWithBlocks), onGround(false),
+	: world(world), _id(nextMobId++), height(height), radius(radius), canFly(canFly), collidesWithBlocks(collidesWithBlocks), onGround(false),
 	  _pos(pos), _orient(orient), _speed(0.0) {}
 
 flatbuffers::Offset<Serializer::MobBase> Mob::serializeMobBase(flatbuffers::FlatBufferBuilder& builder) {
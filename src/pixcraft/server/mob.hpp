@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <utility>
 #include <memory>
 
@@ -13,6 +14,9 @@ namespace PixCraft {
 	
 	class Mob {
 	public:
+		// Unique within the process, unlike the address, which can be reused once the mob is gone
+		uint32_t id();
+		
 		glm::vec3 pos();
 		void pos(glm::vec3 pos);
 		glm::vec3 speed();
@@ -37,6 +41,7 @@ namespace PixCraft {
 	protected:
 		World& world;
 		
+		uint32_t _id;
 		float height;
 		float radius;
 		
@@ -15,7 +15,6 @@ const char* PixCraft::movementModeNames[3] = {
 };
 
 const float WAIST_HEIGHT = 1.05;
-const float EYE_HEIGHT = 1.6;
 const float HEIGHT = 1.7;
 const float RADIUS = 0.2;
 
@@ -38,8 +37,7 @@ glm::vec3 Player::eyePos() { return _pos + glm::vec3(0, EYE_HEIGHT, 0); }
 bool Player::isEyeUnderwater() {
 	int32_t x, y, z;
 	std::tie(x, y, z) = getBlockCoordsAt(eyePos());
-	Block* block = world.getBlock(x, y, z);
-	return block == &Block::fromId(BlockRegistry::WATER_ID);
+	return world.getBlockId(x, y, z) == BlockRegistry::WATER_ID;
 }
 
 std::tuple<bool, int,int,int> Player::castRay(float maxDist, bool offset, bool hitFluids) {
@@ -10,6 +10,8 @@
 #include "pixcraft/util/serializer_generated.h"
 
 namespace PixCraft {
+	constexpr float EYE_HEIGHT = 1.6f;
+	
 	enum class MovementMode { normal, flying, noClip };
 	
 	extern const char* movementModeNames[3];
@@ -0,0 +1,113 @@
+#include "section_encoding.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+
+#include "blocks.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	int indexBits(size_t paletteSize) {
+		int bits = 0;
+		while((size_t(1) << bits) < paletteSize) bits = bits == 0 ? 1 : bits*2;
+		return bits;
+	}
+	
+	template<int BITS>
+	void pack(const uint16_t* indices, uint64_t* words) {
+		const int PER_WORD = 64 / BITS;
+		for(int w = 0; w < SECTION_BLOCKS / PER_WORD; ++w) {
+			uint64_t word = 0;
+			for(int k = 0; k < PER_WORD; ++k) {
+				word |= static_cast<uint64_t>(indices[w*PER_WORD + k]) << (k*BITS);
+			}
+			words[w] = word;
+		}
+	}
+	
+	// The palette must have 2^BITS entries, so that any index is valid
+	template<int BITS>
+	void unpack(const uint64_t* words, const BlockId* palette, BlockId* blocks) {
+		const int PER_WORD = 64 / BITS;
+		const uint64_t MASK = (uint64_t(1) << BITS) - 1;
+		for(int w = 0; w < SECTION_BLOCKS / PER_WORD; ++w) {
+			uint64_t word = words[w];
+			for(int k = 0; k < PER_WORD; ++k) {
+				blocks[w*PER_WORD + k] = palette[(word >> (k*BITS)) & MASK];
+			}
+		}
+	}
+}
+
+flatbuffers::Offset<Serializer::ChunkSection> SectionEncoding::encode(const BlockId* blocks, flatbuffers::FlatBufferBuilder& builder) {
+	// Maps each id to its index in the palette, which is sorted by id
+	BlockId maxId = *std::max_element(blocks, blocks + SECTION_BLOCKS);
+	std::vector<uint16_t> paletteIdx(maxId + 1, 0);
+	for(int i = 0; i < SECTION_BLOCKS; ++i) {
+		paletteIdx[blocks[i]] = 1;
+	}
+	std::vector<BlockId> palette;
+	for(BlockId id = 0; id <= maxId; ++id) {
+		if(paletteIdx[id]) {
+			paletteIdx[id] = palette.size();
+			palette.push_back(id);
+		}
+	}
+	
+	int bits = indexBits(palette.size());
+	auto paletteVector = builder.CreateVector(palette);
+	if(bits == 0) return Serializer::CreateChunkSection(builder, paletteVector, 0);
+	
+	uint16_t indices[SECTION_BLOCKS];
+	for(int i = 0; i < SECTION_BLOCKS; ++i) {
+		indices[i] = paletteIdx[blocks[i]];
+	}
+	uint64_t* words;
+	auto indexVector = builder.CreateUninitializedVector(SECTION_BLOCKS * bits / 64, &words);
+	switch(bits) {
+	case 1: pack<1>(indices, words); break;
+	case 2: pack<2>(indices, words); break;
+	case 4: pack<4>(indices, words); break;
+	case 8: pack<8>(indices, words); break;
+	default: pack<16>(indices, words); break;
+	}
+	return Serializer::CreateChunkSection(builder, paletteVector, bits, indexVector);
+}
+
+bool SectionEncoding::isEmpty(const Serializer::ChunkSection* data) {
+	auto palette = data->palette();
+	return palette && palette->size() == 1 && palette->Get(0) == 0;
+}
+
+void SectionEncoding::decode(const Serializer::ChunkSection* data, BlockId* blocks) {
+	auto paletteData = data->palette();
+	int bits = data->index_bits();
+	if(!paletteData || paletteData->size() == 0 || (bits != 0 && bits != 1 && bits != 2 && bits != 4 && bits != 8 && bits != 16)) {
+		throw std::runtime_error("Invalid section in loaded chunk");
+	}
+	for(BlockId id : *paletteData) {
+		if(!BlockRegistry::isValidId(id)) throw std::runtime_error("Unknown block in loaded chunk");
+	}
+	if(bits == 0) {
+		std::fill(blocks, blocks + SECTION_BLOCKS, paletteData->Get(0));
+		return;
+	}
+	
+	auto indexData = data->indices();
+	size_t wordCount = SECTION_BLOCKS * bits / 64;
+	if(!indexData || indexData->size() != wordCount || paletteData->size() > (size_t(1) << bits)) {
+		throw std::runtime_error("Invalid section in loaded chunk");
+	}
+	// Indices past the end of the palette are air
+	std::vector<BlockId> palette(size_t(1) << bits, 0);
+	std::copy(paletteData->begin(), paletteData->end(), palette.begin());
+	switch(bits) {
+	case 1: unpack<1>(indexData->data(), palette.data(), blocks); break;
+	case 2: unpack<2>(indexData->data(), palette.data(), blocks); break;
+	case 4: unpack<4>(indexData->data(), palette.data(), blocks); break;
+	case 8: unpack<8>(indexData->data(), palette.data(), blocks); break;
+	default: unpack<16>(indexData->data(), palette.data(), blocks); break;
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+#include "chunk.hpp"
+#include "pixcraft/util/serializer_generated.h"
+
+// Palette encoding of chunk sections in saves and network messages (see Serializer::ChunkSection).
+// Indices take a power of two number of bits, so that they never straddle words, and the packing loops have fixed shapes the compiler can vectorize.
+namespace PixCraft::SectionEncoding {
+	flatbuffers::Offset<Serializer::ChunkSection> encode(const BlockId* blocks, flatbuffers::FlatBufferBuilder& builder);
+	
+	// True if the section only contains air, in which case it doesn't need to be decoded
+	bool isEmpty(const Serializer::ChunkSection* data);
+	// Writes SECTION_BLOCKS blocks; throws on malformed data
+	void decode(const Serializer::ChunkSection* data, BlockId* blocks);
+}
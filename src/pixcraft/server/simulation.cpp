@@ -0,0 +1,127 @@
+#include "simulation.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <cmath>
+
+#include "world.hpp"
+#include "mob.hpp"
+
+#include "pixcraft/util/profiler.hpp"
+#include "pixcraft/util/util.hpp"
+
+using namespace PixCraft;
+
+Simulation::Simulation(World& world)
+	: world(world), running(false), lockstep(false), _tickNo(0), lastTickTime(0) { }
+
+Simulation::~Simulation() {
+	stop();
+}
+
+void Simulation::setCallbacks(std::function<void(float)> preTick2, std::function<void()> postTick2) {
+	preTick = preTick2;
+	postTick = postTick2;
+}
+
+void Simulation::start(bool lockstep2) {
+	lockstep = lockstep2;
+	{
+		std::lock_guard<std::mutex> lock(worldMutex);
+		publish();
+	}
+	if(!lockstep) {
+		running = true;
+		thread = std::thread(&Simulation::run, this);
+	}
+}
+
+void Simulation::stop() {
+	running = false;
+	if(thread.joinable()) thread.join();
+}
+
+void Simulation::step() {
+	if(!lockstep) throw std::logic_error("Simulation::step called while the simulation thread is running");
+	tick();
+}
+
+std::mutex& Simulation::mutex() { return worldMutex; }
+uint64_t Simulation::tickNo() { return _tickNo; }
+
+std::vector<MobSnapshot> Simulation::getMobs() {
+	std::lock_guard<std::mutex> lock(snapshotMutex);
+	float alpha = 1.0f;
+	if(!lockstep) {
+		alpha = (Profiler::now() - lastTickTime) / 1000000.0f / TICK_TIME;
+		alpha = std::min(std::max(alpha, 0.0f), 1.0f);
+	}
+
+	std::unordered_map<uint32_t, const MobSnapshot*> previous;
+	for(const MobSnapshot& mob : snapshots[0]) {
+		previous[mob.id] = &mob;
+	}
+	std::vector<MobSnapshot> mobs = snapshots[1];
+	for(MobSnapshot& mob : mobs) {
+		auto it = previous.find(mob.id);
+		if(it == previous.end()) continue; // spawned during the last tick
+		mob.pos = glm::mix(it->second->pos, mob.pos, alpha);
+		// Angles go the short way around, rather than spinning back across ±π
+		glm::vec3 turn = mob.orient - it->second->orient;
+		for(int i = 0; i < 3; ++i) {
+			turn[i] = std::remainder(turn[i], TAU);
+		}
+		mob.orient = it->second->orient + turn * alpha;
+	}
+	return mobs;
+}
+
+void Simulation::run() {
+	auto tickDuration = std::chrono::microseconds((int64_t) (TICK_TIME * 1000000));
+	auto nextTick = std::chrono::steady_clock::now();
+	while(running) {
+		tick();
+		nextTick += tickDuration;
+		auto now = std::chrono::steady_clock::now();
+		if(now > nextTick + MAX_LAG * tickDuration) {
+			std::cout << "Simulation can't keep up!" << std::endl;
+			nextTick = now;
+		}
+		std::this_thread::sleep_until(nextTick);
+	}
+}
+
+void Simulation::tick() {
+	{
+		std::lock_guard<std::mutex> lock(worldMutex);
+		Profiler::Scope scope("tick");
+		if(preTick) preTick(TICK_TIME);
+		{
+			Profiler::Scope scope("block updates");
+			world.applyEdits();
+			world.updateBlocks();
+		}
+		{
+			Profiler::Scope scope("entity update");
+			world.updateEntities(TICK_TIME);
+		}
+		if(postTick) postTick();
+		publish();
+	}
+	_tickNo++;
+}
+
+void Simulation::publish() {
+	std::vector<MobSnapshot> mobs;
+	for(auto& mob : world.mobs) {
+		mobs.push_back(MobSnapshot { mob->id(), mob->serializedType(), mob->pos(), mob->orient() });
+	}
+
+	std::lock_guard<std::mutex> lock(snapshotMutex);
+	std::swap(snapshots[0], snapshots[1]);
+	snapshots[1] = std::move(mobs);
+	lastTickTime = Profiler::now();
+}
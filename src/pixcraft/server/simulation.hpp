@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include "pixcraft/util/glm.hpp"
+
+#include "world_module.hpp"
+
+namespace PixCraft {
+	// State of a mob at the end of a tick
+	struct MobSnapshot {
+		uint32_t id; // see Mob::id()
+		uint8_t type; // see Mob::serializedType()
+		glm::vec3 pos;
+		glm::vec3 orient;
+	};
+	
+	// Runs the block and entity updates of a world at a fixed rate, on a separate thread.
+	// Other threads have to hold mutex() while accessing the world.
+	class Simulation {
+	public:
+		static constexpr float TICK_TIME = 1 / 60.0f;
+		static const int MAX_LAG = 5; // in ticks; beyond this, the simulation gives up catching up
+		
+		Simulation(World& world);
+		~Simulation();
+		
+		// Called on the simulation thread with the world locked, before and after each tick's updates
+		void setCallbacks(std::function<void(float)> preTick, std::function<void()> postTick);
+		
+		// In lockstep mode, no thread is started: the world only advances one tick per call to step()
+		void start(bool lockstep);
+		void stop();
+		void step();
+		
+		std::mutex& mutex();
+		uint64_t tickNo();
+		
+		// Returns the mob states of the last tick, interpolated from the previous one according to the time elapsed since.
+		// This lags up to a tick behind the simulation, but moves smoothly at any frame rate.
+		std::vector<MobSnapshot> getMobs();
+	
+	private:
+		World& world;
+		std::function<void(float)> preTick;
+		std::function<void()> postTick;
+		
+		std::thread thread;
+		std::atomic<bool> running;
+		bool lockstep;
+		std::mutex worldMutex;
+		std::atomic<uint64_t> _tickNo;
+		
+		std::mutex snapshotMutex;
+		std::vector<MobSnapshot> snapshots[2]; // previous and last tick
+		int64_t lastTickTime; // see Profiler::now()
+		
+		void run();
+		void tick();
+		void publish(); // requires the world to be locked
+	};
+}
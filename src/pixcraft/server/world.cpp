@@ -4,43 +4,89 @@
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
+#include <climits>
 
 #include "blocks.hpp"
 #include "mob.hpp"
 #include "player.hpp"
 
 #include "pixcraft/util/serializer_generated.h"
+#include "pixcraft/util/wyhash.h"
 
 using namespace PixCraft;
 
+BlockRegion::BlockRegion(int32_t x1, int32_t y1, int32_t z1, int32_t x2, int32_t y2, int32_t z2)
+	: x1(std::min(x1, x2)), y1(std::min(y1, y2)), z1(std::min(z1, z2)),
+	  x2(std::max(x1, x2)), y2(std::max(y1, y2)), z2(std::max(z1, z2)) { }
+
+int64_t BlockRegion::sizeX() const { return (int64_t) x2 - x1 + 1; }
+int64_t BlockRegion::sizeY() const { return (int64_t) y2 - y1 + 1; }
+int64_t BlockRegion::sizeZ() const { return (int64_t) z2 - z1 + 1; }
+
+int64_t BlockRegion::volume() const {
+	// Saturates rather than overflow, as each size can reach 2^32
+	int64_t x = sizeX(), y = sizeY(), z = sizeZ();
+	if(x > INT64_MAX / y) return INT64_MAX;
+	int64_t area = x * y;
+	if(area > INT64_MAX / z) return INT64_MAX;
+	return area * z;
+}
+
 World::World() { }
 
-void World::saveToFile(std::string path) {
-	flatbuffers::FlatBufferBuilder builder;
-	
+World::World(uint64_t seed) : gen(seed) { }
+
+void WorldSave::write() {
+	// Only the differences with the generated chunks are saved
+	WorldGenerator gen(seed);
 	std::vector<flatbuffers::Offset<Serializer::Chunk>> chunkOffsets;
-	for(auto& pair : loadedChunks) {
+	for(auto& pair : chunks) {
 		int32_t chunkX, chunkZ;
 		std::tie(chunkX, chunkZ) = unpackCoords(pair.first);
-		chunkOffsets.push_back(pair.second.serialize(chunkX, chunkZ, builder));
+		Chunk generated;
+		gen.generateChunk(generated, chunkX, chunkZ);
+		auto offset = pair.second.serializeDiff(chunkX, chunkZ, generated.snapshot(), *builder);
+		if(!offset.IsNull()) chunkOffsets.push_back(offset);
+	}
+	auto chunkVector = builder->CreateVector(chunkOffsets);
+	auto world = Serializer::CreateWorld(*builder, chunkVector, mobTypeVector, mobVector, seed, WorldGenerator::VERSION);
+	
+	builder->Finish(world);
+	std::ofstream file(path.c_str(), std::ios::binary);
+	uint8_t* buf = builder->GetBufferPointer();
+	file.write(reinterpret_cast<const char*>(buf), builder->GetSize());
+	file.close();
+	if(!file) {
+		throw std::runtime_error("Can't write world file!");
 	}
-	auto chunkVector = builder.CreateVector(chunkOffsets);
+}
+
+void World::saveToFile(std::string path) {
+	beginSave(path).write();
+}
+
+WorldSave World::beginSave(std::string path) {
+	WorldSave save;
+	save.path = path;
+	save.seed = gen.seed();
+	save.builder.reset(new flatbuffers::FlatBufferBuilder());
 	
 	std::vector<flatbuffers::Offset<void>> mobOffsets;
 	std::vector<uint8_t> mobTypes;
 	for(auto& mobPointer : mobs) {
-		mobOffsets.push_back(mobPointer->serialize(builder));
+		mobOffsets.push_back(mobPointer->serialize(*save.builder));
 		mobTypes.push_back(mobPointer->serializedType());
 	}
-	auto mobVector = builder.CreateVector(mobOffsets);
-	auto mobTypeVector = builder.CreateVector(mobTypes);
-	auto world = Serializer::CreateWorld(builder, chunkVector, mobTypeVector, mobVector, gen.seed());
+	save.mobVector = save.builder->CreateVector(mobOffsets);
+	save.mobTypeVector = save.builder->CreateVector(mobTypes);
 	
-	builder.Finish(world);
-	std::ofstream file(path.c_str(), std::ios::binary);
-	uint8_t* buf = builder.GetBufferPointer();
-	file.write(reinterpret_cast<const char*>(buf), builder.GetSize());
-	file.close();
+	for(auto& pair : loadedChunks) {
+		// Untouched chunks will be generated again on load
+		if(!pair.second.modified() && scheduledUpdates.count(pair.first) == 0) continue;
+		save.chunks.emplace_back(pair.first, pair.second.snapshot());
+	}
+	return save;
 }
 
 Player* World::loadFromFile(std::string path) {
@@ -55,6 +101,15 @@ Player* World::loadFromFile(std::string path) {
 	
 	auto world = Serializer::GetWorld(buffer.data());
 	
+	// Chunk diffs can't be applied to terrain generated differently
+	if(world->generator_version() != WorldGenerator::VERSION && world->chunks()) {
+		for(const Serializer::Chunk* chunkData : *world->chunks()) {
+			if(chunkData->diff_indices()) {
+				throw std::runtime_error("World file was saved with a different world generator!");
+			}
+		}
+	}
+	
 	loadedChunks.clear();
 	scheduledUpdates.clear();
 	dirtyBlocks.clear();
@@ -66,16 +121,7 @@ Player* World::loadFromFile(std::string path) {
 	auto chunks = world->chunks();
 	auto chunkCount = chunks->size();
 	for(unsigned int i = 0; i < chunkCount; ++i) {
-		const Serializer::Chunk* chunkData = chunks->Get(i);
-		int32_t chunkX = chunkData->chunk_x();
-		int32_t chunkZ = chunkData->chunk_z();
-		uint64_t key = packCoords(chunkX, chunkZ);
-		Chunk& chunk = loadedChunks[key];
-		chunk.init(this);
-		chunk.unserialize(chunkData);
-		if(chunkData->scheduled_updates()->size() != 0) {
-			scheduledUpdates.insert(key);
-		}
+		loadChunk(chunks->Get(i));
 	}
 	
 	auto mobsData = world->mobs();
@@ -97,6 +143,24 @@ Player* World::loadFromFile(std::string path) {
 	return player;
 }
 
+uint64_t World::checksum() {
+	std::vector<uint64_t> keys = getLoadedChunks();
+	std::sort(keys.begin(), keys.end());
+	
+	uint64_t hash = gen.seed();
+	for(uint64_t key : keys) {
+		hash = wyhash64(hash, key);
+		hash = wyhash64(hash, loadedChunks[key].checksum());
+	}
+	for(auto& mob : mobs) {
+		glm::vec3 pos = mob->pos();
+		hash = wyhash64(hash, wyhash(&pos, sizeof(pos), mob->serializedType()));
+	}
+	return hash;
+}
+
+uint64_t World::seed() { return gen.seed(); }
+
 bool World::isValidHeight(int32_t y) {
 	return 0 <= y && y < CHUNK_HEIGHT;
 }
@@ -127,10 +191,62 @@ Chunk& World::genChunk(int32_t x, int32_t z) {
 	Chunk& chunk = loadedChunks[key];
 	chunk.init(this);
 	gen.generateChunk(chunk, x, z);
+	chunk.modified(false);
 	dirtyChunks.insert(key);
 	return chunk;
 }
 
+Chunk& World::loadChunk(const Serializer::Chunk* chunkData) {
+	uint64_t key = packCoords(chunkData->chunk_x(), chunkData->chunk_z());
+	loadedChunks.erase(key);
+	Chunk& chunk = loadedChunks[key];
+	chunk.init(this);
+	if(chunkData->diff_indices()) {
+		gen.generateChunk(chunk, chunkData->chunk_x(), chunkData->chunk_z());
+	}
+	try {
+		chunk.unserialize(chunkData);
+	} catch(std::runtime_error&) {
+		loadedChunks.erase(key);
+		throw;
+	}
+	if(chunkData->scheduled_updates() && chunkData->scheduled_updates()->size() != 0) {
+		scheduledUpdates.insert(key);
+	}
+	return chunk;
+}
+
+void World::unloadChunk(int32_t x, int32_t z) {
+	uint64_t key = packCoords(x, z);
+	loadedChunks.erase(key);
+	scheduledUpdates.erase(key);
+	dirtyChunks.erase(key);
+}
+
+std::vector<uint64_t> World::getLoadedChunks() {
+	std::vector<uint64_t> keys;
+	for(auto& pair : loadedChunks) {
+		keys.push_back(pair.first);
+	}
+	return keys;
+}
+
+ChunkSnapshot World::snapshotChunk(int32_t x, int32_t z) {
+	auto iter = loadedChunks.find(packCoords(x, z));
+	if(iter == loadedChunks.end()) return ChunkSnapshot();
+	return iter->second.snapshot();
+}
+
+ChunkNeighbourhood World::snapshotNeighbourhood(int32_t x, int32_t z) {
+	ChunkNeighbourhood chunks;
+	chunks.center = snapshotChunk(x, z);
+	chunks.neighbours[0] = snapshotChunk(x - 1, z);
+	chunks.neighbours[1] = snapshotChunk(x + 1, z);
+	chunks.neighbours[2] = snapshotChunk(x, z - 1);
+	chunks.neighbours[3] = snapshotChunk(x, z + 1);
+	return chunks;
+}
+
 std::tuple<Chunk*, uint8_t, uint8_t> World::getBlockFromChunk(int32_t x, int32_t z) {
 	int chunkX, chunkZ;
 	std::tie(chunkX, chunkZ) = getChunkPosAt(x, z);
@@ -170,8 +286,8 @@ void World::requestUpdate(int32_t x, int32_t y, int32_t z) {
 	std::tie(chunk, relX, relZ) = getBlockFromChunk(x, z);
 	// TODO: if chunk doesn't exist yet, stash the update maybe?
 	if(chunk == nullptr) return;
-	chunk->requestUpdate(relX, y, relZ);
-	scheduledUpdates.insert(getChunkIdxAt(x, z));
+	if(chunk->requestUpdate(relX, y, relZ))
+		scheduledUpdates.insert(getChunkIdxAt(x, z));
 }
 
 void World::requestUpdatesAround(int32_t x, int32_t y, int32_t z) {
@@ -207,6 +323,28 @@ Block* World::getBlock(int32_t x, int32_t y, int32_t z) {
 	return chunk->getBlock(relX, y, relZ);
 }
 
+BlockId World::getBlockId(int32_t x, int32_t y, int32_t z) {
+	if(!isValidHeight(y)) return 0;
+	Chunk* chunk; int relX, relZ;
+	std::tie(chunk, relX, relZ) = getBlockFromChunk(x, z);
+	if(chunk == nullptr) return 0;
+	return chunk->getBlockId(relX, y, relZ);
+}
+
+int32_t World::getSurfaceHeight(int32_t x, int32_t z) {
+	Chunk* chunk; int relX, relZ;
+	std::tie(chunk, relX, relZ) = getBlockFromChunk(x, z);
+	if(chunk == nullptr) return 0;
+	return chunk->getHeight(relX, relZ);
+}
+
+int32_t World::getOpaqueSurfaceHeight(int32_t x, int32_t z) {
+	Chunk* chunk; int relX, relZ;
+	std::tie(chunk, relX, relZ) = getBlockFromChunk(x, z);
+	if(chunk == nullptr) return 0;
+	return chunk->getOpaqueHeight(relX, relZ);
+}
+
 void World::setBlock(int32_t x, int32_t y, int32_t z, Block& block) {
 	if(!isValidHeight(y)) return;
 	Chunk* chunk; int relX, relZ;
@@ -228,6 +366,171 @@ void World::removeBlock(int32_t x, int32_t y, int32_t z) {
 	requestUpdatesAround(x, y, z);
 }
 
+void World::queueEdit(int32_t x, int32_t y, int32_t z, BlockId id) {
+	editQueue.push(BlockEdit { x, y, z, id });
+}
+
+void World::applyEdits() {
+	editBatch.clear();
+	editQueue.popAll(editBatch);
+	if(editBatch.empty()) return;
+	
+	// Group the edits by chunk, then by block; the sort is stable, so the last edit of each block comes last.
+	std::stable_sort(editBatch.begin(), editBatch.end(), [](const BlockEdit& a, const BlockEdit& b) {
+		std::pair<int32_t, int32_t> chunkA = getChunkPosAt(a.x, a.z), chunkB = getChunkPosAt(b.x, b.z);
+		return std::tie(chunkA.first, chunkA.second, a.y, a.z, a.x) < std::tie(chunkB.first, chunkB.second, b.y, b.z, b.x);
+	});
+	
+	std::vector<const BlockEdit*> applied;
+	size_t start = 0;
+	while(start < editBatch.size()) {
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = getChunkPosAt(editBatch[start].x, editBatch[start].z);
+		size_t end = start + 1;
+		while(end < editBatch.size() && getChunkPosAt(editBatch[end].x, editBatch[end].z) == std::make_pair(chunkX, chunkZ)) {
+			++end;
+		}
+		
+		auto iter = loadedChunks.find(packCoords(chunkX, chunkZ));
+		if(iter != loadedChunks.end()) {
+			Chunk& chunk = iter->second;
+			applied.clear();
+			for(size_t i = start; i < end; ++i) {
+				const BlockEdit& edit = editBatch[i];
+				if(i+1 < end && edit.x == editBatch[i+1].x && edit.y == editBatch[i+1].y && edit.z == editBatch[i+1].z) {
+					continue; // overwritten by a later edit
+				}
+				if(!isValidHeight(edit.y) || !BlockRegistry::isValidId(edit.id)) continue;
+				chunk.setBlockId(edit.x - chunkX*CHUNK_SIZE, edit.y, edit.z - chunkZ*CHUNK_SIZE, edit.id, BlockRegistry::isOpaqueCube(edit.id));
+				applied.push_back(&edit);
+			}
+			
+			if(applied.size() > FULL_UPDATE_EDITS) {
+				markChunkDirty(chunkX, chunkZ);
+			} else {
+				for(const BlockEdit* edit : applied) markDirty(edit->x, edit->y, edit->z);
+			}
+			for(const BlockEdit* edit : applied) {
+				if(edit->id != 0) requestUpdate(edit->x, edit->y, edit->z);
+				requestUpdatesAround(edit->x, edit->y, edit->z);
+			}
+		}
+		start = end;
+	}
+}
+
+size_t World::fill(BlockRegion region, BlockId id) {
+	return editRegion(region, [id](int32_t x, int32_t y, int32_t z, BlockId current) { return id; });
+}
+
+size_t World::replace(BlockRegion region, BlockId from, BlockId to) {
+	return editRegion(region, [from, to](int32_t x, int32_t y, int32_t z, BlockId current) {
+		return current == from ? to : current;
+	});
+}
+
+size_t World::fillSphere(int32_t x, int32_t y, int32_t z, float radius, BlockId id) {
+	if(!(radius >= 0.0f && radius <= MAX_SPHERE_RADIUS)) throw std::out_of_range("Sphere radius out of range");
+	int64_t r = std::floor(radius);
+	BlockRegion region(std::max<int64_t>(x - r, INT32_MIN), std::max<int64_t>(y - r, INT32_MIN), std::max<int64_t>(z - r, INT32_MIN),
+		std::min<int64_t>(x + r, INT32_MAX), std::min<int64_t>(y + r, INT32_MAX), std::min<int64_t>(z + r, INT32_MAX));
+	// The boundary of the box is handled by editRegion, but not that of the sphere inside it: the blocks within
+	// a block of its surface are collected in the same pass, with squared distances
+	float radius2 = radius*radius;
+	float inner2 = std::max(radius - 1.0f, 0.0f) * std::max(radius - 1.0f, 0.0f);
+	float outer2 = (radius + 1.0f) * (radius + 1.0f);
+	std::vector<BlockPos> surface;
+	size_t changed = editRegion(region, [&](int32_t x2, int32_t y2, int32_t z2, BlockId current) {
+		int64_t dx = x2 - x, dy = y2 - y, dz = z2 - z;
+		float dist2 = dx*dx + dy*dy + dz*dz;
+		if(dist2 >= inner2 && dist2 <= outer2) surface.emplace_back(x2, y2, z2);
+		return dist2 <= radius2 ? id : current;
+	});
+	
+	if(changed > 0) {
+		for(BlockPos& pos : surface) {
+			requestUpdate(std::get<0>(pos), std::get<1>(pos), std::get<2>(pos));
+		}
+	}
+	return changed;
+}
+
+BlockClipboard World::copy(BlockRegion region) {
+	region = checkEditRegion(region);
+	BlockClipboard clipboard { (int32_t) region.sizeX(), (int32_t) region.sizeY(), (int32_t) region.sizeZ(),
+		std::vector<BlockId>(region.volume()) };
+	editRegion(region, [&](int32_t x, int32_t y, int32_t z, BlockId current) {
+		clipboard.blocks[(x - region.x1) + clipboard.sizeX*(z - region.z1) + clipboard.sizeX*clipboard.sizeZ*(y - region.y1)] = current;
+		return current;
+	});
+	return clipboard;
+}
+
+size_t World::paste(const BlockClipboard& clipboard, int32_t x, int32_t y, int32_t z) {
+	if(clipboard.blocks.empty()) return 0;
+	if((int64_t) x + clipboard.sizeX > INT32_MAX || (int64_t) z + clipboard.sizeZ > INT32_MAX || y > CHUNK_HEIGHT)
+		throw std::out_of_range("Paste position out of range");
+	BlockRegion region(x, y, z, x + clipboard.sizeX - 1, y + clipboard.sizeY - 1, z + clipboard.sizeZ - 1);
+	return editRegion(region, [&](int32_t x2, int32_t y2, int32_t z2, BlockId current) {
+		return clipboard.blocks[(x2 - x) + clipboard.sizeX*(z2 - z) + clipboard.sizeX*clipboard.sizeZ*(y2 - y)];
+	});
+}
+
+BlockRegion World::checkEditRegion(BlockRegion region) {
+	if(region.y2 < 0 || region.y1 >= CHUNK_HEIGHT) throw std::out_of_range("Region outside of the valid heights");
+	region.y1 = std::max(region.y1, 0);
+	region.y2 = std::min(region.y2, CHUNK_HEIGHT - 1);
+	if(region.volume() > MAX_EDIT_VOLUME) throw std::length_error("Region too large");
+	return region;
+}
+
+size_t World::editRegion(BlockRegion region, const std::function<BlockId(int32_t, int32_t, int32_t, BlockId)>& edit) {
+	region = checkEditRegion(region);
+	
+	// Only the loaded chunks are visited, however far the region extends; the boundary updates are then limited
+	// to the part of the region they cover, which also keeps its coordinates away from overflowing
+	int32_t minChunkX, minChunkZ, maxChunkX, maxChunkZ;
+	std::tie(minChunkX, minChunkZ) = getChunkPosAt(region.x1, region.z1);
+	std::tie(maxChunkX, maxChunkZ) = getChunkPosAt(region.x2, region.z2);
+	int32_t changedMinX = INT32_MAX, changedMinZ = INT32_MAX, changedMaxX = INT32_MIN, changedMaxZ = INT32_MIN;
+	size_t changed = 0;
+	for(auto& pair : loadedChunks) {
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = unpackCoords(pair.first);
+		if(chunkX < minChunkX || chunkX > maxChunkX || chunkZ < minChunkZ || chunkZ > maxChunkZ) continue;
+		int32_t baseX = chunkX*CHUNK_SIZE;
+		int32_t baseZ = chunkZ*CHUNK_SIZE;
+		size_t chunkChanged = pair.second.editBox(
+			std::max<int64_t>((int64_t) region.x1 - baseX, 0), region.y1, std::max<int64_t>((int64_t) region.z1 - baseZ, 0),
+			std::min<int64_t>((int64_t) region.x2 - baseX, CHUNK_SIZE - 1), region.y2, std::min<int64_t>((int64_t) region.z2 - baseZ, CHUNK_SIZE - 1),
+			[&](uint8_t x, uint8_t y, uint8_t z, BlockId current) { return edit(baseX + x, y, baseZ + z, current); });
+		if(chunkChanged == 0) continue;
+		markChunkDirty(chunkX, chunkZ);
+		changed += chunkChanged;
+		changedMinX = std::min(changedMinX, baseX); changedMaxX = std::max(changedMaxX, baseX + CHUNK_SIZE - 1);
+		changedMinZ = std::min(changedMinZ, baseZ); changedMaxZ = std::max(changedMaxZ, baseZ + CHUNK_SIZE - 1);
+	}
+	if(changed > 0) {
+		region.x1 = std::max(region.x1, changedMinX); region.x2 = std::min(region.x2, changedMaxX);
+		region.z1 = std::max(region.z1, changedMinZ); region.z2 = std::min(region.z2, changedMaxZ);
+		requestUpdatesOnBoundary(region);
+	}
+	return changed;
+}
+
+void World::requestUpdatesOnBoundary(BlockRegion region) {
+	for(int32_t y = std::max(region.y1 - 1, 0); y <= std::min(region.y2 + 1, CHUNK_HEIGHT - 1); ++y) {
+		for(int32_t z = region.z1 - 1; z <= region.z2 + 1; ++z) {
+			bool innerRow = y > region.y1 && y < region.y2 && z > region.z1 && z < region.z2;
+			for(int32_t x = region.x1 - 1; x <= region.x2 + 1; ++x) {
+				// Rows crossing the inside of the region only need their ends
+				if(innerRow && x == region.x1 + 1 && x < region.x2) x = region.x2;
+				requestUpdate(x, y, z);
+			}
+		}
+	}
+}
+
 bool World::isOpaqueCube(int32_t x, int32_t y, int32_t z) {
 	if(!isValidHeight(y)) return false;
 	Chunk* chunk; int relX, relZ;
@@ -262,8 +565,7 @@ std::tuple<bool, int,int,int> World::raycast(glm::vec3 pos, glm::vec3 dir, float
 }
 
 bool World::hasSolidBlock(int32_t x, int32_t y, int32_t z) {
-	Block* block = getBlock(x, y, z);
-	return block != nullptr && block->collision() == BlockCollision::solidCube;
+	return BlockRegistry::collision(getBlockId(x, y, z)) == BlockCollision::solidCube;
 }
 
 bool World::hasSolidBlocksInLine(int x, int z, float base, float height) {
@@ -6,25 +6,78 @@
 #include <tuple>
 #include <vector>
 #include <string>
+#include <memory>
+#include <functional>
 
 #include "pixcraft/util/glm.hpp"
 
 #include "pixcraft/util/util.hpp"
+#include "pixcraft/util/mpsc_queue.hpp"
 
 #include "world_module.hpp"
 #include "worldgen.hpp"
 #include "chunk.hpp"
 
 namespace PixCraft {
+	// A save begun with the world locked (see World::beginSave), that can then be written to file from any thread.
+	class WorldSave {
+	public:
+		void write();
+	
+	private:
+		friend class World;
+		
+		std::string path;
+		uint64_t seed;
+		std::unique_ptr<flatbuffers::FlatBufferBuilder> builder; // already holds the mobs
+		flatbuffers::Offset<flatbuffers::Vector<uint8_t>> mobTypeVector;
+		flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<void>>> mobVector;
+		std::vector<std::pair<uint64_t, ChunkSnapshot>> chunks;
+	};
+	
+	struct BlockEdit {
+		int32_t x, y, z;
+		BlockId id; // 0 removes the block
+	};
+	
+	// A box of blocks, with inclusive bounds
+	struct BlockRegion {
+		int32_t x1, y1, z1, x2, y2, z2;
+		
+		BlockRegion(int32_t x1, int32_t y1, int32_t z1, int32_t x2, int32_t y2, int32_t z2); // corners in any order
+		// 64-bit, as regions can span the whole coordinate range
+		int64_t sizeX() const;
+		int64_t sizeY() const;
+		int64_t sizeZ() const;
+		int64_t volume() const; // saturates at INT64_MAX
+	};
+	
+	// Blocks copied out of a region, with unloaded chunks as air
+	struct BlockClipboard {
+		int32_t sizeX, sizeY, sizeZ;
+		std::vector<BlockId> blocks; // x + sizeX*z + sizeX*sizeZ*y
+	};
+	
 	class World {
 	public:
+		static const size_t FULL_UPDATE_EDITS = 512; // beyond this many edits in a tick, a chunk is marked dirty as a whole
+		static const int64_t MAX_EDIT_VOLUME = 1 << 24; // in blocks, once clamped to the valid heights
+		static constexpr float MAX_SPHERE_RADIUS = 128.0f;
+		
 		std::vector<std::unique_ptr<Mob>> mobs;
 		
 		World();
+		World(uint64_t seed);
 		
 		void saveToFile(std::string path);
+		// Only copies what is needed to save the world, so that it can be written without holding the world lock
+		WorldSave beginSave(std::string path);
 		Player* loadFromFile(std::string path);
 		
+		// Hashes the loaded blocks and mob positions, to check that replays are deterministic
+		uint64_t checksum();
+		uint64_t seed();
+		
 		// Chunks
 		static bool isValidHeight(int32_t y);
 		static std::pair<int32_t, int32_t> getChunkPosAt(int32_t x, int32_t z);
@@ -33,6 +86,11 @@ namespace PixCraft {
 		bool isChunkLoaded(int32_t x, int32_t z);
 		Chunk& getChunk(int32_t x, int32_t z);
 		Chunk& genChunk(int32_t x, int32_t z);
+		Chunk& loadChunk(const Serializer::Chunk* chunkData);
+		void unloadChunk(int32_t x, int32_t z);
+		std::vector<uint64_t> getLoadedChunks();
+		ChunkSnapshot snapshotChunk(int32_t x, int32_t z); // unloaded chunks give an empty snapshot
+		ChunkNeighbourhood snapshotNeighbourhood(int32_t x, int32_t z);
 		
 		std::tuple<Chunk*, uint8_t, uint8_t> getBlockFromChunk(int32_t x, int32_t z);
 		
@@ -48,9 +106,27 @@ namespace PixCraft {
 		// Block access
 		bool hasBlock(int32_t x, int32_t y, int32_t z);
 		Block* getBlock(int32_t x, int32_t y, int32_t z);
+		BlockId getBlockId(int32_t x, int32_t y, int32_t z); // 0 for air and unloaded chunks
+		// Height of the highest block (resp. opaque cube) of a column, plus one; 0 for empty columns and unloaded chunks
+		int32_t getSurfaceHeight(int32_t x, int32_t z);
+		int32_t getOpaqueSurfaceHeight(int32_t x, int32_t z);
 		void setBlock(int32_t x, int32_t y, int32_t z, Block& block);
 		void removeBlock(int32_t x, int32_t y, int32_t z);
 		
+		// Block edits from other threads; they can be queued at any time without locking the world,
+		// and are applied in a batch by applyEdits, once per tick.
+		void queueEdit(int32_t x, int32_t y, int32_t z, BlockId id);
+		void applyEdits();
+		
+		// Bulk edits, which write directly into the loaded chunks and mark them dirty as a whole,
+		// and only request block updates on the boundary of the edited region. They return the number of changed blocks.
+		// Regions are clamped to the valid heights; they throw std::length_error if still larger than MAX_EDIT_VOLUME.
+		size_t fill(BlockRegion region, BlockId id);
+		size_t replace(BlockRegion region, BlockId from, BlockId to);
+		size_t fillSphere(int32_t x, int32_t y, int32_t z, float radius, BlockId id);
+		BlockClipboard copy(BlockRegion region);
+		size_t paste(const BlockClipboard& clipboard, int32_t x, int32_t y, int32_t z); // at the minimum corner
+		
 		// Block collisions
 		bool isOpaqueCube(int32_t x, int32_t y, int32_t z);
 		
@@ -77,7 +153,7 @@ namespace PixCraft {
 		// Entities
 		bool containsMobs(int32_t x, int32_t y, int32_t z);
 		void updateEntities(float dt);
-		
+	
 	private:
 		WorldGenerator gen;
 		
@@ -86,5 +162,14 @@ namespace PixCraft {
 		
 		BlockPosSet dirtyBlocks;
 		std::unordered_set<uint64_t> dirtyChunks;
+		
+		MpscQueue<BlockEdit> editQueue;
+		std::vector<BlockEdit> editBatch;
+		
+		// Clamps the region to the valid heights, and throws std::length_error beyond MAX_EDIT_VOLUME
+		BlockRegion checkEditRegion(BlockRegion region);
+		size_t editRegion(BlockRegion region, const std::function<BlockId(int32_t, int32_t, int32_t, BlockId)>& edit);
+		// Requests updates on the outer layer of the region, and on the blocks touching it
+		void requestUpdatesOnBoundary(BlockRegion region);
 	};
 }
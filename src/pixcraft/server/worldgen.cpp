@@ -1,6 +1,8 @@
 #include "worldgen.hpp"
 
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 
 #include "blocks.hpp"
 #include "pixcraft/util/random.hpp"
@@ -9,14 +11,87 @@
 
 using namespace PixCraft;
 
+namespace {
+	// GCC vector extensions, compiled to SSE/NEON where available
+	typedef float float4 __attribute__((vector_size(16)));
+	typedef int32_t int4 __attribute__((vector_size(16)));
+	
+	float4 load4(const float* p) {
+		float4 v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+	
+	void store4(float* p, float4 v) {
+		std::memcpy(p, &v, sizeof(v));
+	}
+}
+
 WorldGenerator::WorldGenerator(uint64_t seed)
-	: _seed(seed), terrainHeightNoise(getFeatureSeed(seed, FeatureType::terrainHeight)) { }
+	: _seed(seed), terrainHeightNoise(getFeatureSeed(seed, FeatureType::terrainHeight)),
+	  terrainDensityNoise(getFeatureSeed(seed, FeatureType::terrainDensity)),
+	  caveNoise(getFeatureSeed(seed, FeatureType::caves)) { }
 
 WorldGenerator::WorldGenerator() : WorldGenerator(generateSeed()) { }
 
 uint64_t WorldGenerator::seed() { return _seed; }
 
 void WorldGenerator::generateChunk(Chunk& chunk, int32_t chunkX, int32_t chunkZ) {
+	DensityLattice lattice;
+	sampleDensity(lattice, chunkX, chunkZ);
+	
+	// Interpolate a whole row of the chunk at once: each cell is exactly one vector wide
+	static_assert(CELL_WIDTH == 4, "cells must match the vector width");
+	const float4 fracX = {0.0f, 0.25f, 0.5f, 0.75f};
+	std::vector<BlockId> blocks(CHUNK_BLOCKS);
+	alignas(16) float row[LATTICE_ROW];
+	for(int y = 0; y < CHUNK_HEIGHT; ++y) {
+		for(int z = 0; z < CHUNK_SIZE; ++z) {
+			interpolateRow(lattice, y, z, row);
+			BlockId* out = &blocks[CHUNK_SIZE*z + CHUNK_SIZE*CHUNK_SIZE*y];
+			for(int cell = 0; cell < CHUNK_SIZE/CELL_WIDTH; ++cell) {
+				float a = row[cell + 1];
+				float b = row[cell + 2];
+				int4 solid = a + (b - a) * fracX > 0.0f;
+				for(int i = 0; i < CELL_WIDTH; ++i) {
+					out[cell*CELL_WIDTH + i] = solid[i] & BlockRegistry::STONE_ID;
+				}
+			}
+		}
+	}
+	
+	for(int x = 0; x < CHUNK_SIZE; ++x) {
+		for(int z = 0; z < CHUNK_SIZE; ++z) {
+			BlockId* column = &blocks[x + CHUNK_SIZE*z];
+			auto at = [&](int y) -> BlockId& { return column[CHUNK_SIZE*CHUNK_SIZE*y]; };
+			int top = CHUNK_HEIGHT - 1;
+			while(top > 0 && at(top) == 0) --top;
+			if(top >= WATER_LEVEL) {
+				at(top) = BlockRegistry::GRASS_ID;
+				if(at(top - 1) != 0) at(top - 1) = BlockRegistry::DIRT_ID;
+			} else {
+				at(top) = BlockRegistry::DIRT_ID;
+				if(top > 0 && at(top - 1) != 0) at(top - 1) = BlockRegistry::DIRT_ID;
+				for(int y = top + 1; y <= WATER_LEVEL; ++y) {
+					at(y) = BlockRegistry::WATER_ID;
+				}
+			}
+		}
+	}
+	chunk.setBlocks(blocks.data());
+	
+	std::vector<float> trees = distributeObjects(getFeatureSeed(_seed, FeatureType::trees),
+		chunkX*CHUNK_SIZE - 0.5, chunkZ*CHUNK_SIZE - 0.5, CHUNK_SIZE, 6, 2.5);
+	for(size_t i = 0; i < trees.size(); i += 2) {
+		int32_t relX = static_cast<int32_t>(round(trees[i])) - chunkX*CHUNK_SIZE;
+		int32_t relZ = static_cast<int32_t>(round(trees[i + 1])) - chunkZ*CHUNK_SIZE;
+		int top = getDensityTop(lattice, relX, relZ);
+		if(top < WATER_LEVEL) continue;
+		generateTree(chunk, relX, relZ, top + 1);
+	}
+}
+
+void WorldGenerator::generateHeightmapChunk(Chunk& chunk, int32_t chunkX, int32_t chunkZ) {
 	for(uint8_t relX = 0; relX < CHUNK_SIZE; ++relX) {
 		for(uint8_t relZ = 0; relZ < CHUNK_SIZE; ++relZ) {
 			int32_t x = chunkX*CHUNK_SIZE + relX;
@@ -45,7 +120,9 @@ void WorldGenerator::generateChunk(Chunk& chunk, int32_t chunkX, int32_t chunkZ)
 		int32_t z = round(trees[i + 1]);
 		int32_t relX = x - chunkX*CHUNK_SIZE;
 		int32_t relZ = z - chunkZ*CHUNK_SIZE;
-		generateTree(chunk, chunkX, chunkZ, relX, relZ);
+		uint8_t h = getTerrainHeight(x, z) + 1;
+		if(h <= WATER_LEVEL) continue;
+		generateTree(chunk, relX, relZ, h);
 	}
 }
 
@@ -53,10 +130,65 @@ uint8_t WorldGenerator::getTerrainHeight(int32_t x, int32_t z) {
 	return 32 + round(8 * terrainHeightNoise.Evaluate(x / 20.0, z / 20.0));
 }
 
-void WorldGenerator::generateTree(Chunk& chunk, int32_t chunkX, int32_t chunkZ, int8_t rootX, int8_t rootZ) {
-	uint8_t h = getTerrainHeight(chunkX*CHUNK_SIZE + rootX, chunkZ*CHUNK_SIZE + rootZ) + 1;
-	if(h <= WATER_LEVEL) return;
-	if(!INVALID_BLOCK_POS(rootX, 0, rootZ)) {
+float WorldGenerator::getDensity(int32_t x, int32_t y, int32_t z, float baseHeight) {
+	float density = (baseHeight - y) / 8 + 0.7f * terrainDensityNoise.Evaluate(x / 24.0, y / 16.0, z / 24.0);
+	// Caves follow the zero surface of another noise, fading out near the ground so they rarely open under water
+	float cave = 1 - std::abs(caveNoise.Evaluate(x / 32.0, y / 16.0, z / 32.0)) / 0.12f;
+	if(cave > 0) density -= 3 * cave * std::min(std::max((baseHeight - y) / 8, 0.0f), 1.0f);
+	if(y == 0) density = std::max(density, 1.0f);
+	return density;
+}
+
+void WorldGenerator::sampleDensity(DensityLattice& lattice, int32_t chunkX, int32_t chunkZ) {
+	for(int i = 0; i < LATTICE_WIDTH; ++i) {
+		for(int k = 0; k < LATTICE_WIDTH; ++k) {
+			int32_t x = chunkX*CHUNK_SIZE + (i - 1)*CELL_WIDTH;
+			int32_t z = chunkZ*CHUNK_SIZE + (k - 1)*CELL_WIDTH;
+			float baseHeight = 32 + 8 * terrainHeightNoise.Evaluate(x / 20.0, z / 20.0);
+			for(int j = 0; j < LATTICE_HEIGHT; ++j) {
+				lattice.values[j][k][i] = getDensity(x, j*CELL_HEIGHT, z, baseHeight);
+			}
+		}
+	}
+	for(int j = 0; j < LATTICE_HEIGHT; ++j) {
+		for(int k = 0; k < LATTICE_WIDTH; ++k) {
+			for(int i = LATTICE_WIDTH; i < LATTICE_ROW; ++i) lattice.values[j][k][i] = 0.0f;
+		}
+	}
+}
+
+void WorldGenerator::interpolateRow(const DensityLattice& lattice, int y, int relZ, float row[LATTICE_ROW]) {
+	int cellY = y / CELL_HEIGHT;
+	float fracY = (y % CELL_HEIGHT) / static_cast<float>(CELL_HEIGHT);
+	int cellZ = (relZ + CELL_WIDTH) / CELL_WIDTH;
+	float fracZ = ((relZ + CELL_WIDTH) % CELL_WIDTH) / static_cast<float>(CELL_WIDTH);
+	for(int i = 0; i < LATTICE_ROW; i += 4) {
+		float4 a = load4(&lattice.values[cellY][cellZ][i]);
+		float4 b = load4(&lattice.values[cellY][cellZ + 1][i]);
+		float4 c = load4(&lattice.values[cellY + 1][cellZ][i]);
+		float4 d = load4(&lattice.values[cellY + 1][cellZ + 1][i]);
+		float4 bottom = a + (b - a) * fracZ;
+		float4 top = c + (d - c) * fracZ;
+		store4(&row[i], bottom + (top - bottom) * fracY);
+	}
+}
+
+int WorldGenerator::getDensityTop(const DensityLattice& lattice, int relX, int relZ) {
+	// Same operations as generateChunk, so that the result matches the generated blocks
+	int cell = (relX + CELL_WIDTH) / CELL_WIDTH;
+	float fracX = ((relX + CELL_WIDTH) % CELL_WIDTH) / static_cast<float>(CELL_WIDTH);
+	alignas(16) float row[LATTICE_ROW];
+	for(int y = CHUNK_HEIGHT - 1; y > 0; --y) {
+		interpolateRow(lattice, y, relZ, row);
+		float a = row[cell];
+		float b = row[cell + 1];
+		if(a + (b - a) * fracX > 0.0f) return y;
+	}
+	return 0;
+}
+
+void WorldGenerator::generateTree(Chunk& chunk, int8_t rootX, int8_t rootZ, uint8_t h) {
+	if(!INVALID_BLOCK_POS(rootX, h + 3, rootZ)) {
 		for(int y = h; y <= h + 3; ++y) {
 			chunk.setBlockId(rootX, y, rootZ, BlockRegistry::TRUNK_ID, true);
 		}
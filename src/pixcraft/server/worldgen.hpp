@@ -14,16 +14,43 @@ namespace PixCraft {
 		
 		uint64_t seed();
 		
+		// 3D terrain, with overhangs and caves
 		void generateChunk(Chunk& chunk, int32_t chunkX, int32_t chunkZ);
-
+		// The previous, purely 2D terrain, kept for comparison
+		void generateHeightmapChunk(Chunk& chunk, int32_t chunkX, int32_t chunkZ);
+		
+		static const uint8_t WATER_LEVEL = 30;
+		// Increased whenever the generated terrain changes, since saves only hold the differences with it
+		static const uint32_t VERSION = 1;
+		
+		// Height of the 2D base terrain, which the 3D terrain stays within a few blocks of;
+		// cheap enough to sample far beyond the loaded chunks. Can be called from several threads at once.
+		uint8_t getTerrainHeight(int32_t x, int32_t z);
+	
 	private:
 		uint64_t _seed;
 		OpenSimplexNoise terrainHeightNoise;
+		OpenSimplexNoise terrainDensityNoise;
+		OpenSimplexNoise caveNoise;
 		
-		static const uint8_t WATER_LEVEL = 30;
+		// The density is only sampled on a coarse lattice, and interpolated in between.
+		// The lattice extends one cell past the chunk on each side, to find the ground under trees rooted in neighbouring chunks.
+		static const int CELL_WIDTH = 4;
+		static const int CELL_HEIGHT = 8;
+		static const int LATTICE_WIDTH = CHUNK_SIZE/CELL_WIDTH + 3;
+		static const int LATTICE_HEIGHT = CHUNK_HEIGHT/CELL_HEIGHT + 1;
+		static const int LATTICE_ROW = 8; // LATTICE_WIDTH padded to a multiple of 4, for vector loads
+		struct alignas(16) DensityLattice {
+			float values[LATTICE_HEIGHT][LATTICE_WIDTH][LATTICE_ROW]; // y, z, x
+		};
 		
-		uint8_t getTerrainHeight(int32_t x, int32_t z);
+		float getDensity(int32_t x, int32_t y, int32_t z, float baseHeight); // solid where positive
+		void sampleDensity(DensityLattice& lattice, int32_t chunkX, int32_t chunkZ);
+		// Interpolates the density at every lattice point of a row along x; relZ may be up to one cell outside of the chunk
+		static void interpolateRow(const DensityLattice& lattice, int y, int relZ, float row[LATTICE_ROW]);
+		// Highest solid block of a column, which may be up to one cell outside of the chunk
+		static int getDensityTop(const DensityLattice& lattice, int relX, int relZ);
 		
-		void generateTree(Chunk& chunk, int32_t chunkX, int32_t chunkZ, int8_t rootX, int8_t rootZ);
+		void generateTree(Chunk& chunk, int8_t rootX, int8_t rootZ, uint8_t h);
 	};
 }
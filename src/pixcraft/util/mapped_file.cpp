@@ -0,0 +1,111 @@
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+using namespace PixCraft;
+
+#ifdef _WIN32
+MappedFile::MappedFile() : _data(nullptr), _size(0), mapping(nullptr) { }
+
+MappedFile::MappedFile(MappedFile&& other) : _data(other._data), _size(other._size), mapping(other.mapping) {
+	other._data = nullptr;
+	other._size = 0;
+	other.mapping = nullptr;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+	if(this != &other) {
+		close();
+		_data = other._data;
+		_size = other._size;
+		mapping = other.mapping;
+		other._data = nullptr;
+		other._size = 0;
+		other.mapping = nullptr;
+	}
+	return *this;
+}
+#else
+MappedFile::MappedFile() : _data(nullptr), _size(0) { }
+
+MappedFile::MappedFile(MappedFile&& other) : _data(other._data), _size(other._size) {
+	other._data = nullptr;
+	other._size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+	if(this != &other) {
+		close();
+		_data = other._data;
+		_size = other._size;
+		other._data = nullptr;
+		other._size = 0;
+	}
+	return *this;
+}
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+void MappedFile::open(const std::string& path) {
+	close();
+	#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open " + path);
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file); // the mapping keeps the file open
+	if(fileMapping == nullptr) throw std::runtime_error("Failed to map " + path);
+	void* view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+	if(view == nullptr) {
+		CloseHandle(fileMapping);
+		throw std::runtime_error("Failed to map " + path);
+	}
+	mapping = fileMapping;
+	_data = static_cast<const uint8_t*>(view);
+	_size = fileSize.QuadPart;
+	#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd == -1) throw std::runtime_error("Failed to open " + path);
+	struct stat info;
+	if(fstat(fd, &info) == -1 || info.st_size == 0) {
+		::close(fd);
+		throw std::runtime_error("Failed to map " + path);
+	}
+	void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // the mapping keeps the file open
+	if(view == MAP_FAILED) throw std::runtime_error("Failed to map " + path);
+	_data = static_cast<const uint8_t*>(view);
+	_size = info.st_size;
+	#endif
+}
+
+void MappedFile::close() {
+	if(_data == nullptr) return;
+	#ifdef _WIN32
+	UnmapViewOfFile(_data);
+	CloseHandle(mapping);
+	mapping = nullptr;
+	#else
+	munmap(const_cast<uint8_t*>(_data), _size);
+	#endif
+	_data = nullptr;
+	_size = 0;
+}
+
+bool MappedFile::isOpen() { return _data != nullptr; }
+
+const uint8_t* MappedFile::data() { return _data; }
+size_t MappedFile::size() { return _size; }
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace PixCraft {
+	// Read-only memory mapping of a whole file; pages are only read from disk when they are first accessed
+	class MappedFile {
+	public:
+		MappedFile();
+		MappedFile(MappedFile&& other);
+		MappedFile& operator=(MappedFile&& other);
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile& operator=(const MappedFile& other) = delete;
+		~MappedFile();
+		
+		// Throws if the file can't be opened or mapped
+		void open(const std::string& path);
+		void close();
+		bool isOpen();
+		
+		const uint8_t* data();
+		size_t size();
+	
+	private:
+		const uint8_t* _data;
+		size_t _size;
+		#ifdef _WIN32
+		void* mapping; // the file mapping handle
+		#endif
+	};
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+namespace PixCraft {
+	// Lock-free queue with any number of producer threads and a single consumer, which takes everything at once.
+	// Producers push onto an atomic list head; the consumer detaches the whole list with one exchange.
+	template<typename T>
+	class MpscQueue {
+	public:
+		MpscQueue();
+		MpscQueue(const MpscQueue& other) = delete;
+		MpscQueue& operator=(const MpscQueue& other) = delete;
+		~MpscQueue();
+		
+		// Can be called from any thread
+		void push(T value);
+		
+		// Consumer only: appends every element pushed so far to out, in push order
+		void popAll(std::vector<T>& out);
+		bool empty();
+		
+	private:
+		struct Node {
+			T value;
+			Node* next;
+		};
+		
+		std::atomic<Node*> head;
+	};
+}
+
+#include "mpsc_queue_impl.hpp"
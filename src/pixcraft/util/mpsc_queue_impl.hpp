@@ -0,0 +1,48 @@
+#pragma once
+
+#include <utility>
+
+namespace PixCraft {
+	template<typename T>
+	MpscQueue<T>::MpscQueue() : head(nullptr) { }
+	
+	template<typename T>
+	MpscQueue<T>::~MpscQueue() {
+		Node* node = head.load(std::memory_order_acquire);
+		while(node) {
+			Node* next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+	
+	template<typename T>
+	void MpscQueue<T>::push(T value) {
+		Node* node = new Node { std::move(value), head.load(std::memory_order_relaxed) };
+		while(!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) { }
+	}
+	
+	template<typename T>
+	void MpscQueue<T>::popAll(std::vector<T>& out) {
+		Node* node = head.exchange(nullptr, std::memory_order_acquire);
+		// The list is newest first: reverse it
+		Node* reversed = nullptr;
+		while(node) {
+			Node* next = node->next;
+			node->next = reversed;
+			reversed = node;
+			node = next;
+		}
+		while(reversed) {
+			Node* next = reversed->next;
+			out.push_back(std::move(reversed->value));
+			delete reversed;
+			reversed = next;
+		}
+	}
+	
+	template<typename T>
+	bool MpscQueue<T>::empty() {
+		return head.load(std::memory_order_relaxed) == nullptr;
+	}
+}
@@ -0,0 +1,150 @@
+#include "pixcraft/util/profiler.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+
+using namespace PixCraft;
+
+ProfileBuffer::ProfileBuffer(uint32_t threadId) : depth(0), _threadId(threadId), events(), head(0), tail(0) { }
+
+uint32_t ProfileBuffer::threadId() { return _threadId; }
+
+void ProfileBuffer::push(const ProfileEvent& event) {
+	uint64_t h = head.load(std::memory_order_relaxed);
+	// Orders the previous head store before the slot write, so that drain can tell when it copied an overwritten slot
+	std::atomic_thread_fence(std::memory_order_release);
+	events[h % CAPACITY] = event;
+	head.store(h + 1, std::memory_order_release);
+}
+
+void ProfileBuffer::drain(std::vector<ProfileEvent>& out) {
+	uint64_t h = head.load(std::memory_order_acquire);
+	if(h - tail > CAPACITY) tail = h - CAPACITY;
+	size_t first = out.size();
+	for(uint64_t i = tail; i < h; ++i) {
+		out.push_back(events[i % CAPACITY]);
+	}
+	
+	// Like a seqlock: if the writer lapped us during the copy, the slots it reached may be torn, so they are dropped
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t h2 = head.load(std::memory_order_relaxed);
+	if(h2 >= tail + CAPACITY) {
+		uint64_t overwritten = std::min(h2 - CAPACITY + 1 - tail, h - tail);
+		out.erase(out.begin() + first, out.begin() + first + overwritten);
+	}
+	tail = h;
+}
+
+namespace PixCraft::Profiler {
+	namespace {
+		const size_t TRACE_CAPACITY = 1 << 16;
+		
+		struct ScopeHistory {
+			uint32_t depth;
+			std::deque<float> samples;
+		};
+		
+		const auto startTime = std::chrono::steady_clock::now();
+		
+		std::mutex buffersMutex;
+		std::vector<std::unique_ptr<ProfileBuffer>> buffers;
+		thread_local ProfileBuffer* localBuffer = nullptr;
+		
+		// Only accessed from the main thread
+		// Keyed by content, as the same literal can have several addresses (one per translation unit)
+		std::vector<std::string> scopeOrder;
+		std::unordered_map<std::string, ScopeHistory> history;
+		std::deque<ProfileEvent> trace;
+		
+		ProfileBuffer& getLocalBuffer() {
+			if(localBuffer == nullptr) {
+				std::lock_guard<std::mutex> lock(buffersMutex);
+				buffers.emplace_back(new ProfileBuffer(buffers.size()));
+				localBuffer = buffers.back().get();
+			}
+			return *localBuffer;
+		}
+	}
+	
+	Scope::Scope(const char* name) : name(name), start(now()) {
+		getLocalBuffer().depth++;
+	}
+	
+	Scope::~Scope() {
+		ProfileBuffer& buffer = getLocalBuffer();
+		buffer.depth--;
+		buffer.push(ProfileEvent { name, buffer.threadId(), buffer.depth, start, now() });
+	}
+	
+	int64_t now() {
+		auto elapsed = std::chrono::steady_clock::now() - startTime;
+		return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+	}
+	
+	void endFrame() {
+		std::vector<ProfileEvent> events;
+		{
+			std::lock_guard<std::mutex> lock(buffersMutex);
+			for(auto& buffer : buffers) {
+				buffer->drain(events);
+			}
+		}
+		
+		// Scopes can run several times per frame (or on several threads): sum them up
+		std::unordered_map<std::string, float> frameTotals;
+		for(ProfileEvent& event : events) {
+			frameTotals[event.name] += (event.end - event.start) / 1000.0f;
+			if(history.count(event.name) == 0) {
+				history[event.name].depth = event.depth;
+				scopeOrder.push_back(event.name);
+			}
+			trace.push_back(event);
+		}
+		while(trace.size() > TRACE_CAPACITY) {
+			trace.pop_front();
+		}
+		
+		for(auto& pair : frameTotals) {
+			std::deque<float>& samples = history[pair.first].samples;
+			samples.push_back(pair.second);
+			if(samples.size() > WINDOW) samples.pop_front();
+		}
+	}
+	
+	std::vector<ProfileStats> getStats() {
+		std::vector<ProfileStats> stats;
+		for(const std::string& name : scopeOrder) {
+			ScopeHistory& scope = history[name];
+			std::vector<float> samples(scope.samples.begin(), scope.samples.end());
+			std::sort(samples.begin(), samples.end());
+			float sum = 0;
+			for(float sample : samples) sum += sample;
+			size_t p99Idx = std::min(samples.size() - 1, samples.size() * 99 / 100);
+			stats.push_back(ProfileStats {
+				name, scope.depth,
+				samples.front(), sum / samples.size(), samples[p99Idx]
+			});
+		}
+		return stats;
+	}
+	
+	bool dumpTrace(std::string path) {
+		std::ofstream file(path.c_str());
+		if(!file) return false;
+		file << "{\"traceEvents\":[";
+		bool first = true;
+		for(ProfileEvent& event : trace) {
+			if(!first) file << ",";
+			first = false;
+			file << "\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadId
+				<< ",\"ts\":" << event.start << ",\"dur\":" << (event.end - event.start) << "}";
+		}
+		file << "\n]}\n";
+		return file.good();
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+
+namespace PixCraft {
+	struct ProfileEvent {
+		const char* name;
+		uint32_t threadId;
+		uint32_t depth;
+		int64_t start; // in µs since the profiler was started
+		int64_t end;
+	};
+	
+	struct ProfileStats {
+		std::string name;
+		uint32_t depth;
+		float min, avg, p99; // in ms, over the last Profiler::WINDOW frames
+	};
+	
+	// Ring buffer of timing events, written only by the thread that owns it.
+	// Readers never block the writer: if it laps them, the oldest events are simply lost.
+	class ProfileBuffer {
+	public:
+		static const size_t CAPACITY = 4096;
+		
+		ProfileBuffer(uint32_t threadId);
+		
+		uint32_t threadId();
+		
+		void push(const ProfileEvent& event);
+		void drain(std::vector<ProfileEvent>& out);
+		
+		uint32_t depth;
+	
+	private:
+		uint32_t _threadId;
+		std::array<ProfileEvent, CAPACITY> events;
+		std::atomic<uint64_t> head;
+		uint64_t tail;
+	};
+	
+	namespace Profiler {
+		const size_t WINDOW = 120;
+		
+		// Times the enclosing block. The name must be a string literal (or otherwise outlive the profiler).
+		class Scope {
+		public:
+			Scope(const char* name);
+			~Scope();
+		
+		private:
+			const char* name;
+			int64_t start;
+		};
+		
+		int64_t now();
+		
+		// Collects the events of all threads; should be called once per frame, from the main thread.
+		void endFrame();
+		
+		std::vector<ProfileStats> getStats();
+		
+		// Writes the recent events in the Chrome trace format (chrome://tracing, Perfetto...)
+		bool dumpTrace(std::string path);
+	}
+}
@@ -14,7 +14,9 @@ namespace PixCraft {
 
 	enum class FeatureType {
 		terrainHeight,
-		trees
+		trees,
+		terrainDensity,
+		caves
 	};
 
 	uint64_t getFeatureSeed(uint64_t seed, FeatureType feature);
@@ -0,0 +1,60 @@
+#include "worker_pool.hpp"
+
+#include <algorithm>
+
+using namespace PixCraft;
+
+WorkerPool::WorkerPool(unsigned threadCount) : stopping(false) {
+	for(unsigned i = 0; i < threadCount; ++i) {
+		threads.emplace_back(&WorkerPool::run, this);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		tasks.clear();
+	}
+	wakeUp.notify_all();
+	for(std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+unsigned WorkerPool::defaultThreadCount() {
+	unsigned cores = std::thread::hardware_concurrency(); // 0 if unknown
+	return std::max(cores, 3u) - 2;
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	wakeUp.notify_one();
+}
+
+void WorkerPool::clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+	tasks.clear();
+}
+
+size_t WorkerPool::queuedTasks() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return tasks.size();
+}
+
+void WorkerPool::run() {
+	while(true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeUp.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if(stopping) return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace PixCraft {
+	// Fixed set of threads running tasks in submission order.
+	// Tasks that haven't started when the pool is destroyed are dropped; running ones are waited for.
+	class WorkerPool {
+	public:
+		WorkerPool(unsigned threadCount);
+		WorkerPool(const WorkerPool& other) = delete;
+		WorkerPool& operator=(const WorkerPool& other) = delete;
+		~WorkerPool();
+		
+		// One thread per core, minus the main and simulation threads
+		static unsigned defaultThreadCount();
+		
+		void submit(std::function<void()> task);
+		// Drops the tasks that haven't started yet
+		void clear();
+		size_t queuedTasks();
+	
+	private:
+		std::vector<std::thread> threads;
+		std::mutex mutex; // guards the following
+		std::condition_variable wakeUp;
+		std::deque<std::function<void()>> tasks;
+		bool stopping;
+		
+		void run();
+	};
+}